@@ -0,0 +1,44 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+/**
+ * Monotonic wall clock in nanoseconds
+ */
+double bench_now_ns(void);
+
+/**
+ * Print one result line: name, nanoseconds per operation and the
+ * speedup relative to a baseline (pass 0 to omit)
+ */
+void bench_report(const char *name, double ns_per_op, double baseline_ns);
+
+/**
+ * Benchmark suites
+ */
+void bench_vm(void);
+void bench_arena(void);
+void bench_ast(void);
+void bench_tokenizer(void);
+void bench_cache(void);
+void bench_fold(void);
+void bench_cse(void);
+void bench_columns(void);
+void bench_jit(void);
+void bench_batch(void);
+void bench_depth(void);
+void bench_lazy(void);
+void bench_elementwise(void);
+void bench_fusion(void);
+void bench_cow(void);
+void bench_small(void);
+void bench_spans(void);
+void bench_decimal(void);
+void bench_errors(void);
+void bench_parse(void);
+void bench_literal(void);
+void bench_load(void);
+void bench_stats(void);
+
+#endif // BENCH_H
@@ -0,0 +1,48 @@
+#include "bench.h"
+#include "common/error.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+// Steady-state parse+evaluate cost once the context arena has warmed up.
+// After the first iterations every token, node and parser stack comes out of
+// the arena's existing block, so no further blocks should be malloc'd.
+void bench_arena(void) {
+  static const char *formulas[] = {
+      "1 + 2 * 3",
+      "(12 + 8) * 3 / (7 - 2) + 100 % 7",
+      "gcd(48, 18) + lcm(4, 6) * fact(5)",
+      "mean(1, 2, 3, 4, 5, 6, 7, 8) + stddev(2, 4, 4, 4, 5, 5, 7, 9)",
+  };
+  const size_t formula_count = sizeof(formulas) / sizeof(formulas[0]);
+  const int iterations = 100000;
+
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx) {
+    fprintf(stderr, "failed to create context\n");
+    return;
+  }
+
+  for (size_t f = 0; f < formula_count; f++) {
+    error_t err;
+    for (int i = 0; i < 16; i++) {
+      value_t v = engine_eval(formulas[f], ctx, &err);
+      value_free(&v);
+    }
+
+    size_t blocks_before = ctx->arena->heap_allocations;
+    double start = bench_now_ns();
+    for (int i = 0; i < iterations; i++) {
+      value_t v = engine_eval(formulas[f], ctx, &err);
+      value_free(&v);
+    }
+    double ns = (bench_now_ns() - start) / iterations;
+
+    char name[64];
+    snprintf(name, sizeof(name), "eval %.38s", formulas[f]);
+    bench_report(name, ns, 0);
+    printf("  %-44s %12zu\n", "  arena blocks allocated in loop",
+           ctx->arena->heap_allocations - blocks_before);
+  }
+
+  engine_context_free(ctx);
+}
@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <string.h>
+
+// Long and deeply nested expressions, where node layout dominates
+static void build_flat(char *buf, size_t size, int terms) {
+  size_t len = (size_t)snprintf(buf, size, "1");
+  for (int i = 2; i <= terms && len < size; i++)
+    len += (size_t)snprintf(buf + len, size - len, " + %d * 2", i);
+}
+
+static void build_nested(char *buf, size_t size, int depth) {
+  size_t len = 0;
+  for (int i = 0; i < depth && len < size; i++)
+    len += (size_t)snprintf(buf + len, size - len, "(1 + ");
+  len += (size_t)snprintf(buf + len, size - len, "1");
+  for (int i = 0; i < depth && len < size; i++)
+    len += (size_t)snprintf(buf + len, size - len, ")");
+}
+
+static void bench_expression(const char *label, const char *expr) {
+  const size_t iterations = 20000;
+  error_t error;
+
+  arena_t *arena = arena_create(0);
+  if (!arena)
+    return;
+  ast_t *ast = parse(expr, arena, NULL, &error);
+  if (!ast) {
+    printf("  parse failed: %s\n", error.message);
+    arena_free(arena);
+    return;
+  }
+
+  size_t tree_bytes = ast->node_count * sizeof(ast_node_t) +
+                      ast->edge_count * sizeof(ast_index_t) +
+                      ast->constant_count * sizeof(double);
+  printf("%s: %zu nodes, %.1f bytes/node (node %zu, edge %zu, const %zu)\n",
+         label, ast->node_count, (double)tree_bytes / (double)ast->node_count,
+         sizeof(ast_node_t), sizeof(ast_index_t), sizeof(double));
+  arena_free(arena);
+
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  bench_report("engine_eval", (bench_now_ns() - start) / (double)iterations,
+               0);
+
+  start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    bytecode_t *program = engine_compile(expr, ctx, &error);
+    bytecode_free(program);
+  }
+  bench_report("engine_compile", (bench_now_ns() - start) / (double)iterations,
+               0);
+
+  engine_context_free(ctx);
+}
+
+void bench_ast(void) {
+  static char flat[8192];
+  static char nested[8192];
+
+  build_flat(flat, sizeof(flat), 200);
+  build_nested(nested, sizeof(nested), 100);
+
+  bench_expression("200 terms", flat);
+  bench_expression("100 levels", nested);
+}
@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define EXPRESSIONS 20000
+
+void bench_batch(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  char (*text)[96] = malloc(EXPRESSIONS * sizeof(*text));
+  const char **expressions = malloc(EXPRESSIONS * sizeof(char *));
+  value_t *results = malloc(EXPRESSIONS * sizeof(value_t));
+  error_t *errors = malloc(EXPRESSIONS * sizeof(error_t));
+  if (!ctx || !text || !expressions || !results || !errors)
+    goto done;
+
+  // Distinct expressions, so every one is tokenized, parsed and compiled
+  for (size_t i = 0; i < EXPRESSIONS; i++) {
+    snprintf(text[i], sizeof(text[i]),
+             "(%zu + 3) * %zu / 7 + stddev(%zu, 4, 9, 16) - gcd(%zu, 18)",
+             i, i % 97 + 1, i % 13, i % 31 + 1);
+    expressions[i] = text[i];
+  }
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max_threads = online > 0 ? (size_t)online : 1;
+  printf("%d distinct expressions, %zu CPUs\n", EXPRESSIONS, max_threads);
+
+  double serial = 0;
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    double start = bench_now_ns();
+    engine_eval_batch(ctx, expressions, EXPRESSIONS, results, errors,
+                      threads);
+    double ns = (bench_now_ns() - start) / EXPRESSIONS;
+    for (size_t i = 0; i < EXPRESSIONS; i++)
+      value_free(&results[i]);
+
+    char name[64];
+    snprintf(name, sizeof(name), "engine_eval_batch, %zu thread%s", threads,
+             threads == 1 ? "" : "s");
+    bench_report(name, ns, serial);
+    if (threads == 1)
+      serial = ns;
+  }
+
+done:
+  engine_context_free(ctx);
+  free(text);
+  free(expressions);
+  free(results);
+  free(errors);
+}
@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+// A workload that resubmits a handful of expression strings
+static const char *formulas[] = {
+    "3 + 4 * 2",
+    "(1 + 2) * (3 + 4) - 5 / 2 + 6 % 4",
+    "gcd(48, 18) * lcm(12, 8) + mod(100, 7)",
+    "mean(1, 2, 3, 4, 5) + stddev(4, 5, 6) * var(7, 8, 9)",
+};
+
+static double run(engine_context_t *ctx, size_t iterations) {
+  const size_t count = sizeof(formulas) / sizeof(formulas[0]);
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(formulas[i % count], ctx, &error);
+    value_free(&v);
+  }
+  return (bench_now_ns() - start) / (double)iterations;
+}
+
+void bench_cache(void) {
+  const size_t iterations = 400000;
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+
+  engine_set_cache_capacity(ctx, 0);
+  double uncached = run(ctx, iterations);
+  bench_report("engine_eval, cache disabled", uncached, 0);
+
+  engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+  double cached = run(ctx, iterations);
+  bench_report("engine_eval, cache enabled", cached, uncached);
+  printf("  %-44s %zu / %zu\n", "hits / misses", ctx->cache->hits,
+         ctx->cache->misses);
+
+  engine_context_free(ctx);
+}
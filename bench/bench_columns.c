@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROWS 1000000
+
+static void report(const char *name, double ns, size_t rows, double baseline) {
+  double per_row = ns / (double)rows;
+  bench_report(name, per_row, baseline);
+  printf("  %-44s %12.1f Mrows/s\n", "", 1e3 / per_row);
+}
+
+// The per-row path a caller has today: format each row into the text
+static double run_text(engine_context_t *ctx, const double *a, const double *b,
+                       const double *c, size_t rows) {
+  char expr[128];
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < rows; i++) {
+    snprintf(expr, sizeof(expr), "%.17g * %.17g + %.17g %% 7", a[i], b[i],
+             c[i]);
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  return bench_now_ns() - start;
+}
+
+// Compiled once, variables set and the scalar VM run per row
+static double run_exec(engine_context_t *ctx, bytecode_t *program,
+                       const int *slots, const double *const *columns,
+                       double *out, size_t rows) {
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t k = 0; k < 3; k++)
+      symbol_set(ctx->symbols, (size_t)slots[k], value_number(columns[k][i]));
+    value_t v = engine_exec(program, ctx, &error);
+    out[i] = v.as.number;
+    value_free(&v);
+  }
+  return bench_now_ns() - start;
+}
+
+void bench_columns(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  double *data = malloc(4 * ROWS * sizeof(double));
+  if (!ctx || !data) {
+    engine_context_free(ctx);
+    free(data);
+    return;
+  }
+
+  double *a = data, *b = data + ROWS, *c = data + 2 * ROWS;
+  double *out = data + 3 * ROWS;
+  for (size_t i = 0; i < ROWS; i++) {
+    a[i] = (double)(i % 1000) * 0.5;
+    b[i] = (double)(i % 37) + 1;
+    c[i] = (double)(i % 101);
+  }
+
+  error_t error;
+  bytecode_t *program = engine_compile("a*b + c % 7", ctx, &error);
+  if (!program) {
+    printf("  compile failed: %s\n", error.message);
+    engine_context_free(ctx);
+    free(data);
+    return;
+  }
+
+  const engine_column_t bindings[] = {{"a", a}, {"b", b}, {"c", c}};
+  const double *const columns[] = {a, b, c};
+  int slots[3];
+  for (size_t k = 0; k < 3; k++)
+    slots[k] = symbol_resolve(ctx->symbols, bindings[k].name, 1, &error);
+
+  printf("a*b + c %% 7 over %d rows\n", ROWS);
+  size_t text_rows = ROWS / 10;
+  double text = run_text(ctx, a, b, c, text_rows) / (double)text_rows;
+  report("engine_eval per row (formatted text)", text, 1, 0);
+
+  double exec = run_exec(ctx, program, slots, columns, out, ROWS);
+  report("engine_exec per row", exec, ROWS, text);
+
+  double start = bench_now_ns();
+  int status = engine_eval_columns(program, ctx, bindings, 3, ROWS, out,
+                                   &error);
+  double block = bench_now_ns() - start;
+  if (status != 0)
+    printf("  engine_eval_columns failed: %s\n", error.message);
+  report("engine_eval_columns", block, ROWS, text);
+
+  bytecode_free(program);
+  engine_context_free(ctx);
+  free(data);
+}
@@ -0,0 +1,45 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+#define SIZE 1000000
+
+// Each expression copies or reads the whole of v without writing to it
+static const char *const cases[] = {"w = v", "v", "mean(v)", "vec_mag(v)"};
+
+static void run(engine_context_t *ctx, const char *expr) {
+  const size_t iterations = 200;
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", expr, error.message);
+    return;
+  }
+  bench_report(expr, ns, 0);
+}
+
+void bench_cow(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+  double *data = value_alloc(SIZE);
+  if (!data) {
+    engine_context_free(ctx);
+    return;
+  }
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = (double)(i % 1000) * 0.5;
+  error_t error;
+  int slot = symbol_resolve(ctx->symbols, "v", 1, &error);
+  symbol_set(ctx->symbols, (size_t)slot, value_array(data, SIZE));
+
+  printf("%d-element array v, ns per evaluation\n", SIZE);
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    run(ctx, cases[i]);
+  engine_context_free(ctx);
+}
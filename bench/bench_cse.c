@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Run without constant folding, which would otherwise reduce these
+// all-literal formulas to a single constant and hide the sharing
+static double run(const char *expr, int share, double baseline) {
+  const size_t iterations = 100000;
+  error_t error;
+  arena_t *arena = arena_create(0);
+  if (!arena)
+    return 0;
+
+  ast_t *ast = parse(expr, arena, NULL, &error);
+  if (ast && share)
+    ast_share(ast, arena, &error);
+  bytecode_t *program = ast ? bytecode_compile(ast, &error) : NULL;
+  arena_free(arena);
+  if (!program) {
+    printf("  compile failed: %s\n", error.message);
+    return 0;
+  }
+
+  value_t *scratch =
+      malloc(bytecode_scratch_size(program) * sizeof(value_t));
+  if (!scratch) {
+    bytecode_free(program);
+    return 0;
+  }
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = bytecode_exec(program, NULL, scratch, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+
+  char name[64];
+  snprintf(name, sizeof(name), "%s (%zu instructions)",
+           share ? "DAG" : "tree", program->code_size);
+  bench_report(name, ns, baseline);
+  free(scratch);
+  bytecode_free(program);
+  return ns;
+}
+
+void bench_cse(void) {
+  static const char *formulas[] = {
+      "stddev(1, 4, 9, 16, 25, 36, 49, 64) * 2 + "
+      "stddev(1, 4, 9, 16, 25, 36, 49, 64) / 3 - "
+      "mean(1, 4, 9, 16, 25, 36, 49, 64) * "
+      "stddev(1, 4, 9, 16, 25, 36, 49, 64)",
+      "mat_det(mat_mul(matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 10), "
+      "matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 10))) + "
+      "mat_det(matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 10))",
+  };
+
+  for (size_t f = 0; f < sizeof(formulas) / sizeof(formulas[0]); f++) {
+    printf("%.60s...\n", formulas[f]);
+    double tree = run(formulas[f], 0, 0);
+    run(formulas[f], 1, tree);
+  }
+}
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include "common/decimal.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COUNT 1000000
+
+// Literals as generated data carries them: full round-trip precision,
+// and short fixed-point values
+static char *build_numbers(int precise, size_t *size) {
+  char *buf = malloc((size_t)COUNT * 32);
+  if (!buf)
+    return NULL;
+
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  size_t len = 0;
+  for (int i = 0; i < COUNT; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (precise)
+      len += (size_t)sprintf(buf + len, "%.17g ",
+                             (double)(state >> 11) / 9007199254740992.0 *
+                                 1000.0);
+    else
+      len += (size_t)sprintf(buf + len, "%u.%02u ",
+                             (unsigned)(state % 100000),
+                             (unsigned)(state >> 40) % 100);
+  }
+  *size = len;
+  return buf;
+}
+
+static double run(const char *buf, size_t size, int fast, const char *name,
+                  double baseline) {
+  const int rounds = 5;
+  double sum = 0;
+  double start = bench_now_ns();
+  for (int r = 0; r < rounds; r++) {
+    const char *p = buf;
+    for (int i = 0; i < COUNT; i++) {
+      char *end;
+      if (fast) {
+        const char *next;
+        sum += decimal_parse(p, &next);
+        p = next + 1;
+      } else {
+        sum += strtod(p, &end);
+        p = end + 1;
+      }
+    }
+  }
+  double ns = (bench_now_ns() - start) / rounds;
+  bench_report(name, ns / COUNT, baseline);
+  printf("  %-44s %12.1f MB/s   (checksum %g)\n", "", (double)size / ns * 1e3,
+         sum);
+  return ns / COUNT;
+}
+
+void bench_decimal(void) {
+  for (int precise = 1; precise >= 0; precise--) {
+    size_t size;
+    char *buf = build_numbers(precise, &size);
+    if (!buf)
+      return;
+    printf("%d %s literals, ns per number\n", COUNT,
+           precise ? "17-digit" : "short fixed-point");
+    double baseline = run(buf, size, 0, "strtod", 0);
+    run(buf, size, 1, "decimal_parse", baseline);
+    free(buf);
+  }
+}
@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// x + (x + (x + ... )) nested `depth` levels deep
+static char *nested(size_t depth) {
+  char *text = malloc(4 * depth + 2);
+  if (!text)
+    return NULL;
+  char *p = text;
+  for (size_t i = 0; i < depth; i++) {
+    memcpy(p, "x+(", 3);
+    p += 3;
+  }
+  *p++ = 'x';
+  memset(p, ')', depth);
+  p[depth] = '\0';
+  return text;
+}
+
+static void run(engine_context_t *ctx, const char *text, size_t depth,
+                const char *path) {
+  const size_t iterations = depth < 1000000 ? 1000000 / depth : 1;
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(text, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+
+  char name[64];
+  snprintf(name, sizeof(name), "depth %zu, %s", depth, path);
+  if (error_is_ok(error))
+    bench_report(name, ns / (double)depth, 0);
+  else
+    printf("  %-44s %s\n", name, error.message);
+}
+
+void bench_depth(void) {
+  static const size_t depths[] = {10, 100, 1000, 10000, 100000};
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+  error_t error;
+  engine_eval("x = 1", ctx, &error);
+
+  printf("ns per nesting level, parse included\n");
+  for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+    char *text = nested(depths[d]);
+    if (!text)
+      break;
+    engine_set_cache_capacity(ctx, 0);
+    run(ctx, text, depths[d], "tree walker");
+    engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+    run(ctx, text, depths[d], "compiled");
+    free(text);
+  }
+  engine_context_free(ctx);
+}
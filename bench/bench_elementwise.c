@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIZE 100000
+
+// v * 2 + 1 over a SIZE-element array, as nanoseconds per element
+static double run(engine_context_t *ctx, const char *expr, const char *name,
+                  double baseline) {
+  const size_t iterations = 200;
+  error_t error;
+  bytecode_t *program = engine_compile(expr, ctx, &error);
+  if (!program) {
+    printf("  %-44s %s\n", name, error.message);
+    return 0;
+  }
+
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_exec(program, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)(iterations * SIZE);
+  bytecode_free(program);
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", name, error.message);
+    return 0;
+  }
+  bench_report(name, ns, baseline);
+  printf("  %-44s %12.2f GB/s\n", "", 8.0 / ns);
+  return ns;
+}
+
+static int bind(engine_context_t *ctx, const char *name, double fill) {
+  error_t error;
+  double *data = value_alloc(SIZE);
+  if (!data)
+    return -1;
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = fill ? fill : (double)(i % 1000) * 0.5;
+  int slot = symbol_resolve(ctx->symbols, name, 1, &error);
+  symbol_set(ctx->symbols, (size_t)slot, value_array(data, SIZE));
+  return 0;
+}
+
+void bench_elementwise(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx || bind(ctx, "v", 0) != 0 || bind(ctx, "u", 1) != 0) {
+    engine_context_free(ctx);
+    return;
+  }
+
+  printf("v * 2 + 1 over %d elements, ns per element\n", SIZE);
+  double calls = run(ctx, "vec_add(vec_scale(2, v), u)", "vec_add/vec_scale",
+                     0);
+  run(ctx, "v * 2 + 1", "operators", calls);
+  printf("v * v - v / 3\n");
+  run(ctx, "v * v - v / 3", "operators", 0);
+  engine_context_free(ctx);
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TERMS 400
+
+// A long sum of cheap function calls on a variable: every call and
+// operator reports success through an error_t
+static char *build_expression(void) {
+  char *buf = malloc(TERMS * 48);
+  if (!buf)
+    return NULL;
+  size_t len = 0;
+  for (int i = 0; i < TERMS; i++)
+    len += (size_t)sprintf(buf + len, "%sgcd(x, %d) + mod(x, %d) * %d",
+                           i ? " + " : "", i + 2, i + 3, i);
+  return buf;
+}
+
+static void run(engine_context_t *ctx, const char *expr, const char *name) {
+  const int iterations = 2000;
+  error_t error;
+  double start = bench_now_ns();
+  for (int i = 0; i < iterations; i++) {
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / iterations;
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", name, error.message);
+    return;
+  }
+  bench_report(name, ns / (TERMS * 5), 0);
+}
+
+void bench_errors(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  char *expr = build_expression();
+  if (!ctx || !expr) {
+    engine_context_free(ctx);
+    free(expr);
+    return;
+  }
+  error_t error;
+  engine_eval("x = 360", ctx, &error);
+
+  printf("%d calls and %d operators, ns per node\n", TERMS * 2, TERMS * 3);
+  engine_set_cache_capacity(ctx, 0);
+  run(ctx, expr, "parse, fold and walk the tree");
+  engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+  run(ctx, expr, "compiled");
+  engine_context_free(ctx);
+  free(expr);
+}
@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *formulas[] = {
+    "mat_det(matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 10)) * 2",
+    "ncr(50, 25) / 2",
+    "gcd(48, 18) * lcm(12, 8) + fact(10) - 1 * 7",
+};
+
+// Compile with or without the optimizer and time the resulting program
+static void run(const char *expr, int fold, double baseline, double *out) {
+  const size_t iterations = 200000;
+  error_t error;
+  arena_t *arena = arena_create(0);
+  if (!arena)
+    return;
+
+  ast_t *ast = parse(expr, arena, NULL, &error);
+  if (ast && fold)
+    ast_fold(ast, arena, &error);
+  bytecode_t *program = ast ? bytecode_compile(ast, &error) : NULL;
+  arena_free(arena);
+  if (!program) {
+    printf("  compile failed: %s\n", error.message);
+    return;
+  }
+
+  value_t *scratch =
+      malloc(bytecode_scratch_size(program) * sizeof(value_t));
+  if (!scratch) {
+    bytecode_free(program);
+    return;
+  }
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = bytecode_exec(program, NULL, scratch, &error);
+    value_free(&v);
+  }
+  *out = (bench_now_ns() - start) / (double)iterations;
+
+  char name[64];
+  snprintf(name, sizeof(name), "%s (%zu instructions)",
+           fold ? "folded" : "unfolded", program->code_size);
+  bench_report(name, *out, baseline);
+  free(scratch);
+  bytecode_free(program);
+}
+
+void bench_fold(void) {
+  for (size_t f = 0; f < sizeof(formulas) / sizeof(formulas[0]); f++) {
+    double plain = 0, folded = 0;
+    printf("%s\n", formulas[f]);
+    run(formulas[f], 0, 0, &plain);
+    run(formulas[f], 1, plain, &folded);
+  }
+}
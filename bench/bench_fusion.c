@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIZE 10000000
+
+// Arrays of SIZE doubles each expression moves: one pass per operation
+// when every intermediate is materialized, and just the inputs plus the
+// result when fused
+static const struct {
+  const char *expr;
+  int unfused;
+  int fused;
+} cases[] = {
+    {"vec_add(vec_scale(2, a), b)", 5, 3},
+    {"a * 2 + b * 3 - 1", 8, 3},
+    {"(a - b) * (a + b) / 4", 9, 3},
+};
+
+static double run(engine_context_t *ctx, const char *expr, const char *name,
+                  int arrays, double baseline) {
+  const size_t iterations = 5;
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", name, error.message);
+    return 0;
+  }
+
+  double bytes = (double)arrays * SIZE * sizeof(double);
+  bench_report(name, ns / SIZE, baseline ? baseline / SIZE : 0);
+  printf("  %-44s %8.0f MB moved, %6.2f GB/s\n", "", bytes / 1e6,
+         bytes / ns);
+  return ns;
+}
+
+static int bind(engine_context_t *ctx, const char *name, double scale) {
+  error_t error;
+  double *data = value_alloc(SIZE);
+  if (!data)
+    return -1;
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = (double)(i % 1000) * scale + 1;
+  int slot = symbol_resolve(ctx->symbols, name, 1, &error);
+  symbol_set(ctx->symbols, (size_t)slot, value_array(data, SIZE));
+  return 0;
+}
+
+void bench_fusion(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx || bind(ctx, "a", 0.5) != 0 || bind(ctx, "b", 0.25) != 0) {
+    engine_context_free(ctx);
+    return;
+  }
+
+  printf("%d-element arrays, ns per element\n", SIZE);
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    printf("%s\n", cases[i].expr);
+    engine_set_cache_capacity(ctx, 0);
+    double unfused = run(ctx, cases[i].expr, "tree walker, one array per op",
+                         cases[i].unfused, 0);
+    engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+    run(ctx, cases[i].expr, "compiled, fused", cases[i].fused, unfused);
+  }
+  engine_context_free(ctx);
+}
@@ -0,0 +1,54 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+static double run(engine_context_t *ctx, const char *expr, int jit,
+                  double baseline) {
+  const size_t iterations = 2000000;
+  error_t error;
+  engine_set_jit(ctx, jit);
+  bytecode_t *program = engine_compile(expr, ctx, &error);
+  if (!program) {
+    printf("  compile failed: %s\n", error.message);
+    return 0;
+  }
+  if (jit && !program->native) {
+    printf("  not translated by the JIT\n");
+    bytecode_free(program);
+    return 0;
+  }
+
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_exec(program, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+
+  bench_report(jit ? "jit" : "interpreter", ns, baseline);
+  bytecode_free(program);
+  return ns;
+}
+
+void bench_jit(void) {
+  static const char *formulas[] = {
+      "a*b + c % 7",
+      "(a + b) * (a - b) / (c + 1) - neg(a) * 3",
+      "((a << 3) | (b & 255)) ^ bnot(c) + mod(a * 17, 13)",
+  };
+
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+  error_t error;
+  engine_eval("a = 12.5", ctx, &error);
+  engine_eval("b = 7", ctx, &error);
+  engine_eval("c = 40", ctx, &error);
+
+  for (size_t f = 0; f < sizeof(formulas) / sizeof(formulas[0]); f++) {
+    printf("%s\n", formulas[f]);
+    double interpreted = run(ctx, formulas[f], 0, 0);
+    run(ctx, formulas[f], 1, interpreted);
+  }
+  engine_context_free(ctx);
+}
@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+// Each pair computes the same answer: first with every argument
+// evaluated, then with the expensive one skipped by and(), or() or if()
+static const char *const pairs[][2] = {
+    {"and(is_prime(p), x)", "and(x, is_prime(p))"},
+    {"or(is_prime(p) - 1, x + 1)", "or(x + 1, is_prime(p))"},
+    {"x * is_prime(p) + 2", "if(x, is_prime(p), 2)"},
+};
+
+static double run(engine_context_t *ctx, const char *expr, const char *name,
+                  double baseline) {
+  const size_t iterations = 2000;
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(expr, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", name, error.message);
+    return 0;
+  }
+  bench_report(name, ns, baseline);
+  return ns;
+}
+
+void bench_lazy(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+  error_t error;
+  engine_eval("x = 0", ctx, &error);
+  engine_eval("p = 1000000007", ctx, &error);
+
+  for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+    printf("%s\n", pairs[i][1]);
+    engine_set_cache_capacity(ctx, 0);
+    double eager = run(ctx, pairs[i][0], "tree walker, eager", 0);
+    run(ctx, pairs[i][1], "tree walker, lazy", eager);
+    engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+    eager = run(ctx, pairs[i][0], "compiled, eager", 0);
+    run(ctx, pairs[i][1], "compiled, lazy", eager);
+  }
+  engine_context_free(ctx);
+}
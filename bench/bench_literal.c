@@ -0,0 +1,70 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An n x n matrix spelled as matrix(n, n, ...) or as [[...], ...]
+static char *spell(size_t n, int literal) {
+  char *text = malloc(n * n * 8 + 64);
+  if (!text)
+    return NULL;
+  size_t len = literal ? (size_t)sprintf(text, "[")
+                       : (size_t)sprintf(text, "matrix(%zu, %zu", n, n);
+  for (size_t r = 0; r < n; r++) {
+    if (literal)
+      len += (size_t)sprintf(text + len, r ? ", [" : "[");
+    for (size_t c = 0; c < n; c++) {
+      const char *sep = literal && c == 0 ? "" : ", ";
+      len += (size_t)sprintf(text + len, "%s%zu.5", sep, (r * n + c) % 97);
+    }
+    if (literal)
+      text[len++] = ']';
+  }
+  strcpy(text + len, literal ? "]" : ")");
+  return text;
+}
+
+static void run(engine_context_t *ctx, const char *text, const char *name) {
+  const size_t iterations = strlen(text) < 100000 ? 200 : 5;
+  error_t error;
+  double start = bench_now_ns();
+  for (size_t i = 0; i < iterations; i++) {
+    value_t v = engine_eval(text, ctx, &error);
+    value_free(&v);
+  }
+  double ns = (bench_now_ns() - start) / (double)iterations;
+  if (!error_is_ok(error)) {
+    printf("  %-44s %s\n", name, error.message);
+    return;
+  }
+  bench_report(name, ns, 0);
+}
+
+void bench_literal(void) {
+  static const size_t sizes[] = {10, 100, 1000};
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+
+  printf("ns per evaluation, parse included (tree walker) or cached "
+         "(compiled)\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for (int literal = 0; literal <= 1; literal++) {
+      char *text = spell(sizes[s], literal);
+      if (!text)
+        break;
+      char name[64];
+      snprintf(name, sizeof(name), "%zux%zu %s, tree walker", sizes[s],
+               sizes[s], literal ? "[[...]]" : "matrix()");
+      engine_set_cache_capacity(ctx, 0);
+      run(ctx, text, name);
+      snprintf(name, sizeof(name), "%zux%zu %s, compiled", sizes[s],
+               sizes[s], literal ? "[[...]]" : "matrix()");
+      engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+      run(ctx, text, name);
+      free(text);
+    }
+  }
+  engine_context_free(ctx);
+}
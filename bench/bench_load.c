@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Raw file of `count` doubles under /tmp; returns its path or NULL
+static const char *write_file(size_t count) {
+  static char path[64];
+  snprintf(path, sizeof(path), "/tmp/calc42-bench-%ld.bin", (long)getpid());
+  FILE *file = fopen(path, "wb");
+  if (!file)
+    return NULL;
+  double block[4096];
+  for (size_t i = 0; i < count; i += 4096) {
+    size_t n = count - i < 4096 ? count - i : 4096;
+    for (size_t j = 0; j < n; j++)
+      block[j] = (double)((i + j) % 1000) + 0.5;
+    if (fwrite(block, sizeof(double), n, file) != n) {
+      fclose(file);
+      remove(path);
+      return NULL;
+    }
+  }
+  fclose(file);
+  return path;
+}
+
+// What loading cost before: read the whole file into a heap buffer
+static double read_copy(const char *path, size_t count) {
+  double start = bench_now_ns();
+  int fd = open(path, O_RDONLY);
+  double *data = malloc(count * sizeof(double));
+  size_t done = 0, total = count * sizeof(double);
+  ssize_t got = 1;
+  while (fd >= 0 && data && done < total && got > 0) {
+    got = read(fd, (char *)data + done, total - done);
+    done += got > 0 ? (size_t)got : 0;
+  }
+  free(data);
+  if (fd >= 0)
+    close(fd);
+  return bench_now_ns() - start;
+}
+
+static double eval(engine_context_t *ctx, const char *text, error_t *error) {
+  double start = bench_now_ns();
+  value_t v = engine_eval(text, ctx, error);
+  value_free(&v);
+  return bench_now_ns() - start;
+}
+
+void bench_load(void) {
+  static const size_t sizes[] = {1000000, 12500000};
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+
+  printf("ns per call, file in the page cache\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    const char *path = write_file(sizes[s]);
+    if (!path)
+      break;
+    char text[128], name[64];
+    error_t error = error_create(ERR_NONE, NULL);
+    const size_t iterations = 10;
+    double copy = 0, load = 0, mean = 0;
+    for (size_t i = 0; i < iterations; i++) {
+      copy += read_copy(path, sizes[s]);
+      snprintf(text, sizeof(text), "load_raw(\"%s\")", path);
+      load += eval(ctx, text, &error);
+      snprintf(text, sizeof(text), "mean(load_raw(\"%s\"))", path);
+      mean += eval(ctx, text, &error);
+    }
+    remove(path);
+    if (!error_is_ok(error)) {
+      printf("  %-44s %s\n", "load_raw", error.message);
+      break;
+    }
+    double mb = (double)sizes[s] * sizeof(double) / 1e6;
+    snprintf(name, sizeof(name), "%.0f MB, read() into the heap", mb);
+    bench_report(name, copy / (double)iterations, 0);
+    snprintf(name, sizeof(name), "%.0f MB, load_raw()", mb);
+    bench_report(name, load / (double)iterations, copy / (double)iterations);
+    snprintf(name, sizeof(name), "%.0f MB, mean(load_raw())", mb);
+    bench_report(name, mean / (double)iterations, 0);
+  }
+  engine_context_free(ctx);
+}
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} bench_suite_t;
+
+static const bench_suite_t suites[] = {
+    {"vm", bench_vm},
+    {"arena", bench_arena},
+    {"ast", bench_ast},
+    {"tokenizer", bench_tokenizer},
+    {"cache", bench_cache},
+    {"fold", bench_fold},
+    {"cse", bench_cse},
+    {"columns", bench_columns},
+    {"jit", bench_jit},
+    {"batch", bench_batch},
+    {"depth", bench_depth},
+    {"lazy", bench_lazy},
+    {"elementwise", bench_elementwise},
+    {"fusion", bench_fusion},
+    {"cow", bench_cow},
+    {"small", bench_small},
+    {"spans", bench_spans},
+    {"decimal", bench_decimal},
+    {"errors", bench_errors},
+    {"parse", bench_parse},
+    {"literal", bench_literal},
+    {"load", bench_load},
+    {"stats", bench_stats},
+};
+
+static const size_t suite_count = sizeof(suites) / sizeof(suites[0]);
+
+double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+void bench_report(const char *name, double ns_per_op, double baseline_ns) {
+  if (baseline_ns > 0) {
+    printf("  %-44s %12.1f ns/op  (%.2fx)\n", name, ns_per_op,
+           baseline_ns / ns_per_op);
+  } else {
+    printf("  %-44s %12.1f ns/op\n", name, ns_per_op);
+  }
+}
+
+int main(int argc, char **argv) {
+  int ran = 0;
+
+  for (size_t i = 0; i < suite_count; i++) {
+    int selected = argc < 2;
+    for (int j = 1; j < argc; j++) {
+      if (strcmp(argv[j], suites[i].name) == 0)
+        selected = 1;
+    }
+    if (!selected)
+      continue;
+
+    printf("== %s ==\n", suites[i].name);
+    suites[i].run();
+    printf("\n");
+    ran++;
+  }
+
+  if (ran == 0) {
+    fprintf(stderr, "Usage: %s [suite...]\nSuites:", argv[0]);
+    for (size_t i = 0; i < suite_count; i++)
+      fprintf(stderr, " %s", suites[i].name);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "common/memory.h"
+#include "engine/parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A flat mix of literals, operators, groups and calls, about `size` bytes
+// long: 12.5 * (7 - 3) + mean(4, 9) % 5 << 1 | ...
+static char *generate(size_t size) {
+  static const char *const ops[] = {" + ", " - ", " * ", " / ",
+                                    " % ", " & ", " | ", " << "};
+  char *text = malloc(size + 64);
+  if (!text)
+    return NULL;
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  size_t len = 0;
+  while (len < size) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (len)
+      len += (size_t)sprintf(text + len, "%s", ops[state % 8]);
+    switch ((state >> 8) % 4) {
+    case 0:
+      len += (size_t)sprintf(text + len, "%u", (unsigned)(state >> 40) % 1000);
+      break;
+    case 1:
+      len += (size_t)sprintf(text + len, "%u.%u", (unsigned)(state >> 32) % 100,
+                             (unsigned)(state >> 48) % 100);
+      break;
+    case 2:
+      len += (size_t)sprintf(text + len, "(%u - %u)",
+                             (unsigned)(state >> 24) % 50 + 1,
+                             (unsigned)(state >> 44) % 50);
+      break;
+    default:
+      len += (size_t)sprintf(text + len, "mean(%u, %u)",
+                             (unsigned)(state >> 20) % 100,
+                             (unsigned)(state >> 50) % 100);
+      break;
+    }
+  }
+  return text;
+}
+
+void bench_parse(void) {
+  static const size_t sizes[] = {1000, 100000, 10000000};
+  arena_t *arena = arena_create(0);
+  if (!arena)
+    return;
+
+  printf("ns per input byte, parse only\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    char *text = generate(sizes[s]);
+    if (!text)
+      break;
+    size_t length = strlen(text);
+    const size_t iterations = 20000000 / length + 3;
+    error_t error;
+    size_t nodes = 0;
+    double start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+      ast_t *ast = parse(text, arena, NULL, &error);
+      nodes = ast ? ast->node_count : 0;
+      arena_reset(arena);
+    }
+    double ns = (bench_now_ns() - start) / (double)iterations;
+
+    char name[64];
+    snprintf(name, sizeof(name), "%zu-byte expression", length);
+    if (!error_is_ok(error)) {
+      printf("  %-44s %s\n", name, error.message);
+    } else {
+      bench_report(name, ns / (double)length, 0);
+      printf("  %-44s %12.1f MB/s   (%zu nodes)\n", "",
+             (double)length / ns * 1e3, nodes);
+    }
+    free(text);
+  }
+  arena_free(arena);
+}
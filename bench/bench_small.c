@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+// Typical linear algebra input: short vectors and 2x2 to 4x4 matrices.
+// Their buffers come from the per-thread free list once it has warmed
+// up, so the loop should take nothing from the heap.
+static const char *const corpus[] = {
+    "vector(1, 2, 3)",
+    "vector(1, 2, 3) * 2 + vector(4, 5, 6)",
+    "vec_add(1, 2, 3, 4, 5, 6)",
+    "vec_dot(1, 2, 3, 4, 5, 6) + vec_mag(3, 4)",
+    "mat_mul(matrix(2, 2, 1, 2, 3, 4), matrix(2, 2, 5, 6, 7, 8))",
+    "mat_det(matrix(3, 3, 2, 0, 1, 1, 3, 2, 1, 1, 1))",
+    "mat_transpose(matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 9)) - 1",
+    "mat_vec_mul(matrix(4, 4, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, "
+    "1), vector(1, 2, 3, 4))",
+};
+
+void bench_small(void) {
+  const size_t corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+  const int iterations = 20000;
+  engine_context_t *ctx = engine_context_create(MODE_LINEAR_ALGEBRA);
+  if (!ctx)
+    return;
+
+  error_t error;
+  for (size_t i = 0; i < corpus_size; i++) {
+    value_t v = engine_eval(corpus[i], ctx, &error);
+    value_free(&v);
+  }
+
+  size_t before = value_heap_allocations();
+  double start = bench_now_ns();
+  for (int n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < corpus_size; i++) {
+      value_t v = engine_eval(corpus[i], ctx, &error);
+      value_free(&v);
+    }
+  }
+  double ns = (bench_now_ns() - start) / (double)(iterations * corpus_size);
+  size_t buffers = value_heap_allocations() - before;
+
+  printf("%zu linear algebra expressions, per evaluation\n", corpus_size);
+  bench_report("corpus", ns, 0);
+  printf("  %-44s %12.2f\n", "  array buffers from the heap",
+         (double)buffers / (double)(iterations * corpus_size));
+  engine_context_free(ctx);
+}
@@ -0,0 +1,47 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+
+#define SIZE 1000000
+
+// Reducers over several arguments, each of which used to be copied into
+// one flattened buffer first
+static const char *const cases[] = {"mean(v, w)", "var(v, 1, w)",
+                                    "stddev(v, w, 2, 3)", "zscore(5, v, w)"};
+
+static int bind(engine_context_t *ctx, const char *name, double scale) {
+  error_t error;
+  double *data = value_alloc(SIZE);
+  if (!data)
+    return -1;
+  for (size_t i = 0; i < SIZE; i++)
+    data[i] = (double)(i % 1000) * scale;
+  int slot = symbol_resolve(ctx->symbols, name, 1, &error);
+  symbol_set(ctx->symbols, (size_t)slot, value_array(data, SIZE));
+  return 0;
+}
+
+void bench_spans(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STATISTICS);
+  if (!ctx || bind(ctx, "v", 0.5) != 0 || bind(ctx, "w", 0.25) != 0) {
+    engine_context_free(ctx);
+    return;
+  }
+
+  printf("two %d-element arrays, ns per element read\n", SIZE);
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const size_t iterations = 50;
+    error_t error;
+    double start = bench_now_ns();
+    for (size_t n = 0; n < iterations; n++) {
+      value_t v = engine_eval(cases[i], ctx, &error);
+      value_free(&v);
+    }
+    double ns = (bench_now_ns() - start) / (double)(iterations * 2 * SIZE);
+    if (!error_is_ok(error))
+      printf("  %-44s %s\n", cases[i], error.message);
+    else
+      bench_report(cases[i], ns, 0);
+  }
+  engine_context_free(ctx);
+}
@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "engine/statistics.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static volatile double sink;
+
+void bench_stats(void) {
+  static const size_t sizes[] = {1000, 1000000, 10000000};
+  printf("ns per value\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    double *x = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    if (!x || !y) {
+      free(x);
+      free(y);
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      x[i] = 1e6 + (double)(i * 7919 % 1000) * 0.25;
+      y[i] = x[i] * 0.5 + (double)(i % 13);
+    }
+    span_t span = {x, n};
+    dataset_t set = {&span, 1, n};
+    const size_t iterations = 50000000 / n + 1;
+    error_t error;
+    char name[64];
+
+    double start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++)
+      sink = stats_stddev(&set, &error);
+    snprintf(name, sizeof(name), "stddev, %zu values", n);
+    bench_report(name, (bench_now_ns() - start) / (double)(iterations * n),
+                 0);
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++)
+      sink = stats_zscore(x[i % n], &set, &error);
+    snprintf(name, sizeof(name), "zscore, %zu values", n);
+    bench_report(name, (bench_now_ns() - start) / (double)(iterations * n),
+                 0);
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++)
+      sink = stats_correlation(x, n, y, n, &error);
+    snprintf(name, sizeof(name), "correlation, %zu pairs", n);
+    bench_report(name, (bench_now_ns() - start) / (double)(iterations * n),
+                 0);
+    free(x);
+    free(y);
+  }
+}
@@ -0,0 +1,58 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Machine-generated input: a long sum of numeric literals
+static char *build_expression(size_t target_bytes) {
+  char *buf = malloc(target_bytes + 64);
+  if (!buf)
+    return NULL;
+
+  size_t len = (size_t)snprintf(buf, 64, "0.5");
+  for (unsigned i = 1; len < target_bytes; i++)
+    len += (size_t)snprintf(buf + len, 64, " + %u.%03u * 0x%X", i, i % 1000,
+                            i & 0xFFF);
+  return buf;
+}
+
+void bench_tokenizer(void) {
+  const size_t size = 4u << 20;
+  const int rounds = 10;
+  char *expr = build_expression(size);
+  if (!expr)
+    return;
+
+  size_t tokens = 0;
+  double start = bench_now_ns();
+  for (int r = 0; r < rounds; r++) {
+    tokenizer_t tok;
+    token_t token;
+    tokenizer_init(&tok, expr);
+    while (tokenizer_next(&tok, &token) > 0)
+      tokens++;
+  }
+  double ns = (bench_now_ns() - start) / rounds;
+  printf("  %zu bytes, %zu tokens\n", size, tokens / rounds);
+  bench_report("tokenizer_next (per token)", ns / (double)(tokens / rounds),
+               0);
+  printf("  %-44s %12.1f MB/s\n", "tokenizer throughput",
+         (double)size / ns * 1e3);
+
+  arena_t *arena = arena_create(0);
+  if (arena) {
+    error_t error;
+    start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+      if (!parse(expr, arena, NULL, &error))
+        printf("  parse failed: %s\n", error.message);
+      arena_reset(arena);
+    }
+    ns = (bench_now_ns() - start) / rounds;
+    printf("  %-44s %12.1f MB/s\n", "parse throughput",
+           (double)size / ns * 1e3);
+    arena_free(arena);
+  }
+
+  free(expr);
+}
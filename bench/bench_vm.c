@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "engine/engine.h"
+#include <stdio.h>
+#include <string.h>
+
+// Formulas representative of the repeated-evaluation workload
+static const char *formulas[] = {
+    "3 + 4 * 2",
+    "(1 + 2) * (3 + 4) - 5 / 2 + 6 % 4",
+    "0xFF & 0x0F | 1 << 4 ^ 3",
+    "gcd(48, 18) * lcm(12, 8) + mod(100, 7)",
+    "mean(1, 2, 3, 4, 5) + stddev(4, 5, 6) * var(7, 8, 9)",
+    "mat_det(matrix(3, 3, 1, 2, 3, 4, 5, 6, 7, 8, 10)) * 2",
+};
+
+void bench_vm(void) {
+  const size_t iterations = 200000;
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  if (!ctx)
+    return;
+
+  for (size_t f = 0; f < sizeof(formulas) / sizeof(formulas[0]); f++) {
+    const char *expr = formulas[f];
+    error_t error;
+    printf("%s\n", expr);
+
+    double start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+      value_t v = engine_eval(expr, ctx, &error);
+      value_free(&v);
+    }
+    double eval_ns = (bench_now_ns() - start) / (double)iterations;
+    bench_report("engine_eval (parse + tree walk)", eval_ns, 0);
+
+    bytecode_t *program = engine_compile(expr, ctx, &error);
+    if (!program) {
+      printf("  compile failed: %s\n", error.message);
+      continue;
+    }
+
+    // Both paths must agree before their timings mean anything
+    value_t expected = engine_eval(expr, ctx, &error);
+    value_t actual = engine_exec(program, ctx, &error);
+    char *expected_str = value_to_string(&expected, 10);
+    char *actual_str = value_to_string(&actual, 10);
+    if (strcmp(expected_str, actual_str) != 0)
+      printf("  MISMATCH: eval=%s exec=%s\n", expected_str, actual_str);
+    safe_free(expected_str);
+    safe_free(actual_str);
+    value_free(&expected);
+    value_free(&actual);
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+      value_t v = engine_exec(program, ctx, &error);
+      value_free(&v);
+    }
+    double exec_ns = (bench_now_ns() - start) / (double)iterations;
+    bench_report("engine_exec (precompiled bytecode)", exec_ns, eval_ns);
+
+    bytecode_free(program);
+  }
+
+  engine_context_free(ctx);
+}
@@ -0,0 +1,43 @@
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h>
+
+/**
+ * Longest expression a fuzzer generates
+ */
+#define FUZZ_TEXT_MAX 32768
+
+/**
+ * Expression being generated
+ */
+typedef struct {
+  char data[FUZZ_TEXT_MAX];
+  size_t length;
+} fuzz_text_t;
+
+/**
+ * Uniform pseudo-random number in [0, n), from a fixed seed so that every
+ * run generates the same expressions
+ */
+unsigned fuzz_random(unsigned n);
+
+/**
+ * Append formatted text; anything past FUZZ_TEXT_MAX is dropped
+ */
+void fuzz_append(fuzz_text_t *text, const char *format, ...);
+
+/**
+ * Report a mismatch; only the first few are printed
+ */
+void fuzz_mismatch(const char *expression, const char *expected,
+                   const char *got);
+
+/**
+ * Fuzz suites: each runs iterations random expressions through two
+ * evaluators and returns the number of mismatches
+ */
+size_t fuzz_jit(size_t iterations);
+size_t fuzz_eval(size_t iterations);
+
+#endif // FUZZ_H
@@ -0,0 +1,120 @@
+#include "common/memory.h"
+#include "engine/engine.h"
+#include "fuzz.h"
+#include <stdio.h>
+#include <string.h>
+
+// Random expression over numbers, arrays and calls: the numbers x and y,
+// the array v, operators, prefix '-' and '~', and calls that take or
+// build arrays
+static void generate(fuzz_text_t *text, int depth) {
+  static const char *operators[] = {"+", "-", "*", "/", "%", "&", "<<"};
+  static const char *unary[] = {"neg", "mean", "vec_mag"};
+  static const char *binary[] = {"vec_scale", "gcd", "vec_add"};
+
+  if (depth == 0 || fuzz_random(4) == 0) {
+    unsigned kind = fuzz_random(6);
+    if (kind < 3)
+      fuzz_append(text, "%c", "xyv"[kind]);
+    else if (kind == 3)
+      fuzz_append(text, "[%u, %u, 3]", fuzz_random(9), fuzz_random(9));
+    else
+      fuzz_append(text, "%u", fuzz_random(20));
+    return;
+  }
+
+  unsigned kind = fuzz_random(17);
+  if (kind < 7) {
+    fuzz_append(text, "(");
+    generate(text, depth - 1);
+    fuzz_append(text, "%s", operators[kind]);
+    generate(text, depth - 1);
+    fuzz_append(text, ")");
+  } else if (kind < 9) {
+    fuzz_append(text, "%c", kind == 7 ? '-' : '~');
+    generate(text, depth - 1);
+  } else if (kind < 12) {
+    fuzz_append(text, "%s(", unary[kind - 9]);
+    generate(text, depth - 1);
+    fuzz_append(text, ")");
+  } else if (kind < 15) {
+    fuzz_append(text, "%s(", binary[kind - 12]);
+    generate(text, depth - 1);
+    fuzz_append(text, ", ");
+    generate(text, depth - 1);
+    fuzz_append(text, ")");
+  } else {
+    fuzz_append(text, "if(");
+    generate(text, depth - 1);
+    fuzz_append(text, ", ");
+    generate(text, depth - 1);
+    fuzz_append(text, ", ");
+    generate(text, depth - 1);
+    fuzz_append(text, ")");
+  }
+}
+
+// Printed result, or the error message; owned by the caller
+static char *describe(const value_t *value, const error_t *error) {
+  if (error_is_ok(*error))
+    return value_to_string(value, 10);
+  char *message = safe_malloc(strlen(error->message) + 1);
+  if (message)
+    strcpy(message, error->message);
+  return message;
+}
+
+// engine_eval with the cache compiles to bytecode (and fuses element-wise
+// chains); without it the tree walker runs. Both must print the same
+// result or error, assignments included.
+size_t fuzz_eval(size_t iterations) {
+  static const char *setup[] = {"x = 3", "y = 7.5", "v = [1, 2, 3]"};
+  engine_context_t *vm = engine_context_create(MODE_STANDARD);
+  engine_context_t *tree = engine_context_create(MODE_STANDARD);
+  if (!vm || !tree || engine_set_cache_capacity(tree, 0) != 0) {
+    engine_context_free(vm);
+    engine_context_free(tree);
+    return 1;
+  }
+  error_t vm_error, tree_error;
+  for (size_t i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) {
+    engine_eval(setup[i], vm, &vm_error);
+    engine_eval(setup[i], tree, &tree_error);
+  }
+
+  size_t failed = 0, mismatches = 0;
+  static fuzz_text_t text;
+  for (size_t i = 0; i < iterations; i++) {
+    text.length = 0;
+    if (fuzz_random(10) == 0)
+      fuzz_append(&text, "z = ");
+    size_t start = text.length;
+    generate(&text, 1 + (int)fuzz_random(5));
+    // Repeated subtrees are shared
+    if (fuzz_random(2) == 0) {
+      size_t length = text.length - start;
+      fuzz_append(&text, " + %.*s", (int)length, text.data + start);
+    }
+
+    value_t a = engine_eval(text.data, vm, &vm_error);
+    value_t b = engine_eval(text.data, tree, &tree_error);
+    char *expected = describe(&a, &vm_error);
+    char *got = describe(&b, &tree_error);
+    failed += !error_is_ok(vm_error);
+    if (!expected || !got || strcmp(expected, got) != 0) {
+      fuzz_mismatch(text.data, expected ? expected : "(out of memory)",
+                    got ? got : "(out of memory)");
+      mismatches++;
+    }
+    safe_free(expected);
+    safe_free(got);
+    value_free(&a);
+    value_free(&b);
+  }
+
+  printf("  %zu expressions, %zu errors, %zu mismatches\n", iterations,
+         failed, mismatches);
+  engine_context_free(vm);
+  engine_context_free(tree);
+  return mismatches;
+}
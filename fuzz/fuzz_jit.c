@@ -0,0 +1,127 @@
+#include "engine/engine.h"
+#include "fuzz.h"
+#include <stdio.h>
+#include <string.h>
+
+// Random scalar expression in the JIT's subset: numbers, the variables
+// x, y and z, every binary operator, and neg, bnot, not and mod
+static void generate(fuzz_text_t *text, int depth) {
+  static const char *operators[] = {"+", "-", "*", "/",  "%",
+                                    "&", "|", "^", "<<", ">>"};
+  static const char *functions[] = {"neg", "bnot", "not", "mod"};
+
+  if (depth == 0 || fuzz_random(4) == 0) {
+    unsigned kind = fuzz_random(6);
+    if (kind < 3)
+      fuzz_append(text, "%c", "xyz"[kind]);
+    else if (kind == 3)
+      fuzz_append(text, "%u", fuzz_random(70));
+    else if (kind == 4)
+      fuzz_append(text, "%u.5", fuzz_random(9));
+    else
+      fuzz_append(text, "0");
+    return;
+  }
+
+  unsigned kind = fuzz_random(14);
+  if (kind < 10) {
+    fuzz_append(text, "(");
+    generate(text, depth - 1);
+    fuzz_append(text, "%s", operators[kind]);
+    generate(text, depth - 1);
+    fuzz_append(text, ")");
+    return;
+  }
+  fuzz_append(text, "%s(", functions[kind - 10]);
+  generate(text, depth - 1);
+  if (kind == 13) {
+    fuzz_append(text, ", ");
+    generate(text, depth - 1);
+  }
+  fuzz_append(text, ")");
+}
+
+static void describe(char *buffer, size_t size, const value_t *value,
+                     const error_t *error) {
+  if (!error_is_ok(*error))
+    snprintf(buffer, size, "error: %.100s", error->message);
+  else
+    snprintf(buffer, size, "%.17g", value->as.number);
+}
+
+// The same program compiled with and without native code must give the
+// same bits, or the same error
+size_t fuzz_jit(size_t iterations) {
+  engine_context_t *vm = engine_context_create(MODE_STANDARD);
+  engine_context_t *jit = engine_context_create(MODE_STANDARD);
+  if (!vm || !jit) {
+    engine_context_free(vm);
+    engine_context_free(jit);
+    return 1;
+  }
+  engine_set_jit(jit, 1);
+
+  size_t programs = 0, translated = 0, failed = 0, mismatches = 0;
+  static fuzz_text_t text;
+  for (size_t i = 0; i < iterations; i++) {
+    error_t vm_error, jit_error;
+    if (i % 50 == 0) {
+      for (size_t v = 0; v < 3; v++) {
+        char assignment[64];
+        snprintf(assignment, sizeof(assignment), "%c = %d.%d", "xyz"[v],
+                 (int)fuzz_random(200) - 100, (int)fuzz_random(4) * 25);
+        engine_eval(assignment, vm, &vm_error);
+        engine_eval(assignment, jit, &jit_error);
+      }
+    }
+
+    text.length = 0;
+    generate(&text, 1 + (int)fuzz_random(6));
+    // Repeated subtrees exercise shared locals
+    if (fuzz_random(3) == 0) {
+      size_t length = text.length;
+      fuzz_append(&text, " + %.*s * %.*s", (int)length, text.data,
+                  (int)length, text.data);
+    }
+
+    bytecode_t *interpreted = engine_compile(text.data, vm, &vm_error);
+    bytecode_t *native = engine_compile(text.data, jit, &jit_error);
+    if (!interpreted || !native) {
+      if (!interpreted != !native)
+        fuzz_mismatch(text.data, "both compile or neither",
+                      "only one compiled");
+      mismatches += !interpreted != !native;
+      bytecode_free(interpreted);
+      bytecode_free(native);
+      continue;
+    }
+    programs++;
+    translated += native->native != NULL;
+
+    value_t a = engine_exec(interpreted, vm, &vm_error);
+    value_t b = engine_exec(native, jit, &jit_error);
+    int same = error_is_ok(vm_error) == error_is_ok(jit_error);
+    if (same && !error_is_ok(vm_error))
+      same = strcmp(vm_error.message, jit_error.message) == 0;
+    else if (same)
+      same = memcmp(&a.as.number, &b.as.number, sizeof(double)) == 0;
+    failed += !error_is_ok(vm_error);
+    if (!same) {
+      char expected[128], got[128];
+      describe(expected, sizeof(expected), &a, &vm_error);
+      describe(got, sizeof(got), &b, &jit_error);
+      fuzz_mismatch(text.data, expected, got);
+      mismatches++;
+    }
+    value_free(&a);
+    value_free(&b);
+    bytecode_free(interpreted);
+    bytecode_free(native);
+  }
+
+  printf("  %zu programs, %zu translated, %zu errors, %zu mismatches\n",
+         programs, translated, failed, mismatches);
+  engine_context_free(vm);
+  engine_context_free(jit);
+  return mismatches;
+}
@@ -0,0 +1,88 @@
+#include "fuzz.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  size_t (*run)(size_t iterations);
+  size_t iterations; // Default; -n overrides it
+} fuzz_suite_t;
+
+static const fuzz_suite_t suites[] = {
+    {"jit", fuzz_jit, 200000},
+    {"eval", fuzz_eval, 100000},
+};
+
+static const size_t suite_count = sizeof(suites) / sizeof(suites[0]);
+
+// Mismatches printed per suite before the rest are only counted
+#define FUZZ_REPORTED 10
+
+static uint64_t state = 88172645463325252ULL;
+static size_t reported;
+
+unsigned fuzz_random(unsigned n) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return (unsigned)(state % n);
+}
+
+void fuzz_append(fuzz_text_t *text, const char *format, ...) {
+  size_t room = FUZZ_TEXT_MAX - text->length;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(text->data + text->length, room, format, args);
+  va_end(args);
+  if (written > 0)
+    text->length += (size_t)written < room ? (size_t)written : room - 1;
+}
+
+void fuzz_mismatch(const char *expression, const char *expected,
+                   const char *got) {
+  if (reported++ >= FUZZ_REPORTED)
+    return;
+  printf("  MISMATCH %.200s\n    expected %s\n    got      %s\n", expression,
+         expected, got);
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 0;
+  int first = 1;
+  if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+    iterations = strtoul(argv[2], NULL, 10);
+    first = 3;
+  }
+
+  int ran = 0;
+  size_t mismatches = 0;
+  for (size_t i = 0; i < suite_count; i++) {
+    int selected = argc <= first;
+    for (int j = first; j < argc; j++) {
+      if (strcmp(argv[j], suites[i].name) == 0)
+        selected = 1;
+    }
+    if (!selected)
+      continue;
+
+    printf("== %s ==\n", suites[i].name);
+    reported = 0;
+    mismatches +=
+        suites[i].run(iterations ? iterations : suites[i].iterations);
+    printf("\n");
+    ran++;
+  }
+
+  if (ran == 0) {
+    fprintf(stderr, "Usage: %s [-n iterations] [suite...]\nSuites:",
+            argv[0]);
+    for (size_t i = 0; i < suite_count; i++)
+      fprintf(stderr, " %s", suites[i].name);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  return mismatches == 0 ? 0 : 1;
+}
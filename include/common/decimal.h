@@ -0,0 +1,13 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+/**
+ * Parse a decimal number: [+-]digits[.digits][(e|E)[+-]digits]
+ * Correctly rounded and independent of the locale: '.' is always the
+ * decimal point. Hex floats, inf and nan are not accepted.
+ * Stores the end of the number in *end (s when there is none; end may
+ * be NULL)
+ */
+double decimal_parse(const char *s, const char **end);
+
+#endif // DECIMAL_H
@@ -19,6 +19,7 @@ typedef enum {
     ERR_UNSUPPORTED,      // Unsupported operation
     ERR_PARSE,            // Parse error
     ERR_EVAL,             // Evaluation error
+    ERR_IO,               // File could not be opened or read
     ERR_UNKNOWN           // Unknown error
 } error_code_t;
 
@@ -49,12 +50,34 @@ const char *error_to_string(error_code_t code);
 
 /**
  * Check if error represents success
+ * Inline, so the error_t argument is never actually copied
  */
-int error_is_ok(error_t err);
+static inline int error_is_ok(error_t err) {
+    return err.code == ERR_NONE;
+}
 
 /**
  * Clear error state
  */
-error_t error_ok(void);
+static inline error_t error_ok(void) {
+    error_t err;
+    err.code = ERR_NONE;
+    err.has_position = 0;
+    err.position = 0;
+    err.message[0] = '\0';
+    return err;
+}
+
+/**
+ * Report success in place: writes the few fields that matter instead of
+ * assigning a whole error_t, which is what the hot paths (every call,
+ * operator and library function) do on success
+ */
+static inline void error_clear(error_t *err) {
+    err->code = ERR_NONE;
+    err->has_position = 0;
+    err->position = 0;
+    err->message[0] = '\0';
+}
 
 #endif // ERROR_H
@@ -14,6 +14,7 @@ typedef enum {
 /**
  * Initialize logger
  * If filename is NULL, logs to stdout only
+ * All logger functions may be called from any thread
  */
 int logger_init(const char *filename);
 
@@ -26,6 +26,55 @@ void *safe_realloc(void *ptr, size_t new_size);
  */
 void safe_free(void *ptr);
 
+/**
+ * Arena block (bump-allocated storage)
+ */
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;        // Usable bytes in data
+    size_t used;        // Bytes handed out so far
+    unsigned char data[];
+} arena_block_t;
+
+/**
+ * Bump allocator: individual allocations are never freed, the whole
+ * arena is released at once by arena_reset() or arena_free()
+ */
+typedef struct {
+    arena_block_t *head;        // Block currently bumped from
+    size_t block_size;          // Minimum size of new blocks
+    size_t heap_allocations;    // Blocks malloc'd over the arena's lifetime
+} arena_t;
+
+/**
+ * Create an arena whose blocks hold at least block_size bytes
+ * (0 selects a default)
+ */
+arena_t *arena_create(size_t block_size);
+
+/**
+ * Allocate size bytes, aligned for any type
+ * Returns NULL on failure
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Allocate zeroed storage for count elements of size bytes
+ */
+void *arena_calloc(arena_t *arena, size_t count, size_t size);
+
+/**
+ * Release every allocation at once
+ * Keeps a single block large enough for everything allocated since the
+ * last reset, so a repeated workload stops touching the heap.
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * Free the arena and all of its blocks
+ */
+void arena_free(arena_t *arena);
+
 /**
  * Dynamic array structure
  */
@@ -34,6 +83,7 @@ typedef struct {
     size_t size;        // Current number of elements
     size_t capacity;    // Allocated capacity
     size_t elem_size;   // Size of each element
+    arena_t *arena;     // Backing arena, or NULL for heap storage
 } darray_t;
 
 /**
@@ -41,6 +91,13 @@ typedef struct {
  */
 darray_t *darray_create(size_t elem_size, size_t initial_capacity);
 
+/**
+ * Create a dynamic array that draws its storage from an arena
+ * darray_free() is a no-op for these; arena_reset() releases them.
+ */
+darray_t *darray_create_in(arena_t *arena, size_t elem_size,
+                           size_t initial_capacity);
+
 /**
  * Append an element to the array
  * Returns 0 on success, -1 on failure
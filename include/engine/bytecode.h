@@ -0,0 +1,126 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "common/error.h"
+#include "engine/parser.h"
+#include "engine/symbols.h"
+#include <stdint.h>
+
+struct jit_code;
+
+/**
+ * VM opcodes
+ * The arithmetic opcodes follow binary_op_t order so that
+ * OP_ADD + op maps a binary operator to its instruction.
+ */
+typedef enum {
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_SHL,
+  OP_SHR,
+  OP_PUSH, // Push constants[operand]
+  OP_CALL, // Call function_id_t operand with argc values from the stack
+  OP_STORE_LOCAL, // Move top of stack into locals[operand], leave a view
+  OP_LOAD_LOCAL,  // Push a view of locals[operand]
+  OP_LOAD_VAR,    // Push a view of variable slot operand
+  OP_STORE_VAR,   // Store top of stack into variable slot operand
+  OP_JUMP,          // Continue at instruction operand
+  OP_JUMP_IF_FALSE, // Pop an if() condition, jump to operand when false
+  OP_TEST_AND, // If the top is falsy, replace argc values with 0 and jump
+  OP_TEST_OR,  // If the top is truthy, replace argc values with 1 and jump
+  OP_PUSH_LITERAL, // Push a copy of the array or matrix at constants[operand]
+  OP_PUSH_STRING,  // Push a view of the file name at strings + operand
+  OP_COUNT
+} opcode_t;
+
+/**
+ * Single VM instruction
+ */
+typedef struct {
+  uint32_t opcode;
+  uint32_t operand; // Constant, function_id_t, local, variable or target
+  uint32_t argc;    // Argument count for OP_CALL and the tests
+} instruction_t;
+
+/**
+ * Compiled expression: flat stack-machine program
+ * Stack and local counts are fixed at compile time, so running the program
+ * never parses or allocates for scalars. Nothing in it changes once
+ * compiled: each run keeps its values in scratch supplied by the caller,
+ * so several threads may run one program at once.
+ */
+typedef struct {
+  instruction_t *code;
+  size_t code_size;
+  double *constants;
+  size_t constant_count;
+  char *strings; // File names, as in ast_t
+  size_t stack_size;  // Deepest the value stack gets
+  size_t local_count; // Results of shared subexpressions, one per DAG node
+  struct jit_code *native; // Machine code for the program, or NULL
+  int fusable; // Only element-wise instructions: see bytecode_exec
+} bytecode_t;
+
+/**
+ * Lower an AST into a bytecode program
+ * Shared nodes (see ast_share) are computed once into a local slot and
+ * reloaded as borrowed views at every other use.
+ * Returns NULL on error
+ */
+bytecode_t *bytecode_compile(const ast_t *ast, error_t *error);
+
+/**
+ * Values of scratch that bytecode_exec needs for a program
+ */
+size_t bytecode_scratch_size(const bytecode_t *program);
+
+/**
+ * Run a compiled program against a variable table
+ * scratch holds bytecode_scratch_size(program) values for the stack and
+ * locals of this run.
+ * The result is owned by the caller, except for a program that just
+ * loads or assigns a variable: then it is a view of that variable.
+ * A chain of element-wise operations over arrays (or matrices) of one
+ * shape runs as a single fused loop, BYTECODE_BLOCK elements at a time,
+ * writing only the result array. Only array variables are fused: a
+ * program that also builds an array (a literal such as [1, 2, 3], or a
+ * call like load_raw() or vector()), or assigns its result, runs one
+ * instruction at a time, with an array per step. engine_eval() reaches
+ * this only through its expression cache; with the cache disabled the
+ * tree walker runs instead.
+ */
+value_t bytecode_exec(const bytecode_t *program, symbol_table_t *symbols,
+                      value_t *scratch, error_t *error);
+
+/**
+ * Rows evaluated together by bytecode_exec_columns
+ */
+#define BYTECODE_BLOCK 256
+
+/**
+ * Run a compiled program once per row of numeric inputs
+ * columns[slot] holds one value per row for variable slot `slot` (NULL
+ * or slot >= column_count: the variable's current value is used).
+ * Numeric programs run BYTECODE_BLOCK rows per instruction; programs
+ * that call functions or assign run bytecode_exec per row instead, on
+ * scratch, leaving each bound variable set to its value in the last row.
+ * Returns 0 and fills out[0 .. rows), or -1 with error set for the
+ * first failing row
+ */
+int bytecode_exec_columns(const bytecode_t *program, symbol_table_t *symbols,
+                          const double *const *columns, size_t column_count,
+                          size_t rows, double *out, value_t *scratch,
+                          error_t *error);
+
+/**
+ * Free a compiled program
+ */
+void bytecode_free(bytecode_t *program);
+
+#endif // BYTECODE_H
@@ -0,0 +1,86 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "engine/bytecode.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compiled-expression cache entry
+ */
+typedef struct cache_entry {
+    char *key;                   // Normalized expression text
+    size_t key_length;
+    uint64_t hash;
+    bytecode_t *program;         // Owned by the cache
+    struct cache_entry *prev;    // LRU list, most recently used first
+    struct cache_entry *next;
+    struct cache_entry *chain;   // Next entry in the same hash bucket
+} cache_entry_t;
+
+/**
+ * Bounded LRU map from normalized expression text to compiled programs
+ */
+typedef struct {
+    cache_entry_t **buckets;
+    size_t bucket_count;         // Power of two
+    cache_entry_t *head;         // Most recently used
+    cache_entry_t *tail;         // Evicted first
+    size_t size;
+    size_t capacity;             // 0 disables caching
+    size_t hits;
+    size_t misses;
+} expr_cache_t;
+
+/**
+ * Create a cache holding at most capacity programs
+ */
+expr_cache_t *expr_cache_create(size_t capacity);
+
+/**
+ * Normalize an expression into buffer (at least strlen(expression) + 1
+ * bytes): whitespace is dropped, or kept as one space where it separates
+ * tokens ("1 2", "< <", "1e -5"), except inside "quoted" file names, which
+ * are copied byte for byte; so "1+2" and "1 + 2" share a key, and two
+ * expressions share a key only if they tokenize the same.
+ * Returns the normalized length
+ */
+size_t expr_cache_normalize(const char *expression, char *buffer);
+
+/**
+ * Hash a normalized key (64-bit FNV-1a)
+ */
+uint64_t expr_cache_hash(const char *key, size_t length);
+
+/**
+ * Find the program for a key and mark it most recently used
+ * Counts a hit or a miss. Returns NULL on a miss
+ */
+bytecode_t *expr_cache_lookup(expr_cache_t *cache, const char *key,
+                              size_t length, uint64_t hash);
+
+/**
+ * Insert a program, evicting the least recently used entry when full
+ * The cache takes ownership of program even on failure.
+ * Returns 0 on success, -1 if the program could not be cached
+ */
+int expr_cache_insert(expr_cache_t *cache, const char *key, size_t length,
+                      uint64_t hash, bytecode_t *program);
+
+/**
+ * Drop every entry (counters are kept)
+ */
+void expr_cache_clear(expr_cache_t *cache);
+
+/**
+ * Change the capacity; drops every entry
+ * Returns 0 on success, -1 on allocation failure
+ */
+int expr_cache_set_capacity(expr_cache_t *cache, size_t capacity);
+
+/**
+ * Free the cache and all cached programs
+ */
+void expr_cache_free(expr_cache_t *cache);
+
+#endif // CACHE_H
@@ -1,6 +1,9 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include "engine/bytecode.h"
+#include "engine/cache.h"
+#include "engine/symbols.h"
 #include "engine/parser.h"
 #include "common/error.h"
 
@@ -18,24 +21,134 @@ typedef enum {
 
 /**
  * Engine context
+ * A context is used by one thread at a time. The engine has no other
+ * mutable state, so threads with their own contexts run independently.
  */
 typedef struct {
     calc_mode_t mode;
     int base;  // For programmer mode (2, 8, 10, 16)
+    arena_t *arena;  // Per-parse scratch memory, reset after every call
+    expr_cache_t *cache;  // Compiled programs of recent expressions
+    symbol_table_t *symbols;  // Variables, including `ans`
+    int jit;  // engine_compile also emits native code (x86-64)
+    size_t max_depth;  // Deepest nesting accepted by the parser
+    value_t *stack;  // Tree-walker and VM value stack, grown on demand
+    size_t stack_capacity;
 } engine_context_t;
 
+/**
+ * Default number of compiled expressions kept per context
+ */
+#define ENGINE_CACHE_CAPACITY 64
+
+/**
+ * Default limit on expression nesting depth
+ */
+#define ENGINE_MAX_DEPTH 262144
+
 /**
  * Create engine context
  */
 engine_context_t *engine_context_create(calc_mode_t mode);
 
 /**
- * Evaluate an expression
+ * Set the calculator mode
+ * Invalidates the compiled-expression cache
+ */
+void engine_set_mode(engine_context_t *ctx, calc_mode_t mode);
+
+/**
+ * Set the programmer-mode base
+ * Invalidates the compiled-expression cache
+ */
+void engine_set_base(engine_context_t *ctx, int base);
+
+/**
+ * Resize the compiled-expression cache (0 disables it)
+ * Returns 0 on success, -1 on allocation failure
+ */
+int engine_set_cache_capacity(engine_context_t *ctx, size_t capacity);
+
+/**
+ * Enable or disable native code for programs from engine_compile
+ * Off by default. Programs the JIT cannot translate, and runs whose
+ * variables are not all numbers, use the bytecode VM.
+ */
+void engine_set_jit(engine_context_t *ctx, int enabled);
+
+/**
+ * Limit how deeply an expression may nest
+ * Deeper expressions fail with "Expression nested too deeply"; nothing
+ * in the engine recurses, so the limit only bounds memory.
+ * Invalidates the compiled-expression cache
+ */
+void engine_set_max_depth(engine_context_t *ctx, size_t depth);
+
+/**
+ * Evaluate an expression or assignment (`x = 2 * 3`)
+ * Repeated expressions run from the cache without being tokenized or
+ * parsed again; hits and misses are counted in ctx->cache.
+ * The result is stored as `ans` (assignments store their variable
+ * instead) and returned as a borrowed view of it: it stays valid until
+ * the next evaluation on ctx, and value_free() on it is a no-op.
  */
 value_t engine_eval(const char *expression, engine_context_t *ctx, error_t *error);
 
 /**
- * Free engine context
+ * Evaluate independent expressions on a pool of threads
+ * threads == 0 uses one per online CPU. Each worker evaluates in a
+ * private context with ctx's mode, base, cache size and a copy of its
+ * variables; ctx is only read, and must not change during the call.
+ * Assignments stay private to the worker that ran them.
+ * results[i] (owned by the caller) and errors[i] receive the outcome of
+ * expressions[i]. Does not update `ans`.
+ * Returns 0, or -1 if no worker could be started
+ */
+int engine_eval_batch(const engine_context_t *ctx,
+                      const char *const *expressions, size_t count,
+                      value_t *results, error_t *errors, size_t threads);
+
+/**
+ * Compile an expression once for repeated evaluation
+ * Returns NULL on error; free the result with bytecode_free()
+ */
+bytecode_t *engine_compile(const char *expression, engine_context_t *ctx,
+                           error_t *error);
+
+/**
+ * Run a compiled expression
+ * Does not parse, and does not allocate unless a function builds an
+ * array or matrix. Runs native code when the program has it. Does not
+ * update `ans`. The program is only read: threads may run one program at
+ * once as long as each uses its own context.
+ */
+value_t engine_exec(bytecode_t *program, engine_context_t *ctx,
+                    error_t *error);
+
+/**
+ * Input column bound to a variable for engine_eval_columns
+ */
+typedef struct {
+    const char *name;
+    const double *values;  // One value per row
+} engine_column_t;
+
+/**
+ * Run a compiled expression once per row of columnar inputs
+ * Each binding supplies its variable's value in every row; other
+ * variables keep their current value. Numeric expressions are evaluated
+ * a block of rows at a time. Does not update `ans`. Like engine_exec,
+ * one program may run on several threads, each with its own context.
+ * Returns 0 and fills out[0 .. rows), or -1 with error set for the
+ * first failing row
+ */
+int engine_eval_columns(bytecode_t *program, engine_context_t *ctx,
+                        const engine_column_t *bindings, size_t binding_count,
+                        size_t rows, double *out, error_t *error);
+
+/**
+ * Free engine context, and the small value buffers the calling thread
+ * keeps for reuse (value_cache_drain)
  */
 void engine_context_free(engine_context_t *ctx);
 
@@ -0,0 +1,194 @@
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include "common/error.h"
+#include "engine/parser.h"
+
+/**
+ * Binary operators understood by the evaluator
+ */
+typedef enum {
+  BINOP_ADD,
+  BINOP_SUB,
+  BINOP_MUL,
+  BINOP_DIV,
+  BINOP_MOD,
+  BINOP_AND,
+  BINOP_OR,
+  BINOP_XOR,
+  BINOP_SHL,
+  BINOP_SHR,
+  BINOP_INVALID
+} binary_op_t;
+
+/**
+ * Built-in functions, in registry order
+ * Aliases (nCr, factorial, ...) resolve to the same id.
+ */
+typedef enum {
+  FUNC_GCD,
+  FUNC_LCM,
+  FUNC_MOD,
+  FUNC_MODPOW,
+  FUNC_IS_PRIME,
+  FUNC_NCR,
+  FUNC_NPR,
+  FUNC_FACT,
+  FUNC_MEAN,
+  FUNC_MEDIAN,
+  FUNC_MODE,
+  FUNC_VAR,
+  FUNC_STDDEV,
+  FUNC_ZSCORE,
+  FUNC_CORRELATION,
+  FUNC_BINOMIAL,
+  FUNC_GEOMETRIC,
+  FUNC_VECTOR,
+  FUNC_MATRIX,
+  FUNC_VEC_ADD,
+  FUNC_VEC_SUB,
+  FUNC_VEC_SCALE,
+  FUNC_VEC_DOT,
+  FUNC_VEC_MAG,
+  FUNC_MAT_ADD,
+  FUNC_MAT_SUB,
+  FUNC_MAT_MUL,
+  FUNC_MAT_VEC_MUL,
+  FUNC_MAT_DET,
+  FUNC_MAT_TRANSPOSE,
+  FUNC_NEG,
+  FUNC_BNOT,
+  FUNC_NOT,
+  FUNC_AND,
+  FUNC_OR,
+  FUNC_XOR,
+  FUNC_IF,
+  FUNC_SET_UNION,
+  FUNC_SET_INTERSECT,
+  FUNC_SET_DIFF,
+  FUNC_LOAD,
+  FUNC_LOAD_RAW,
+  FUNC_COUNT,
+  FUNC_INVALID = -1
+} function_id_t;
+
+/**
+ * Argument type flags used in function signatures
+ */
+#define ARG_NUMBER 0x1
+#define ARG_ARRAY 0x2
+#define ARG_MATRIX 0x4
+#define ARG_STRING 0x8 // A quoted file name; no other value matches it
+#define ARG_ANY (ARG_NUMBER | ARG_ARRAY | ARG_MATRIX)
+
+/**
+ * Variadic marker for function_info_t.max_args
+ */
+#define ARGS_UNBOUNDED ((size_t)-1)
+
+/**
+ * Built-in function implementation
+ * Arguments are borrowed; the caller still owns and frees them
+ */
+typedef value_t (*function_impl_t)(const value_t *args, size_t argc,
+                                   error_t *error);
+
+/**
+ * Registry entry: arity and argument-type signature of a built-in
+ * Argument i is checked against arg_types[i]; arguments past the end of
+ * the signature use its last entry.
+ */
+typedef struct {
+  const char *name;
+  function_impl_t impl;
+  size_t min_args;
+  size_t max_args;          // ARGS_UNBOUNDED for variadic functions
+  int even_args;            // Argument count must be even
+  unsigned char arg_types[3];
+  size_t signature_length;  // Number of entries used in arg_types
+  const char *arity_message;
+} function_info_t;
+
+/**
+ * Map an operator token ("+", "<<", ...) to its binary_op_t
+ * The text need not be NUL-terminated. Returns BINOP_INVALID for unknown
+ * operators
+ */
+binary_op_t binary_op_lookup(const char *op, size_t length);
+
+/**
+ * Apply a binary operator to two numbers
+ * Sets error on division by zero, bad shift counts or non-finite results
+ */
+double binary_op_apply(binary_op_t op, double left, double right,
+                       error_t *error);
+
+/**
+ * Apply a binary operator element by element
+ * Operands hold left_count and right_count doubles; equal counts pair up
+ * elements and a count of 1 is broadcast against the other operand. out
+ * receives the larger count and may alias either operand. Errors as
+ * binary_op_apply, for any element.
+ */
+int binary_op_elements(binary_op_t op, double *out, const double *left,
+                       size_t left_count, const double *right,
+                       size_t right_count, error_t *error);
+
+/**
+ * Apply a binary operator to numbers, arrays or matrices
+ * Arrays and matrices combine element-wise with operands of the same
+ * shape, and a number is broadcast against them. An owned operand's
+ * buffer may be reused for the result, in which case that operand is
+ * left as a number; the caller still frees both operands.
+ */
+value_t value_binary_op(binary_op_t op, value_t *left, value_t *right,
+                        error_t *error);
+
+/**
+ * Resolve a function name (including aliases) to its id
+ * The name need not be NUL-terminated. Returns FUNC_INVALID for unknown
+ * names
+ */
+function_id_t function_lookup(const char *name, size_t length);
+
+/**
+ * Registry entry for a function id (NULL if out of range)
+ */
+const function_info_t *function_info(function_id_t id);
+
+/**
+ * Check an argument count against the registry
+ * Returns 0 if valid, -1 and sets error otherwise
+ */
+int function_check_arity(function_id_t id, size_t argc, error_t *error);
+
+/**
+ * Call a built-in function on already evaluated arguments
+ * Argument types are checked against the signature first.
+ */
+value_t function_call(function_id_t id, const value_t *args, size_t argc,
+                      error_t *error);
+
+/**
+ * Whether a call's result depends only on its arguments, so that the
+ * optimizer may evaluate it at compile time; false for the file loaders
+ */
+int function_is_pure(function_id_t id);
+
+/**
+ * Short-circuit test for the lazy logic functions (and, or)
+ * Returns 1 and sets *result when arg, the latest evaluated argument,
+ * decides the call whatever the remaining arguments are; the evaluators
+ * then skip those arguments entirely.
+ */
+int function_short_circuit(function_id_t id, const value_t *arg,
+                           double *result);
+
+/**
+ * Truth value of the condition of if(cond, then, else)
+ * Returns 1 or 0, or -1 and sets error when cond is not a number. Only
+ * the branch taken is evaluated.
+ */
+int function_condition(const value_t *cond, error_t *error);
+
+#endif // FUNCTIONS_H
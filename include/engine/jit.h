@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "common/error.h"
+#include "engine/bytecode.h"
+#include "engine/symbols.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Native code for a scalar program (x86-64 only)
+ * Covers numbers, variables, shared locals, every binary operator and
+ * the functions neg, bnot, not and mod; anything else stays on the VM.
+ */
+typedef struct jit_code {
+    void *memory;         // Executable mapping
+    size_t size;          // Mapped bytes
+    size_t entry;         // Offset of the entry point in memory
+    uint32_t *slots;      // Variable slots the code reads
+    size_t slot_count;
+} jit_code_t;
+
+/**
+ * Translate a compiled program into machine code
+ * Returns NULL with ERR_UNSUPPORTED for programs (or platforms) the JIT
+ * does not handle; the program still runs on bytecode_exec.
+ */
+jit_code_t *jit_compile(const bytecode_t *program, error_t *error);
+
+/**
+ * Run native code against a variable table
+ * Returns 0 once run (error set for division by zero, bad shifts and
+ * non-finite results, exactly as the VM reports them), or -1 without
+ * running when a variable is undefined or not a number
+ */
+int jit_exec(const jit_code_t *code, const symbol_table_t *symbols,
+             double *result, error_t *error);
+
+/**
+ * Unmap and free native code
+ */
+void jit_free(jit_code_t *code);
+
+#endif // JIT_H
@@ -0,0 +1,23 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "common/error.h"
+#include "engine/parser.h"
+#include <stddef.h>
+
+/**
+ * Load a NumPy .npy file of little-endian doubles ('<f8') in C order
+ * One dimension gives an array, two a matrix. The data is mapped rather
+ * than read (see value_map), so even large files load at once.
+ */
+value_t loader_npy(const char *path, error_t *error);
+
+/**
+ * Load a file of raw little-endian doubles, mapped like loader_npy
+ * rows > 0: a rows x cols matrix; rows == 0: an array of cols doubles,
+ * or of the whole file when cols is 0 too. Extra bytes are ignored.
+ */
+value_t loader_raw(const char *path, size_t rows, size_t cols,
+                   error_t *error);
+
+#endif // LOADER_H
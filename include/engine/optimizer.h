@@ -0,0 +1,29 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "common/error.h"
+#include "common/memory.h"
+#include "engine/parser.h"
+
+/**
+ * Fold constant subtrees and apply exact algebraic identities
+ * Operators and built-in calls whose arguments are all constant are
+ * evaluated once and replaced by a literal; x*1, 1*x, x/1 and x-0 are
+ * reduced to x. Subtrees whose evaluation fails are left untouched so the
+ * error still surfaces at evaluation time. The pool is compacted in place;
+ * scratch memory comes from the arena.
+ * Returns 0 on success, -1 on allocation failure
+ */
+int ast_fold(ast_t *ast, arena_t *arena, error_t *error);
+
+/**
+ * Hash-cons the tree into a DAG
+ * Structurally identical subtrees are merged into one node and nodes used
+ * by more than one parent are flagged `shared`, telling evaluators to
+ * compute them once and reuse the result. Calls that are not pure, such as
+ * load(), are never merged, so each reads its file. Call after ast_fold().
+ * Returns 0 on success, -1 on allocation failure
+ */
+int ast_share(ast_t *ast, arena_t *arena, error_t *error);
+
+#endif // OPTIMIZER_H
@@ -4,6 +4,7 @@
 #include "engine/tokenizer.h"
 #include "common/error.h"
 #include "common/memory.h"
+#include <stdint.h>
 
 /**
  * Value types
@@ -11,14 +12,18 @@
 typedef enum {
     VALUE_NUMBER,      // Double precision number
     VALUE_ARRAY,       // Array of numbers
-    VALUE_MATRIX       // 2D matrix
+    VALUE_MATRIX,      // 2D matrix
+    VALUE_STRING       // File name: only ever an argument of load()
 } value_type_t;
 
 /**
  * Value structure (discriminated union)
+ * Array and matrix data lives in a reference-counted buffer from
+ * value_alloc(): copies share it, and it is freed with the last owner.
  */
 typedef struct {
     value_type_t type;
+    unsigned char borrowed;  // Data is owned elsewhere; value_free() skips it
     union {
         double number;
         struct {
@@ -30,6 +35,7 @@ typedef struct {
             size_t rows;
             size_t cols;
         } matrix;
+        const char *string;  // NUL-terminated, in an AST or program
     } as;
 } value_t;
 
@@ -38,23 +44,87 @@ typedef struct {
  */
 value_t value_number(double num);
 
+/**
+ * Create a view of a file name owned by an AST or compiled program
+ * Always borrowed; it cannot outlive its owner.
+ */
+value_t value_string(const char *text);
+
+/**
+ * Allocate a buffer of count doubles for value_array() or value_matrix()
+ * The new buffer has one owner. Small buffers are recycled per thread
+ * rather than freed, so short vectors and matrices rarely reach the heap.
+ * Returns NULL on failure
+ */
+double *value_alloc(size_t count);
+
+/**
+ * Add an owner to a buffer from value_alloc()
+ */
+double *value_data_retain(const double *data);
+
+/**
+ * Drop an owner of a buffer from value_alloc(), freeing it after the last
+ * (NULL-safe)
+ */
+void value_data_release(double *data);
+
+/**
+ * Map count doubles, starting offset bytes into the open file fd, as a
+ * buffer for value_array() or value_matrix() without copying them
+ * offset must be a multiple of 16 and either page-aligned or at least 32
+ * bytes into its page (.npy data starts on a 64-byte boundary). The
+ * doubles are read where they are, from the page cache, and the buffer
+ * is read-only: value_unique() is always false for it, so no result is
+ * ever written over it. fd may be closed afterwards.
+ * Returns NULL with errno set on failure
+ */
+double *value_map(int fd, size_t offset, size_t count);
+
+/**
+ * Buffers value_alloc() has taken from the heap so far, in all threads
+ */
+size_t value_heap_allocations(void);
+
+/**
+ * Free the small buffers the calling thread keeps for reuse: up to 64
+ * released on this thread, whichever thread allocated them.
+ * engine_context_free() calls it; values still alive are not affected
+ */
+void value_cache_drain(void);
+
+/**
+ * Whether an array or matrix is the only owner of its data, so that
+ * writing to it cannot be seen through any other value
+ */
+int value_unique(const value_t *val);
+
 /**
  * Create an array value
+ * Takes ownership of data, which must come from value_alloc()
  */
 value_t value_array(double *data, size_t size);
 
 /**
  * Create a matrix value
+ * Takes ownership of data, which must come from value_alloc()
  */
 value_t value_matrix(double *data, size_t rows, size_t cols);
 
 /**
- * Free value resources
+ * Release value resources (no-op for borrowed values)
  */
 void value_free(value_t *val);
 
 /**
- * Clone a value
+ * Non-owning view of a value: shares the array or matrix data without
+ * copying it. The view must not outlive the original.
+ */
+value_t value_borrow(const value_t *val);
+
+/**
+ * Copy a value: O(1), the copy shares the array or matrix data
+ * Writers check value_unique() and copy first when it is shared.
  */
 value_t value_clone(const value_t *val);
 
@@ -66,20 +136,68 @@ typedef enum {
     NODE_OPERATOR,
     NODE_FUNCTION,
     NODE_ARRAY,
-    NODE_MATRIX
+    NODE_MATRIX,
+    NODE_VARIABLE,    // Load of variable slot `opcode`
+    NODE_ASSIGN,      // Store of its child into variable slot `opcode`
+    NODE_STRING       // File name at strings + `first`
 } node_type_t;
 
 /**
- * AST node
+ * Index of a node in an AST's node pool
+ */
+typedef uint32_t ast_index_t;
+
+/**
+ * Invalid node index
  */
-typedef struct ast_node {
-    node_type_t type;
-    char op[MAX_TOKEN_LENGTH];  // Operator or function name
-    double num_value;           // For numbers
-    struct ast_node **children; // Child nodes
-    size_t child_count;
+#define AST_NONE ((ast_index_t)-1)
+
+/**
+ * AST node (16 bytes)
+ * Nodes live in a contiguous pool in post-order, so every child precedes
+ * its parent and the root is the last node.
+ */
+typedef struct {
+    uint8_t type;           // node_type_t
+    uint8_t shared;         // Used by more than one parent (see ast_share)
+    int16_t opcode;         // binary_op_t, function_id_t or variable slot
+    uint32_t position;      // Position of the token in the expression
+    uint32_t first;         // Literals: constant index; else first edge
+    uint32_t child_count;
 } ast_node_t;
 
+/**
+ * Abstract syntax tree: node pool plus side tables
+ * Children of node n are nodes[edges[n.first + i]]; numeric literals are
+ * stored in constants[] rather than in the nodes. A NODE_ARRAY or
+ * NODE_MATRIX literal has no children: constants[first] holds its rows (0
+ * for an array), constants[first + 1] its cols, and its elements follow
+ * row by row. String literals, which only name files, sit NUL-terminated
+ * in strings[].
+ */
+typedef struct {
+    ast_node_t *nodes;
+    size_t node_count;
+    ast_index_t *edges;
+    size_t edge_count;
+    double *constants;
+    size_t constant_count;
+    const char *strings;
+    size_t string_length;  // Bytes in strings, terminators included
+    ast_index_t root;
+} ast_t;
+
+/**
+ * Constants taken by an array or matrix literal, its rows and cols
+ * included
+ */
+size_t ast_literal_length(const double *literal);
+
+/**
+ * Value of an array or matrix literal, copied out in one memcpy
+ */
+value_t ast_literal_value(const double *literal, error_t *error);
+
 /**
  * Parser context
  */
@@ -89,15 +207,22 @@ typedef struct {
     error_t error;
 } parser_t;
 
-/**
- * Parse an expression into AST
- * Uses shunting-yard algorithm
- */
-ast_node_t *parse(const char *expression, error_t *error);
+struct symbol_table;
 
 /**
- * Free AST
+ * Parse an expression into AST
+ * Single precedence-climbing pass with prefix '-' and '~'; nodes go
+ * straight into the post-order pool. Bracketed lists of numbers, such as
+ * [1, 2] or [[1, 2], [3, 4]], become a single NODE_ARRAY or NODE_MATRIX;
+ * lists with other elements become vector() or matrix() calls. A quoted
+ * string is only accepted as the file name of load() or load_raw(), as a
+ * NODE_STRING. Parser stacks and the node pool are allocated from the
+ * arena; the tree lives until arena_reset().
+ * Identifiers not followed by '(' are variables, resolved to slots in
+ * symbols; a leading `name =` makes the expression an assignment.
+ * Pass NULL symbols to reject variables.
  */
-void ast_free(ast_node_t *node);
+ast_t *parse(const char *expression, arena_t *arena,
+             struct symbol_table *symbols, error_t *error);
 
 #endif // PARSER_H
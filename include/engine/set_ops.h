@@ -5,7 +5,7 @@
 #include <stddef.h>
 
 // Set union: returns combined unique elements
-// Result array must be freed by caller
+// Result arrays come from value_alloc(), ready for value_array()
 double *set_union(const double *a, size_t a_size, const double *b,
                   size_t b_size, size_t *result_size, error_t *error);
 
@@ -5,36 +5,131 @@
 #include <stddef.h>
 
 /**
- * Calculate mean (average) of array
+ * Contiguous run of values, read in place
  */
-double stats_mean(const double *data, size_t size, error_t *error);
+typedef struct {
+  const double *data;
+  size_t size;
+} span_t;
 
 /**
- * Calculate median (middle value) of array
+ * Dataset viewed as the concatenation of its spans
+ * e.g. mean(1, v, m) reads the number, then v and m where they are
  */
-double stats_median(const double *data, size_t size, error_t *error);
+typedef struct {
+  const span_t *spans;
+  size_t count; // Number of spans
+  size_t size;  // Values over all spans
+} dataset_t;
 
 /**
- * Calculate mode (most frequent value) of array
+ * One-pass summary of a stream of values (Welford / Chan et al.)
+ * Values are pushed in blocks of any size, and summaries of separate
+ * parts of a stream can be merged, so memory stays constant.
+ */
+typedef struct {
+  size_t count;
+  double mean;
+  double m2; // Sum of squared deviations from mean
+  double min;
+  double max;
+} stats_acc_t;
+
+/**
+ * Result of stats_acc_finalize; variance is the population variance
+ */
+typedef struct {
+  size_t count;
+  double mean;
+  double variance;
+  double stddev;
+  double min;
+  double max;
+} stats_summary_t;
+
+/**
+ * One-pass summary of a stream of (x, y) pairs, for covariance
+ */
+typedef struct {
+  stats_acc_t x;
+  stats_acc_t y;
+  double c; // Sum of products of deviations from the means
+} stats_cov_t;
+
+/**
+ * Start an empty summary
+ */
+void stats_acc_init(stats_acc_t *acc);
+
+/**
+ * Add size values to the summary
+ */
+void stats_acc_push(stats_acc_t *acc, const double *data, size_t size);
+
+/**
+ * Add everything summarized by other to acc
+ */
+void stats_acc_merge(stats_acc_t *acc, const stats_acc_t *other);
+
+/**
+ * Statistics of the values pushed so far; fails when there are none
+ */
+stats_summary_t stats_acc_finalize(const stats_acc_t *acc, error_t *error);
+
+/**
+ * Start an empty pair summary
+ */
+void stats_cov_init(stats_cov_t *acc);
+
+/**
+ * Add the size pairs (x[i], y[i]) to the summary
+ */
+void stats_cov_push(stats_cov_t *acc, const double *x, const double *y,
+                    size_t size);
+
+/**
+ * Add everything summarized by other to acc
+ */
+void stats_cov_merge(stats_cov_t *acc, const stats_cov_t *other);
+
+/**
+ * Population covariance of the pairs pushed so far; stores the
+ * correlation coefficient in *correlation unless it is NULL, failing when
+ * either side has zero variance
+ */
+double stats_cov_finalize(const stats_cov_t *acc, double *correlation,
+                          error_t *error);
+
+/**
+ * Calculate mean (average) of dataset
+ */
+double stats_mean(const dataset_t *set, error_t *error);
+
+/**
+ * Calculate median (middle value) of dataset
+ */
+double stats_median(const dataset_t *set, error_t *error);
+
+/**
+ * Calculate mode (most frequent value) of dataset
  * Returns first mode if multiple
  */
-double stats_mode(const double *data, size_t size, error_t *error);
+double stats_mode(const dataset_t *set, error_t *error);
 
 /**
- * Calculate variance of array
+ * Calculate variance of dataset
  */
-double stats_variance(const double *data, size_t size, error_t *error);
+double stats_variance(const dataset_t *set, error_t *error);
 
 /**
- * Calculate standard deviation of array
+ * Calculate standard deviation of dataset
  */
-double stats_stddev(const double *data, size_t size, error_t *error);
+double stats_stddev(const dataset_t *set, error_t *error);
 
 /**
  * Calculate z-score of value in dataset
  */
-double stats_zscore(double value, const double *data, size_t size,
-                    error_t *error);
+double stats_zscore(double value, const dataset_t *set, error_t *error);
 
 /**
  * Calculate correlation coefficient between two datasets
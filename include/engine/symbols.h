@@ -0,0 +1,80 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "common/error.h"
+#include "engine/parser.h"
+#include <stddef.h>
+
+/**
+ * Slot of the `ans` register, which holds the last result
+ */
+#define SYMBOL_ANS 0
+
+/**
+ * Maximum number of variables per context
+ * Slots are stored in the 16-bit opcode field of AST nodes.
+ */
+#define SYMBOL_MAX 4096
+
+/**
+ * Per-context variable table
+ * Names are resolved to fixed slots at parse time; evaluation only does
+ * an indexed load. Slots that a kept program refers to are never
+ * removed, so compiled programs stay valid.
+ */
+typedef struct symbol_table {
+    char **names;
+    value_t *values;          // Owned values; unset slots are not defined
+    unsigned char *defined;
+    size_t count;
+    size_t capacity;
+} symbol_table_t;
+
+/**
+ * Create a table holding `ans` (initially 0)
+ */
+symbol_table_t *symbol_table_create(void);
+
+/**
+ * Copy a table: same names in the same slots, values cloned
+ * Returns NULL on allocation failure
+ */
+symbol_table_t *symbol_table_clone(const symbol_table_t *table);
+
+/**
+ * Resolve a name (need not be NUL-terminated) to its slot, creating an
+ * undefined slot for new names
+ * Returns the slot, or -1 and sets error when the table is full
+ */
+int symbol_resolve(symbol_table_t *table, const char *name, size_t length,
+                   error_t *error);
+
+/**
+ * Drop the slots created since the table held count of them
+ * For names that only a failed parse or evaluation introduced: no
+ * program may still refer to them.
+ */
+void symbol_forget(symbol_table_t *table, size_t count);
+
+/**
+ * Current value of a slot (NULL while undefined)
+ */
+const value_t *symbol_get(const symbol_table_t *table, size_t slot);
+
+/**
+ * Store a value, taking ownership; a borrowed value is copied first
+ * The previous value is freed.
+ */
+void symbol_set(symbol_table_t *table, size_t slot, value_t value);
+
+/**
+ * Error for reading an undefined slot
+ */
+error_t symbol_undefined_error(const symbol_table_t *table, size_t slot);
+
+/**
+ * Free the table and every stored value
+ */
+void symbol_table_free(symbol_table_t *table);
+
+#endif // SYMBOLS_H
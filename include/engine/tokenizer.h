@@ -5,31 +5,33 @@
 #include "common/memory.h"
 #include <stddef.h>
 
-#define MAX_TOKEN_LENGTH 64
-
 /**
  * Token types
  */
 typedef enum {
     TOKEN_NUMBER,      // 123, 3.14, 0xFF, 0b1010
     TOKEN_OPERATOR,    // +, -, *, /, %
-    TOKEN_FUNCTION,    // sin, mean, dot
+    TOKEN_FUNCTION,    // Identifier: function name or variable
     TOKEN_LPAREN,      // (
     TOKEN_RPAREN,      // )
     TOKEN_LBRACKET,    // [
     TOKEN_RBRACKET,    // ]
     TOKEN_COMMA,       // ,
+    TOKEN_ASSIGN,      // =
+    TOKEN_STRING,      // "file.npy": the span includes both quotes
     TOKEN_END          // End of input
 } token_type_t;
 
 /**
  * Token structure
+ * The token text is not copied: it is the span
+ * input[position .. position + length) of the tokenized expression.
  */
 typedef struct {
     token_type_t type;
-    char value[MAX_TOKEN_LENGTH];
+    size_t position;     // Offset of the token in the original expression
+    size_t length;       // Length of the token text
     double num_value;    // For numbers
-    size_t position;     // Position in original expression
 } token_t;
 
 /**
@@ -47,6 +49,11 @@ typedef struct {
  */
 tokenizer_t *tokenizer_create(const char *expression);
 
+/**
+ * Initialize a caller-owned tokenizer (e.g. on the stack)
+ */
+void tokenizer_init(tokenizer_t *tok, const char *expression);
+
 /**
  * Get the next token
  * Returns 1 if a token was retrieved, 0 if at end, -1 on error
@@ -68,10 +75,4 @@ error_t tokenizer_get_error(tokenizer_t *tok);
  */
 void tokenizer_free(tokenizer_t *tok);
 
-/**
- * Tokenize entire expression into array
- * Returns dynamic array of tokens, or NULL on error
- */
-darray_t *tokenize(const char *expression, error_t *error);
-
 #endif // TOKENIZER_H
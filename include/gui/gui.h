@@ -17,10 +17,15 @@ typedef struct {
 
   GtkTextBuffer *history_buffer;
   engine_context_t *engine_ctx;
+  GMutex engine_lock; // Held for every use of engine_ctx
+  // Chosen in the combos; the evaluator applies them to engine_ctx before
+  // its next evaluation. Accessed atomically from both threads
+  gint requested_mode; // calc_mode_t
+  gint requested_base;
 
   // Thread for evaluation
   GThread *eval_thread;
-  gboolean eval_running;
+  gint eval_running; // Accessed atomically from both threads
 } CalcApp;
 
 // Initialize the GUI
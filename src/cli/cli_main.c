@@ -1,5 +1,7 @@
+#include "common/decimal.h"
 #include "common/logger.h"
 #include "engine/engine.h"
+#include "engine/statistics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,6 +52,8 @@ static void print_help(void) {
   printf("  1 << 4        = 16 (programmer mode)\n");
   printf("  gcd(12, 18)   = 6\n");
   printf("  vec_dot(1,2,3,4,5,6) = 32\n");
+  printf("  x = 10        = 10 (assign a variable)\n");
+  printf("  ans + x       = 20 (ans is the last result)\n");
 #if HAVE_READLINE
   printf("\nReadline shortcuts:\n");
   printf("  Up/Down       - Navigate history\n");
@@ -58,9 +62,161 @@ static void print_help(void) {
 #endif
 }
 
+// --reduce reads stdin in chunks of this size; a single number may not
+// be longer
+#define REDUCE_BUFFER 65536
+#define REDUCE_BLOCK 256
+#define REDUCE_MAX 16
+
+static const char *const reducers[] = {"count",  "mean", "variance",
+                                       "stddev", "min",  "max"};
+static const size_t reducer_count = sizeof(reducers) / sizeof(reducers[0]);
+
+static double reducer_value(size_t id, const stats_summary_t *summary) {
+  switch (id) {
+  case 0:
+    return (double)summary->count;
+  case 1:
+    return summary->mean;
+  case 2:
+    return summary->variance;
+  case 3:
+    return summary->stddev;
+  case 4:
+    return summary->min;
+  default:
+    return summary->max;
+  }
+}
+
+static int is_separator(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',';
+}
+
+// Parse "mean,stddev" into reducer ids; returns how many, or 0
+static size_t parse_reducers(const char *spec, size_t ids[REDUCE_MAX]) {
+  size_t count = 0;
+  for (const char *p = spec;; p++) {
+    size_t len = strcspn(p, ",");
+    size_t id = 0;
+    while (id < reducer_count &&
+           (strlen(reducers[id]) != len || strncmp(p, reducers[id], len) != 0))
+      id++;
+    if (id == reducer_count || count == REDUCE_MAX) {
+      fprintf(stderr,
+              "Error: Unknown reducer '%.*s' (count, mean, variance, "
+              "stddev, min, max)\n",
+              (int)len, p);
+      return 0;
+    }
+    ids[count++] = id;
+    p += len;
+    if (!*p)
+      return count;
+  }
+}
+
+// Summarize the numbers in a buffer ending at a separator (or at EOF);
+// returns 0 and reports the offending token on a bad number
+static int reduce_chunk(char *text, size_t length, double *block,
+                        size_t *filled, stats_acc_t *acc, size_t *line) {
+  char saved = text[length];
+  text[length] = '\0';
+  size_t i = 0;
+  for (;;) {
+    while (i < length && is_separator(text[i]))
+      *line += text[i++] == '\n';
+    if (i == length)
+      break;
+    const char *end;
+    double number = decimal_parse(text + i, &end);
+    if (end == text + i || (*end && !is_separator(*end))) {
+      size_t len = 0;
+      while (i + len < length && !is_separator(text[i + len]))
+        len++;
+      fprintf(stderr, "Error: Invalid number '%.*s' on line %zu\n",
+              (int)(len < 64 ? len : 64), text + i, *line);
+      text[length] = saved;
+      return 0;
+    }
+    block[(*filled)++] = number;
+    if (*filled == REDUCE_BLOCK) {
+      stats_acc_push(acc, block, REDUCE_BLOCK);
+      *filled = 0;
+    }
+    i = (size_t)(end - text);
+  }
+  text[length] = saved;
+  return 1;
+}
+
+// calc42-cli --reduce mean,stddev < numbers.txt: one pass over stdin in
+// constant memory, numbers separated by whitespace or commas
+static int run_reduce(const char *spec) {
+  size_t ids[REDUCE_MAX];
+  size_t id_count = parse_reducers(spec, ids);
+  if (id_count == 0)
+    return 1;
+
+  static char buffer[REDUCE_BUFFER + 1];
+  double block[REDUCE_BLOCK];
+  size_t kept = 0, filled = 0, line = 1;
+  stats_acc_t acc;
+  stats_acc_init(&acc);
+  for (;;) {
+    if (kept == REDUCE_BUFFER) {
+      fprintf(stderr, "Error: Number too long on line %zu\n", line);
+      return 1;
+    }
+    size_t got = fread(buffer + kept, 1, REDUCE_BUFFER - kept, stdin);
+    size_t length = kept + got;
+    int eof = length < REDUCE_BUFFER;
+
+    // A number cut off at the end of the buffer waits for the next read
+    size_t end = length;
+    while (!eof && end > 0 && !is_separator(buffer[end - 1]))
+      end--;
+    if (!reduce_chunk(buffer, end, block, &filled, &acc, &line))
+      return 1;
+    kept = length - end;
+    memmove(buffer, buffer + end, kept);
+    if (eof)
+      break;
+  }
+  if (ferror(stdin)) {
+    fprintf(stderr, "Error: Failed to read standard input\n");
+    return 1;
+  }
+  stats_acc_push(&acc, block, filled);
+
+  error_t error;
+  stats_summary_t summary = stats_acc_finalize(&acc, &error);
+  if (!error_is_ok(error)) {
+    fprintf(stderr, "Error: %s\n", error.message);
+    return 1;
+  }
+  for (size_t i = 0; i < id_count; i++) {
+    value_t value = value_number(reducer_value(ids[i], &summary));
+    char *text = value_to_string(&value, 10);
+    printf("%s\n", text ? text : "");
+    safe_free(text);
+  }
+  return 0;
+}
+
 int main(int argc, char **argv) {
   logger_init("calc42.log");
 
+  if (argc > 1 && strcmp(argv[1], "--reduce") == 0) {
+    int status = 1;
+    if (argc == 3)
+      status = run_reduce(argv[2]);
+    else
+      fprintf(stderr, "Usage: calc42-cli --reduce mean,stddev < file\n");
+    logger_shutdown();
+    return status;
+  }
+
   // Check for one-shot mode
   if (argc > 1) {
     // Concatenate all arguments as expression
@@ -179,17 +335,17 @@ int main(int argc, char **argv) {
         calc_mode_t old_mode = ctx->mode;
 
         if (strcmp(mode_name, "standard") == 0) {
-          ctx->mode = MODE_STANDARD;
+          engine_set_mode(ctx, MODE_STANDARD);
         } else if (strcmp(mode_name, "programmer") == 0) {
-          ctx->mode = MODE_PROGRAMMER;
+          engine_set_mode(ctx, MODE_PROGRAMMER);
         } else if (strcmp(mode_name, "statistics") == 0) {
-          ctx->mode = MODE_STATISTICS;
+          engine_set_mode(ctx, MODE_STATISTICS);
         } else if (strcmp(mode_name, "probability") == 0) {
-          ctx->mode = MODE_PROBABILITY;
+          engine_set_mode(ctx, MODE_PROBABILITY);
         } else if (strcmp(mode_name, "discrete") == 0) {
-          ctx->mode = MODE_DISCRETE;
+          engine_set_mode(ctx, MODE_DISCRETE);
         } else if (strcmp(mode_name, "linalg") == 0) {
-          ctx->mode = MODE_LINEAR_ALGEBRA;
+          engine_set_mode(ctx, MODE_LINEAR_ALGEBRA);
         } else {
           printf("Unknown mode: %s\n", mode_name);
 #if HAVE_READLINE
@@ -205,7 +361,7 @@ int main(int argc, char **argv) {
       } else if (strncmp(line, ":base ", 6) == 0) {
         int base = atoi(line + 6);
         if (base == 2 || base == 8 || base == 10 || base == 16) {
-          ctx->base = base;
+          engine_set_base(ctx, base);
           printf("Base set to %d\n", base);
         } else {
           printf("Invalid base (must be 2, 8, 10, or 16)\n");
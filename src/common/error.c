@@ -38,20 +38,8 @@ const char *error_to_string(error_code_t code) {
         case ERR_UNSUPPORTED:   return "Unsupported operation";
         case ERR_PARSE:         return "Parse error";
         case ERR_EVAL:          return "Evaluation error";
+        case ERR_IO:            return "I/O error";
         case ERR_UNKNOWN:       return "Unknown error";
         default:                return "Unrecognized error";
     }
 }
-
-int error_is_ok(error_t err) {
-    return err.code == ERR_NONE;
-}
-
-error_t error_ok(void) {
-    error_t err;
-    err.code = ERR_NONE;
-    err.has_position = 0;
-    err.position = 0;
-    err.message[0] = '\0';
-    return err;
-}
@@ -1,16 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
 #include "common/logger.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
 
+// Guards log_file and keeps each record's stdout and file lines together
+// when several threads log at once
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
 static FILE *log_file = NULL;
 
 int logger_init(const char *filename) {
     if (filename) {
-        log_file = fopen(filename, "a");
-        if (!log_file) {
+        FILE *file = fopen(filename, "a");
+        if (!file) {
             return -1;
         }
+        pthread_mutex_lock(&log_lock);
+        log_file = file;
+        pthread_mutex_unlock(&log_lock);
     }
     return 0;
 }
@@ -28,8 +36,12 @@ static const char *level_to_string(log_level_t level) {
 static void log_json(const char *json) {
     // Get timestamp
     time_t now = time(NULL);
+    struct tm utc;
     char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", gmtime(&now));
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S",
+             gmtime_r(&now, &utc));
+    
+    pthread_mutex_lock(&log_lock);
     
     // Log to stdout
     printf("{\"timestamp\":\"%s\",%s}\n", timestamp, json);
@@ -39,6 +51,8 @@ static void log_json(const char *json) {
         fprintf(log_file, "{\"timestamp\":\"%s\",%s}\n", timestamp, json);
         fflush(log_file);
     }
+    
+    pthread_mutex_unlock(&log_lock);
 }
 
 void logger_log(log_level_t level, const char *category, const char *message) {
@@ -74,8 +88,10 @@ void logger_log_error(const char *error_message, const char *expression) {
 }
 
 void logger_shutdown(void) {
+    pthread_mutex_lock(&log_lock);
     if (log_file) {
         fclose(log_file);
         log_file = NULL;
     }
+    pthread_mutex_unlock(&log_lock);
 }
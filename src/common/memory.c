@@ -31,6 +31,126 @@ void safe_free(void *ptr) {
     }
 }
 
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+static arena_block_t *arena_block_create(size_t size) {
+    if (size > SIZE_MAX - sizeof(arena_block_t)) {
+        return NULL;
+    }
+
+    arena_block_t *block = safe_malloc(sizeof(arena_block_t) + size);
+    if (!block) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+arena_t *arena_create(size_t block_size) {
+    arena_t *arena = safe_malloc(sizeof(arena_t));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->heap_allocations = 0;
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena || size == 0) {
+        return NULL;
+    }
+
+    // Round up so every allocation stays aligned
+    if (size > SIZE_MAX - ARENA_ALIGNMENT) {
+        return NULL;
+    }
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    arena_block_t *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        // Grow geometrically so large inputs need few blocks
+        size_t new_size = arena->block_size;
+        if (block && block->size <= SIZE_MAX / 2 && block->size * 2 > new_size) {
+            new_size = block->size * 2;
+        }
+        if (new_size < size) {
+            new_size = size;
+        }
+
+        arena_block_t *fresh = arena_block_create(new_size);
+        if (!fresh) {
+            return NULL;
+        }
+        fresh->next = block;
+        arena->head = fresh;
+        arena->heap_allocations++;
+        block = fresh;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t count, size_t size) {
+    if (count == 0 || size == 0 || count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void arena_reset(arena_t *arena) {
+    if (!arena || !arena->head) {
+        return;
+    }
+
+    if (!arena->head->next) {
+        arena->head->used = 0;
+        return;
+    }
+
+    // Several blocks were needed: replace them by one that fits them all
+    size_t total = 0;
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        total += block->size;
+        free(block);
+        block = next;
+    }
+
+    arena->head = arena_block_create(total);
+    if (arena->head) {
+        arena->heap_allocations++;
+    }
+}
+
+void arena_free(arena_t *arena) {
+    if (!arena) {
+        return;
+    }
+
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
 darray_t *darray_create(size_t elem_size, size_t initial_capacity) {
     if (elem_size == 0) {
         return NULL;
@@ -54,10 +174,39 @@ darray_t *darray_create(size_t elem_size, size_t initial_capacity) {
     arr->size = 0;
     arr->capacity = initial_capacity;
     arr->elem_size = elem_size;
+    arr->arena = NULL;
     
     return arr;
 }
 
+darray_t *darray_create_in(arena_t *arena, size_t elem_size,
+                           size_t initial_capacity) {
+    if (!arena || elem_size == 0) {
+        return NULL;
+    }
+
+    if (initial_capacity == 0) {
+        initial_capacity = 16; // Default capacity
+    }
+
+    darray_t *arr = arena_alloc(arena, sizeof(darray_t));
+    if (!arr || initial_capacity > SIZE_MAX / elem_size) {
+        return NULL;
+    }
+
+    arr->data = arena_alloc(arena, elem_size * initial_capacity);
+    if (!arr->data) {
+        return NULL;
+    }
+
+    arr->size = 0;
+    arr->capacity = initial_capacity;
+    arr->elem_size = elem_size;
+    arr->arena = arena;
+
+    return arr;
+}
+
 int darray_reserve(darray_t *arr, size_t new_capacity) {
     if (!arr || new_capacity <= arr->capacity) {
         return 0;
@@ -68,7 +217,16 @@ int darray_reserve(darray_t *arr, size_t new_capacity) {
         return -1;
     }
     
-    void *new_data = safe_realloc(arr->data, arr->elem_size * new_capacity);
+    void *new_data;
+    if (arr->arena) {
+        // The old buffer stays in the arena until the next reset
+        new_data = arena_alloc(arr->arena, arr->elem_size * new_capacity);
+        if (new_data) {
+            memcpy(new_data, arr->data, arr->elem_size * arr->size);
+        }
+    } else {
+        new_data = safe_realloc(arr->data, arr->elem_size * new_capacity);
+    }
     if (!new_data) {
         return -1;
     }
@@ -118,7 +276,7 @@ void darray_clear(darray_t *arr) {
 }
 
 void darray_free(darray_t *arr) {
-    if (arr) {
+    if (arr && !arr->arena) {
         safe_free(arr->data);
         free(arr);
     }
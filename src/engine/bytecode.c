@@ -0,0 +1,873 @@
+#include "engine/bytecode.h"
+#include "engine/functions.h"
+#include "engine/jit.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  bytecode_t *prog;
+  const ast_t *ast;
+  ast_index_t *slot_of;   // Local slot of each shared node once emitted
+  ast_index_t *assigned;  // Shared nodes in the order they got a slot
+  size_t assigned_count;
+  size_t capacity;        // Allocated instructions
+  size_t depth;           // Current stack depth, to size the VM stack
+} emitter_t;
+
+// A node whose first `next` children have been emitted. Code in a branch
+// of if() or after the first argument of and()/or() may be skipped, so
+// slots handed out there since `mark` are forgotten when it ends. `patch`
+// chains the jumps that still need this node's end as their target.
+typedef struct {
+  ast_index_t node;
+  uint32_t next;
+  size_t mark;
+  uint32_t patch;
+} emit_frame_t;
+
+#define NO_PATCH UINT32_MAX
+
+static void track_depth(emitter_t *em) {
+  if (em->depth > em->prog->stack_size)
+    em->prog->stack_size = em->depth;
+}
+
+// Append an instruction, returning its index (or NO_PATCH on failure)
+static uint32_t emit(emitter_t *em, uint32_t opcode, uint32_t operand,
+                     uint32_t argc) {
+  bytecode_t *prog = em->prog;
+  if (prog->code_size == em->capacity) {
+    size_t capacity = em->capacity * 2;
+    instruction_t *code =
+        safe_realloc(prog->code, capacity * sizeof(instruction_t));
+    if (!code)
+      return NO_PATCH;
+    prog->code = code;
+    em->capacity = capacity;
+  }
+
+  instruction_t *ins = &prog->code[prog->code_size];
+  ins->opcode = opcode;
+  ins->operand = operand;
+  ins->argc = argc;
+  return (uint32_t)prog->code_size++;
+}
+
+static void forget_slots(emitter_t *em, size_t mark) {
+  while (em->assigned_count > mark)
+    em->slot_of[em->assigned[--em->assigned_count]] = AST_NONE;
+}
+
+// Point every jump chained from `patch` at the next instruction
+static void patch_jumps(emitter_t *em, uint32_t patch) {
+  while (patch != NO_PATCH) {
+    instruction_t *ins = &em->prog->code[patch];
+    patch = ins->operand;
+    ins->operand = (uint32_t)em->prog->code_size;
+  }
+}
+
+static int is_lazy_logic(const ast_node_t *node) {
+  return node->type == NODE_FUNCTION &&
+         (node->opcode == FUNC_AND || node->opcode == FUNC_OR);
+}
+
+static int is_conditional(const ast_node_t *node) {
+  return node->type == NODE_FUNCTION && node->opcode == FUNC_IF;
+}
+
+// Called between two children of a lazily evaluated node
+static uint32_t emit_between(emitter_t *em, emit_frame_t *frame,
+                             const ast_node_t *node) {
+  if (is_conditional(node)) {
+    if (frame->next == 1) {
+      // After the condition: skip the then-branch when it is false
+      em->depth--;
+      frame->patch = emit(em, OP_JUMP_IF_FALSE, NO_PATCH, 0);
+    } else {
+      // After the then-branch: jump over the else-branch, which starts
+      // with one value fewer on the stack
+      forget_slots(em, frame->mark);
+      uint32_t skip = emit(em, OP_JUMP, NO_PATCH, 0);
+      patch_jumps(em, frame->patch);
+      frame->patch = skip;
+      em->depth--;
+    }
+    frame->mark = em->assigned_count;
+    return frame->patch;
+  }
+
+  uint32_t opcode = node->opcode == FUNC_AND ? OP_TEST_AND : OP_TEST_OR;
+  uint32_t test = emit(em, opcode, frame->patch, frame->next);
+  frame->patch = test;
+  return test;
+}
+
+// Emit one node once its children are on the stack
+static int emit_node(emitter_t *em, emit_frame_t *frame, error_t *error) {
+  ast_index_t index = frame->node;
+  const ast_node_t *node = &em->ast->nodes[index];
+  uint32_t status = 0;
+
+  if (node->type == NODE_NUMBER) {
+    status = emit(em, OP_PUSH, node->first, 0);
+    em->depth++;
+  } else if (node->type == NODE_OPERATOR) {
+    binary_op_t op = (binary_op_t)node->opcode;
+    if (op == BINOP_INVALID || node->child_count != 2) {
+      *error = error_create(ERR_UNSUPPORTED, "Unsupported operator");
+      return -1;
+    }
+    status = emit(em, OP_ADD + (uint32_t)op, 0, 0);
+    em->depth--;
+  } else if (node->type == NODE_ARRAY || node->type == NODE_MATRIX) {
+    status = emit(em, OP_PUSH_LITERAL, node->first, 0);
+    em->depth++;
+  } else if (node->type == NODE_STRING) {
+    status = emit(em, OP_PUSH_STRING, node->first, 0);
+    em->depth++;
+  } else if (node->type == NODE_VARIABLE) {
+    status = emit(em, OP_LOAD_VAR, (uint32_t)node->opcode, 0);
+    em->depth++;
+  } else if (node->type == NODE_ASSIGN) {
+    status = emit(em, OP_STORE_VAR, (uint32_t)node->opcode, 0);
+  } else if (is_conditional(node)) {
+    // The branch taken leaves the result; no call is needed
+    forget_slots(em, frame->mark);
+  } else if (node->type == NODE_FUNCTION) {
+    status = emit(em, OP_CALL, (uint32_t)node->opcode, node->child_count);
+    em->depth = em->depth - node->child_count + 1;
+    if (is_lazy_logic(node))
+      forget_slots(em, frame->mark);
+  } else {
+    *error = error_create(ERR_UNSUPPORTED, "Unsupported node type");
+    return -1;
+  }
+  track_depth(em);
+  patch_jumps(em, frame->patch);
+
+  if (status != NO_PATCH && node->shared) {
+    status = emit(em, OP_STORE_LOCAL, (uint32_t)em->prog->local_count, 0);
+    em->slot_of[index] = (ast_index_t)em->prog->local_count++;
+    em->assigned[em->assigned_count++] = index;
+  }
+  if (status == NO_PATCH) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate program");
+    return -1;
+  }
+  return 0;
+}
+
+// Emit the DAG in post-order with explicit frames, so nesting depth is
+// bounded by memory rather than the C stack. A shared node is emitted the
+// first time it is reached and stored into a local; later uses just
+// reload the local.
+static int emit_tree(emitter_t *em, emit_frame_t *frames, error_t *error) {
+  const ast_t *ast = em->ast;
+  size_t depth = 0;
+  frames[depth++] = (emit_frame_t){ast->root, 0, 0, NO_PATCH};
+
+  while (depth > 0) {
+    emit_frame_t *frame = &frames[depth - 1];
+    const ast_node_t *node = &ast->nodes[frame->node];
+
+    if (frame->next < node->child_count) {
+      if (frame->next > 0 && (is_lazy_logic(node) || is_conditional(node))) {
+        if (frame->next == 1)
+          frame->mark = em->assigned_count;
+        if (emit_between(em, frame, node) == NO_PATCH) {
+          *error = error_create(ERR_MEMORY, "Failed to allocate program");
+          return -1;
+        }
+      }
+
+      ast_index_t child = ast->edges[node->first + frame->next++];
+      if (ast->nodes[child].shared && em->slot_of[child] != AST_NONE) {
+        if (emit(em, OP_LOAD_LOCAL, em->slot_of[child], 0) == NO_PATCH) {
+          *error = error_create(ERR_MEMORY, "Failed to allocate program");
+          return -1;
+        }
+        em->depth++;
+        track_depth(em);
+      } else {
+        frames[depth++] = (emit_frame_t){child, 0, 0, NO_PATCH};
+      }
+      continue;
+    }
+
+    if (emit_node(em, frame, error) != 0)
+      return -1;
+    depth--;
+  }
+  return 0;
+}
+
+// Calls that combine two operands element by element: vec_add(a, b),
+// vec_sub(a, b), vec_scale(k, a), mat_add(a, b) and mat_sub(a, b)
+static int is_elementwise_call(const instruction_t *ins) {
+  if (ins->opcode != OP_CALL || ins->argc != 2)
+    return 0;
+  switch ((function_id_t)ins->operand) {
+  case FUNC_VEC_ADD:
+  case FUNC_VEC_SUB:
+  case FUNC_VEC_SCALE:
+  case FUNC_MAT_ADD:
+  case FUNC_MAT_SUB:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Straight-line element-wise code reading at least one variable; whether
+// the variables hold arrays is only known when it runs
+static int is_fusable(const bytecode_t *prog) {
+  int reads = 0;
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    if (ins->opcode == OP_LOAD_VAR)
+      reads = 1;
+    else if (ins->opcode > OP_LOAD_VAR ||
+             (ins->opcode == OP_CALL && !is_elementwise_call(ins)))
+      return 0;
+  }
+  // A bare variable read stays a view; there is nothing to fuse
+  return reads && prog->code_size > 1;
+}
+
+bytecode_t *bytecode_compile(const ast_t *ast, error_t *error) {
+  if (!ast || ast->node_count == 0) {
+    *error = error_create(ERR_EVAL, "Null node");
+    return NULL;
+  }
+
+  bytecode_t *prog = safe_calloc(1, sizeof(bytecode_t));
+  if (!prog) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate program");
+    return NULL;
+  }
+
+  // Each node is emitted once, plus a store if shared, plus one reload per
+  // extra edge into a shared node. Jumps, and shared nodes emitted again
+  // after a skippable region, grow the buffer past that.
+  size_t total = 2 * ast->node_count + ast->edge_count;
+  size_t numbers = ast->constant_count;
+  size_t nodes = ast->node_count;
+  ast_index_t *slot_of = safe_malloc(nodes * sizeof(ast_index_t));
+  ast_index_t *assigned = safe_malloc(nodes * sizeof(ast_index_t));
+  // No path through the DAG is longer than its node count
+  emit_frame_t *frames = safe_malloc(nodes * sizeof(emit_frame_t));
+  prog->code = safe_malloc(total * sizeof(instruction_t));
+  prog->constants = numbers ? safe_malloc(numbers * sizeof(double)) : NULL;
+  prog->strings = ast->string_length ? safe_malloc(ast->string_length) : NULL;
+  if (!slot_of || !assigned || !frames || !prog->code ||
+      (numbers && !prog->constants) ||
+      (ast->string_length && !prog->strings)) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate program");
+    safe_free(slot_of);
+    safe_free(assigned);
+    safe_free(frames);
+    bytecode_free(prog);
+    return NULL;
+  }
+  if (numbers)
+    memcpy(prog->constants, ast->constants, numbers * sizeof(double));
+  prog->constant_count = numbers;
+  if (ast->string_length)
+    memcpy(prog->strings, ast->strings, ast->string_length);
+  memset(slot_of, 0xFF, nodes * sizeof(ast_index_t));
+
+  emitter_t em = {prog, ast, slot_of, assigned, 0, total, 0};
+  int status = emit_tree(&em, frames, error);
+  safe_free(slot_of);
+  safe_free(assigned);
+  safe_free(frames);
+  if (status != 0) {
+    bytecode_free(prog);
+    return NULL;
+  }
+
+  prog->fusable = is_fusable(prog);
+  error_clear(error);
+  return prog;
+}
+
+static int exec_fused(const bytecode_t *prog, symbol_table_t *symbols,
+                      value_t *result, error_t *error);
+
+size_t bytecode_scratch_size(const bytecode_t *prog) {
+  return prog->stack_size + prog->local_count;
+}
+
+value_t bytecode_exec(const bytecode_t *prog, symbol_table_t *symbols,
+                      value_t *scratch, error_t *error) {
+  value_t fused;
+  if (prog->fusable && exec_fused(prog, symbols, &fused, error))
+    return fused;
+
+  const instruction_t *code = prog->code;
+  const double *constants = prog->constants;
+  value_t *stack = scratch;
+  value_t *locals = scratch + prog->stack_size;
+  size_t sp = 0;
+
+  for (size_t i = 0; i < prog->local_count; i++)
+    locals[i] = value_number(0);
+
+  for (size_t pc = 0; pc < prog->code_size;) {
+    const instruction_t *ins = &code[pc++];
+
+    if (ins->opcode == OP_PUSH) {
+      stack[sp++] = value_number(constants[ins->operand]);
+      continue;
+    }
+
+    if (ins->opcode == OP_PUSH_LITERAL) {
+      stack[sp] = ast_literal_value(constants + ins->operand, error);
+      if (!error_is_ok(*error))
+        goto fail;
+      sp++;
+      continue;
+    }
+
+    if (ins->opcode == OP_PUSH_STRING) {
+      stack[sp++] = value_string(prog->strings + ins->operand);
+      continue;
+    }
+
+    if (ins->opcode == OP_JUMP) {
+      pc = ins->operand;
+      continue;
+    }
+
+    if (ins->opcode == OP_JUMP_IF_FALSE) {
+      int truth = function_condition(&stack[sp - 1], error);
+      value_free(&stack[--sp]);
+      if (truth < 0)
+        goto fail;
+      if (!truth)
+        pc = ins->operand;
+      continue;
+    }
+
+    if (ins->opcode == OP_TEST_AND || ins->opcode == OP_TEST_OR) {
+      function_id_t id = ins->opcode == OP_TEST_AND ? FUNC_AND : FUNC_OR;
+      double decided;
+      if (function_short_circuit(id, &stack[sp - 1], &decided)) {
+        for (size_t i = 0; i < ins->argc; i++)
+          value_free(&stack[--sp]);
+        stack[sp++] = value_number(decided);
+        pc = ins->operand;
+      }
+      continue;
+    }
+
+    if (ins->opcode == OP_CALL) {
+      size_t argc = ins->argc;
+      value_t *args = stack + sp - argc;
+      value_t result =
+          function_call((function_id_t)ins->operand, args, argc, error);
+      for (size_t i = 0; i < argc; i++)
+        value_free(&args[i]);
+      sp -= argc;
+      if (!error_is_ok(*error))
+        goto fail;
+      stack[sp++] = result;
+      continue;
+    }
+
+    if (ins->opcode == OP_STORE_LOCAL) {
+      locals[ins->operand] = stack[sp - 1];
+      stack[sp - 1] = value_borrow(&locals[ins->operand]);
+      continue;
+    }
+
+    if (ins->opcode == OP_LOAD_LOCAL) {
+      stack[sp++] = value_borrow(&locals[ins->operand]);
+      continue;
+    }
+
+    if (ins->opcode == OP_LOAD_VAR) {
+      const value_t *var = symbol_get(symbols, ins->operand);
+      if (!var) {
+        *error = symbol_undefined_error(symbols, ins->operand);
+        goto fail;
+      }
+      stack[sp++] = value_borrow(var);
+      continue;
+    }
+
+    if (ins->opcode == OP_STORE_VAR) {
+      symbol_set(symbols, ins->operand, stack[sp - 1]);
+      stack[sp - 1] = value_borrow(symbol_get(symbols, ins->operand));
+      continue;
+    }
+
+    // Binary operator: both operands are on top of the stack
+    value_t *left = &stack[sp - 2];
+    value_t *right = &stack[sp - 1];
+    if (left->type != VALUE_NUMBER || right->type != VALUE_NUMBER) {
+      // Arrays and matrices, element-wise
+      value_t r = value_binary_op((binary_op_t)(ins->opcode - OP_ADD), left,
+                                  right, error);
+      value_free(left);
+      value_free(right);
+      sp -= 2;
+      if (!error_is_ok(*error))
+        goto fail;
+      stack[sp++] = r;
+      continue;
+    }
+
+    double a = left->as.number;
+    double b = right->as.number;
+    double r;
+    switch (ins->opcode) {
+    case OP_ADD:
+      r = a + b;
+      break;
+    case OP_SUB:
+      r = a - b;
+      break;
+    case OP_MUL:
+      r = a * b;
+      break;
+    case OP_DIV:
+      if (b == 0) {
+        *error = error_create(ERR_DIV_ZERO, "Division by zero");
+        goto fail;
+      }
+      r = a / b;
+      break;
+    default:
+      r = binary_op_apply((binary_op_t)(ins->opcode - OP_ADD), a, b, error);
+      if (!error_is_ok(*error))
+        goto fail;
+      break;
+    }
+
+    if (!isfinite(r)) {
+      *error = error_create(ERR_DOMAIN, "Result is not a finite number");
+      goto fail;
+    }
+
+    sp--;
+    stack[sp - 1] = value_number(r);
+  }
+
+  // The root is never shared, but an if() at the root can hand back a
+  // view of a local; that local moves into the result instead of being
+  // freed under it
+  value_t result = stack[0];
+  for (size_t i = 0; i < prog->local_count; i++) {
+    if (result.borrowed && result.type != VALUE_NUMBER &&
+        !locals[i].borrowed &&
+        locals[i].as.array.data == result.as.array.data) {
+      result = locals[i];
+      continue;
+    }
+    value_free(&locals[i]);
+  }
+
+  error_clear(error);
+  return result;
+
+fail:
+  while (sp > 0)
+    value_free(&stack[--sp]);
+  for (size_t i = 0; i < prog->local_count; i++)
+    value_free(&locals[i]);
+  return value_number(0);
+}
+
+// Block VM: every stack entry and local stands for BYTECODE_BLOCK lanes,
+// one per row, so each instruction is a single loop over the block. An
+// entry only points at its lanes: a bound column is read in place, and a
+// number is kept as one lane that broadcasts.
+typedef struct {
+  const double *data; // The entry's own block, a column, or a local
+  size_t count;       // Lanes in the block, or 1 for a broadcast number
+} block_entry_t;
+
+typedef struct {
+  const bytecode_t *prog;
+  const symbol_table_t *symbols;
+  const double *const *columns;
+  size_t column_count;
+  double *stack;          // stack_size blocks, written by operators
+  double *locals;         // local_count blocks
+  block_entry_t *entries; // stack_size entries
+  size_t *local_counts;   // local_count lane counts
+} block_vm_t;
+
+// Most stack entries and locals the block VM will allocate (2 MiB)
+#define BLOCK_SCRATCH_MAX 1024
+
+static const double *column_of(const block_vm_t *vm, uint32_t slot) {
+  return slot < vm->column_count ? vm->columns[slot] : NULL;
+}
+
+static int block_alloc(block_vm_t *vm, error_t *error) {
+  const bytecode_t *prog = vm->prog;
+  size_t blocks = prog->stack_size + prog->local_count;
+  vm->stack = safe_malloc(blocks * BYTECODE_BLOCK * sizeof(double));
+  vm->entries = safe_malloc(prog->stack_size * sizeof(block_entry_t) +
+                            prog->local_count * sizeof(size_t));
+  if (!vm->stack || !vm->entries) {
+    safe_free(vm->stack);
+    safe_free(vm->entries);
+    *error = error_create(ERR_MEMORY, "Failed to allocate VM stack");
+    return -1;
+  }
+  vm->locals = vm->stack + prog->stack_size * BYTECODE_BLOCK;
+  vm->local_counts = (size_t *)(vm->entries + prog->stack_size);
+  return 0;
+}
+
+static void block_release(block_vm_t *vm) {
+  safe_free(vm->stack);
+  safe_free(vm->entries);
+}
+
+// The block VM only handles straight-line numeric code: operators,
+// numbers, locals, and variables either bound to a column or holding a
+// number. Calls, assignments and jumps run row by row.
+static int block_supported(const block_vm_t *vm) {
+  for (size_t pc = 0; pc < vm->prog->code_size; pc++) {
+    const instruction_t *ins = &vm->prog->code[pc];
+    if (ins->opcode > OP_LOAD_VAR || ins->opcode == OP_CALL)
+      return 0;
+    if (ins->opcode == OP_LOAD_VAR && !column_of(vm, ins->operand)) {
+      const value_t *var = symbol_get(vm->symbols, ins->operand);
+      if (!var || var->type != VALUE_NUMBER)
+        return 0;
+    }
+  }
+  return 1;
+}
+
+// out = f(a, b) for the calls in is_elementwise_call, over n lanes (a is
+// the broadcast factor of vec_scale). Like the linalg functions they
+// stand for, they do not check for non-finite results.
+static void block_call(uint32_t id, double *out, const double *a,
+                       const double *b, size_t n) {
+  switch ((function_id_t)id) {
+  case FUNC_VEC_ADD:
+  case FUNC_MAT_ADD:
+    for (size_t i = 0; i < n; i++)
+      out[i] = a[i] + b[i];
+    break;
+  case FUNC_VEC_SUB:
+  case FUNC_MAT_SUB:
+    for (size_t i = 0; i < n; i++)
+      out[i] = a[i] - b[i];
+    break;
+  default: {
+    double factor = a[0]; // out may be a's only lane
+    for (size_t i = 0; i < n; i++)
+      out[i] = factor * b[i];
+    break;
+  }
+  }
+}
+
+// Evaluate rows [start, start + n) into out
+static int block_run(block_vm_t *vm, size_t start, size_t n, double *out,
+                     error_t *error) {
+  const bytecode_t *prog = vm->prog;
+  size_t sp = 0;
+
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    block_entry_t *top = &vm->entries[sp];
+    double *own = vm->stack + sp * BYTECODE_BLOCK;
+    double *local = vm->locals + (size_t)ins->operand * BYTECODE_BLOCK;
+    // The last instruction leaves the result: write it straight to out
+    double *target =
+        pc + 1 == prog->code_size ? out + start : own - 2 * BYTECODE_BLOCK;
+
+    switch (ins->opcode) {
+    case OP_PUSH:
+      own[0] = prog->constants[ins->operand];
+      *top = (block_entry_t){own, 1};
+      sp++;
+      break;
+    case OP_LOAD_VAR: {
+      const double *column = column_of(vm, ins->operand);
+      if (column) {
+        *top = (block_entry_t){column + start, n};
+      } else {
+        own[0] = symbol_get(vm->symbols, ins->operand)->as.number;
+        *top = (block_entry_t){own, 1};
+      }
+      sp++;
+      break;
+    }
+    case OP_LOAD_LOCAL:
+      *top = (block_entry_t){local, vm->local_counts[ins->operand]};
+      sp++;
+      break;
+    case OP_STORE_LOCAL:
+      // The entry's own block is about to be reused by the next operator
+      memcpy(local, top[-1].data, top[-1].count * sizeof(double));
+      vm->local_counts[ins->operand] = top[-1].count;
+      top[-1].data = local;
+      break;
+    case OP_CALL:
+      sp--;
+      block_call(ins->operand, target, top[-2].data, top[-1].data, n);
+      top[-2] = (block_entry_t){target, n};
+      break;
+    default: {
+      sp--;
+      block_entry_t *left = &top[-2], *right = &top[-1];
+      if (binary_op_elements((binary_op_t)(ins->opcode - OP_ADD), target,
+                             left->data, left->count, right->data,
+                             right->count, error) != 0)
+        return -1;
+      if (right->count > left->count)
+        left->count = right->count;
+      left->data = target;
+      break;
+    }
+    }
+  }
+
+  const block_entry_t *result = &vm->entries[0];
+  if (result->data == out + start && result->count == n)
+    return 0;
+  if (result->count == n) {
+    memcpy(out + start, result->data, n * sizeof(double));
+  } else {
+    for (size_t i = 0; i < n; i++)
+      out[start + i] = result->data[0];
+  }
+  return 0;
+}
+
+static int row_error(size_t row, error_t *error) {
+  char message[sizeof(error->message)];
+  snprintf(message, sizeof(message), "Row %zu: %.200s", row, error->message);
+  *error = error_create(error->code, message);
+  return -1;
+}
+
+static int exec_blocks(block_vm_t *vm, size_t rows, double *out,
+                       error_t *error) {
+  for (size_t start = 0; start < rows; start += BYTECODE_BLOCK) {
+    size_t n = rows - start < BYTECODE_BLOCK ? rows - start : BYTECODE_BLOCK;
+    if (block_run(vm, start, n, out, error) == 0)
+      continue;
+
+    // Replay the failing block one row at a time so the error names the
+    // first failing row, as per-row evaluation would
+    for (size_t row = start; row < start + n; row++) {
+      if (block_run(vm, row, 1, out, error) != 0)
+        return row_error(row, error);
+    }
+  }
+  error_clear(error);
+  return 0;
+}
+
+static int exec_rows(const bytecode_t *prog, symbol_table_t *symbols,
+                     const double *const *columns, size_t column_count,
+                     size_t rows, double *out, value_t *scratch,
+                     error_t *error) {
+  for (size_t row = 0; row < rows; row++) {
+    for (size_t slot = 0; symbols && slot < column_count; slot++) {
+      if (columns[slot])
+        symbol_set(symbols, slot, value_number(columns[slot][row]));
+    }
+
+    value_t result = bytecode_exec(prog, symbols, scratch, error);
+    if (!error_is_ok(*error))
+      return row_error(row, error);
+    if (result.type != VALUE_NUMBER) {
+      value_free(&result);
+      *error = error_create(ERR_EVAL, "Result is not a number");
+      return row_error(row, error);
+    }
+    out[row] = result.as.number;
+  }
+  error_clear(error);
+  return 0;
+}
+
+int bytecode_exec_columns(const bytecode_t *prog, symbol_table_t *symbols,
+                          const double *const *columns, size_t column_count,
+                          size_t rows, double *out, value_t *scratch,
+                          error_t *error) {
+  // Very deep programs would need one block per stack entry; they run row
+  // by row rather than reserve that much scratch
+  block_vm_t vm = {prog, symbols, columns, column_count, NULL, NULL, NULL,
+                   NULL};
+  size_t blocks = prog->stack_size + prog->local_count;
+  if (!block_supported(&vm) || blocks > BLOCK_SCRATCH_MAX)
+    return exec_rows(prog, symbols, columns, column_count, rows, out, scratch,
+                     error);
+
+  if (block_alloc(&vm, error) != 0)
+    return -1;
+  int status = exec_blocks(&vm, rows, out, error);
+  block_release(&vm);
+  return status;
+}
+
+static int same_shape(const value_t *a, const value_t *b) {
+  if (a->type != b->type)
+    return 0;
+  if (a->type == VALUE_ARRAY)
+    return a->as.array.size == b->as.array.size;
+  return a->as.matrix.rows == b->as.matrix.rows &&
+         a->as.matrix.cols == b->as.matrix.cols;
+}
+
+// Whether an element-wise call computes what block_call does: vec_scale
+// takes a number and an array, the others two arrays (or two matrices for
+// mat_add and mat_sub) of the program's shape
+static int call_fuses(uint32_t id, int a, int b, const value_t *shape) {
+  if (id == FUNC_VEC_SCALE)
+    return !a && b && shape->type == VALUE_ARRAY;
+  value_type_t type = id == FUNC_MAT_ADD || id == FUNC_MAT_SUB
+                          ? VALUE_MATRIX
+                          : VALUE_ARRAY;
+  return a && b && shape->type == type;
+}
+
+// Whether a fusable program, run against these variables, is element-wise
+// throughout: every array or matrix it reads has one shape, each call gets
+// the operands it combines element by element, and the result is not a
+// number. kinds has one entry per stack slot and local (1: elements).
+// Sets *shape to a variable of the common shape and *slots to one past
+// the highest variable slot read.
+static int fused_plan(const bytecode_t *prog, const symbol_table_t *symbols,
+                      unsigned char *kinds, const value_t **shape,
+                      size_t *slots) {
+  unsigned char *locals = kinds + prog->stack_size;
+  size_t sp = 0;
+  *shape = NULL;
+  *slots = 0;
+
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    switch (ins->opcode) {
+    case OP_PUSH:
+      kinds[sp++] = 0;
+      break;
+    case OP_LOAD_VAR: {
+      const value_t *var = symbol_get(symbols, ins->operand);
+      if (!var)
+        return 0;
+      kinds[sp++] = var->type != VALUE_NUMBER;
+      if (var->type == VALUE_NUMBER)
+        break;
+      if (*shape && !same_shape(*shape, var))
+        return 0;
+      *shape = var;
+      if (ins->operand >= *slots)
+        *slots = (size_t)ins->operand + 1;
+      break;
+    }
+    case OP_LOAD_LOCAL:
+      kinds[sp++] = locals[ins->operand];
+      break;
+    case OP_STORE_LOCAL:
+      locals[ins->operand] = kinds[sp - 1];
+      break;
+    case OP_CALL:
+      if (!call_fuses(ins->operand, kinds[sp - 2], kinds[sp - 1], *shape))
+        return 0;
+      kinds[--sp - 1] = 1;
+      break;
+    default:
+      sp--;
+      kinds[sp - 1] |= kinds[sp];
+      break;
+    }
+  }
+  return kinds[0];
+}
+
+// Run an element-wise program through the block VM, with each array
+// variable bound as a column and one row per element. Returns 0 when the
+// program is not element-wise for these variables, so the caller runs it
+// as usual, or 1 with *result or error set.
+static int exec_fused(const bytecode_t *prog, symbol_table_t *symbols,
+                      value_t *result, error_t *error) {
+  // Most programs only read numbers; they are rejected before allocating
+  int elements = 0;
+  for (size_t pc = 0; !elements && pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    if (ins->opcode == OP_LOAD_VAR) {
+      const value_t *var = symbol_get(symbols, ins->operand);
+      elements = var && var->type != VALUE_NUMBER;
+    }
+  }
+  size_t blocks = prog->stack_size + prog->local_count;
+  if (!elements || blocks > BLOCK_SCRATCH_MAX)
+    return 0;
+  unsigned char *kinds = safe_malloc(blocks);
+  if (!kinds)
+    return 0;
+  const value_t *shape;
+  size_t slots;
+  int planned = fused_plan(prog, symbols, kinds, &shape, &slots);
+  safe_free(kinds);
+  if (!planned)
+    return 0;
+
+  size_t count = shape->type == VALUE_ARRAY
+                     ? shape->as.array.size
+                     : shape->as.matrix.rows * shape->as.matrix.cols;
+  block_vm_t vm = {prog, symbols, NULL, slots, NULL, NULL, NULL, NULL};
+  const double **columns = safe_calloc(slots, sizeof(double *));
+  double *out = value_alloc(count);
+  if (!columns || !out || block_alloc(&vm, error) != 0) {
+    safe_free(columns);
+    value_data_release(out);
+    *error = error_create(ERR_MEMORY, "Failed to allocate VM stack");
+    return 1;
+  }
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    if (ins->opcode != OP_LOAD_VAR)
+      continue;
+    const value_t *var = symbol_get(symbols, ins->operand);
+    if (var->type != VALUE_NUMBER)
+      columns[ins->operand] = var->as.array.data;
+  }
+  vm.columns = columns;
+
+  int status = 0;
+  for (size_t start = 0; status == 0 && start < count;
+       start += BYTECODE_BLOCK) {
+    size_t n =
+        count - start < BYTECODE_BLOCK ? count - start : BYTECODE_BLOCK;
+    status = block_run(&vm, start, n, out, error);
+  }
+  safe_free(columns);
+  block_release(&vm);
+  if (status != 0) {
+    value_data_release(out);
+    return 1;
+  }
+
+  *result = *shape;
+  result->borrowed = 0;
+  result->as.array.data = out;
+  error_clear(error);
+  return 1;
+}
+
+void bytecode_free(bytecode_t *prog) {
+  if (!prog)
+    return;
+  safe_free(prog->code);
+  safe_free(prog->constants);
+  safe_free(prog->strings);
+  jit_free(prog->native);
+  free(prog);
+}
@@ -0,0 +1,212 @@
+#include "engine/cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Keep buckets at least twice the capacity so chains stay short
+static size_t bucket_count_for(size_t capacity) {
+  size_t count = 16;
+  while (count < capacity * 2)
+    count *= 2;
+  return count;
+}
+
+expr_cache_t *expr_cache_create(size_t capacity) {
+  expr_cache_t *cache = safe_calloc(1, sizeof(expr_cache_t));
+  if (!cache)
+    return NULL;
+
+  if (expr_cache_set_capacity(cache, capacity) != 0) {
+    safe_free(cache);
+    return NULL;
+  }
+  return cache;
+}
+
+// Part of a number or name; other bytes the tokenizer rejects count too
+static int is_word(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z') || c == '_' || c == '.' ||
+         (unsigned char)c >= 0x80;
+}
+
+// Whether a space between two characters can change the tokens: it
+// splits numbers and names ("1 2"), shifts ("< <") and exponents, since
+// "1e -5" is 1 - 5 while "1e-5" is one number
+static int space_matters(char before, char after) {
+  if (is_word(before) && is_word(after))
+    return 1;
+  if ((before == '<' || before == '>') && after == before)
+    return 1;
+  return (before == 'e' || before == 'E') && (after == '+' || after == '-');
+}
+
+size_t expr_cache_normalize(const char *expression, char *buffer) {
+  size_t length = 0;
+  int pending_space = 0;
+
+  for (const char *p = expression; *p; p++) {
+    if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\v' || *p == '\f' ||
+        *p == '\r') {
+      pending_space = length > 0;
+      continue;
+    }
+    if (pending_space && space_matters(buffer[length - 1], *p))
+      buffer[length++] = ' ';
+    pending_space = 0;
+    buffer[length++] = *p;
+    // A quoted file name is copied as is, whitespace included
+    if (*p == '"') {
+      while (p[1] && p[1] != '"')
+        buffer[length++] = *++p;
+      if (p[1])
+        buffer[length++] = *++p;
+    }
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+uint64_t expr_cache_hash(const char *key, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)key[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void lru_unlink(expr_cache_t *cache, cache_entry_t *entry) {
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  else
+    cache->head = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  else
+    cache->tail = entry->prev;
+  entry->prev = NULL;
+  entry->next = NULL;
+}
+
+static void lru_push_front(expr_cache_t *cache, cache_entry_t *entry) {
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (cache->head)
+    cache->head->prev = entry;
+  cache->head = entry;
+  if (!cache->tail)
+    cache->tail = entry;
+}
+
+static void entry_free(cache_entry_t *entry) {
+  bytecode_free(entry->program);
+  safe_free(entry->key);
+  safe_free(entry);
+}
+
+// Remove an entry from its bucket chain and the LRU list, then free it
+static void cache_remove(expr_cache_t *cache, cache_entry_t *entry) {
+  cache_entry_t **link =
+      &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+  while (*link != entry)
+    link = &(*link)->chain;
+  *link = entry->chain;
+
+  lru_unlink(cache, entry);
+  entry_free(entry);
+  cache->size--;
+}
+
+bytecode_t *expr_cache_lookup(expr_cache_t *cache, const char *key,
+                              size_t length, uint64_t hash) {
+  cache_entry_t *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; entry; entry = entry->chain) {
+    if (entry->hash == hash && entry->key_length == length &&
+        memcmp(entry->key, key, length) == 0) {
+      if (cache->head != entry) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+      }
+      cache->hits++;
+      return entry->program;
+    }
+  }
+
+  cache->misses++;
+  return NULL;
+}
+
+int expr_cache_insert(expr_cache_t *cache, const char *key, size_t length,
+                      uint64_t hash, bytecode_t *program) {
+  if (cache->capacity == 0) {
+    bytecode_free(program);
+    return -1;
+  }
+
+  cache_entry_t *entry = safe_calloc(1, sizeof(cache_entry_t));
+  char *copy = safe_malloc(length + 1);
+  if (!entry || !copy) {
+    safe_free(entry);
+    safe_free(copy);
+    bytecode_free(program);
+    return -1;
+  }
+  memcpy(copy, key, length);
+  copy[length] = '\0';
+
+  if (cache->size >= cache->capacity)
+    cache_remove(cache, cache->tail);
+
+  entry->key = copy;
+  entry->key_length = length;
+  entry->hash = hash;
+  entry->program = program;
+
+  size_t bucket = hash & (cache->bucket_count - 1);
+  entry->chain = cache->buckets[bucket];
+  cache->buckets[bucket] = entry;
+  lru_push_front(cache, entry);
+  cache->size++;
+  return 0;
+}
+
+void expr_cache_clear(expr_cache_t *cache) {
+  if (!cache)
+    return;
+
+  cache_entry_t *entry = cache->head;
+  while (entry) {
+    cache_entry_t *next = entry->next;
+    entry_free(entry);
+    entry = next;
+  }
+
+  if (cache->buckets)
+    memset(cache->buckets, 0, cache->bucket_count * sizeof(cache_entry_t *));
+  cache->head = NULL;
+  cache->tail = NULL;
+  cache->size = 0;
+}
+
+int expr_cache_set_capacity(expr_cache_t *cache, size_t capacity) {
+  size_t count = bucket_count_for(capacity);
+  cache_entry_t **buckets = safe_calloc(count, sizeof(cache_entry_t *));
+  if (!buckets)
+    return -1;
+
+  expr_cache_clear(cache);
+  safe_free(cache->buckets);
+  cache->buckets = buckets;
+  cache->bucket_count = count;
+  cache->capacity = capacity;
+  return 0;
+}
+
+void expr_cache_free(expr_cache_t *cache) {
+  if (!cache)
+    return;
+  expr_cache_clear(cache);
+  safe_free(cache->buckets);
+  safe_free(cache);
+}
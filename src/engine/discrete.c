@@ -13,13 +13,13 @@ long long discrete_gcd(long long a, long long b, error_t *error) {
     a = temp;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return a;
 }
 
 long long discrete_lcm(long long a, long long b, error_t *error) {
   if (a == 0 || b == 0) {
-    *error = error_ok();
+    error_clear(error);
     return 0;
   }
 
@@ -33,7 +33,7 @@ long long discrete_lcm(long long a, long long b, error_t *error) {
   a = llabs(a);
   b = llabs(b);
 
-  *error = error_ok();
+  error_clear(error);
   return (a / gcd) * b;
 }
 
@@ -50,7 +50,7 @@ long long discrete_mod(long long a, long long m, error_t *error) {
     result += llabs(m);
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -62,7 +62,7 @@ long long discrete_modpow(long long base, long long exp, long long m,
   }
 
   if (m == 1) {
-    *error = error_ok();
+    error_clear(error);
     return 0;
   }
 
@@ -88,34 +88,34 @@ long long discrete_modpow(long long base, long long exp, long long m,
     base = (base * base) % m;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
 int discrete_is_prime(long long n, error_t *error) {
   if (n < 2) {
-    *error = error_ok();
+    error_clear(error);
     return 0;
   }
 
   if (n == 2 || n == 3) {
-    *error = error_ok();
+    error_clear(error);
     return 1;
   }
 
   if (n % 2 == 0 || n % 3 == 0) {
-    *error = error_ok();
+    error_clear(error);
     return 0;
   }
 
   // Check divisibility up to sqrt(n) using 6k±1 optimization
   for (long long i = 5; i * i <= n; i += 6) {
     if (n % i == 0 || n % (i + 2) == 0) {
-      *error = error_ok();
+      error_clear(error);
       return 0;
     }
   }
 
-  *error = error_ok();
+  error_clear(error);
   return 1;
 }
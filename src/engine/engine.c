@@ -1,886 +1,649 @@
+#define _DEFAULT_SOURCE
 #include "engine/engine.h"
-#include "engine/discrete.h"
-#include "engine/linalg.h"
-#include "engine/probability.h"
-#include "engine/set_ops.h"
-#include "engine/statistics.h"
+#include "engine/functions.h"
+#include "engine/jit.h"
+#include "engine/optimizer.h"
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 engine_context_t *engine_context_create(calc_mode_t mode) {
   engine_context_t *ctx = safe_malloc(sizeof(engine_context_t));
   if (ctx) {
     ctx->mode = mode;
     ctx->base = 10;
+    ctx->arena = arena_create(0);
+    ctx->cache = expr_cache_create(ENGINE_CACHE_CAPACITY);
+    ctx->symbols = symbol_table_create();
+    ctx->jit = 0;
+    ctx->max_depth = ENGINE_MAX_DEPTH;
+    ctx->stack = NULL;
+    ctx->stack_capacity = 0;
+    if (!ctx->arena || !ctx->cache || !ctx->symbols) {
+      arena_free(ctx->arena);
+      expr_cache_free(ctx->cache);
+      symbol_table_free(ctx->symbols);
+      safe_free(ctx);
+      return NULL;
+    }
   }
   return ctx;
 }
 
-void engine_context_free(engine_context_t *ctx) { safe_free(ctx); }
+void engine_context_free(engine_context_t *ctx) {
+  if (!ctx)
+    return;
+  arena_free(ctx->arena);
+  expr_cache_free(ctx->cache);
+  symbol_table_free(ctx->symbols);
+  safe_free(ctx->stack);
+  safe_free(ctx);
+  value_cache_drain();
+}
 
-// Forward declaration
-static value_t eval_node(ast_node_t *node, engine_context_t *ctx,
-                         error_t *error);
+void engine_set_mode(engine_context_t *ctx, calc_mode_t mode) {
+  if (!ctx || ctx->mode == mode)
+    return;
+  ctx->mode = mode;
+  expr_cache_clear(ctx->cache);
+}
 
-// Evaluate function calls
-// Helper to collect all arguments as a flattened array of doubles.
-// Handles nesting: collect_args(1, [2, 3], matrix(2, 1, 4, 5)) -> [1, 2, 3, 4,
-// 5]
-static double *collect_args(ast_node_t *node, engine_context_t *ctx,
-                            error_t *error, size_t *out_count) {
-  *out_count = 0;
-  if (node->child_count == 0)
-    return NULL;
+void engine_set_base(engine_context_t *ctx, int base) {
+  if (!ctx || ctx->base == base)
+    return;
+  ctx->base = base;
+  expr_cache_clear(ctx->cache);
+}
 
-  value_t *results = safe_malloc(node->child_count * sizeof(value_t));
-  size_t total = 0;
+int engine_set_cache_capacity(engine_context_t *ctx, size_t capacity) {
+  if (!ctx)
+    return -1;
+  return expr_cache_set_capacity(ctx->cache, capacity);
+}
 
-  for (size_t i = 0; i < node->child_count; i++) {
-    results[i] = eval_node(node->children[i], ctx, error);
-    if (!error_is_ok(*error)) {
-      for (size_t j = 0; j <= i; j++)
-        value_free(&results[j]);
-      safe_free(results);
-      return NULL;
-    }
-    if (results[i].type == VALUE_NUMBER) {
-      total++;
-    } else if (results[i].type == VALUE_ARRAY) {
-      total += results[i].as.array.size;
-    } else if (results[i].type == VALUE_MATRIX) {
-      total += results[i].as.matrix.rows * results[i].as.matrix.cols;
-    }
-  }
+void engine_set_jit(engine_context_t *ctx, int enabled) {
+  if (ctx)
+    ctx->jit = enabled != 0;
+}
 
-  double *data = safe_malloc(total * sizeof(double));
-  size_t pos = 0;
-  for (size_t i = 0; i < node->child_count; i++) {
-    if (results[i].type == VALUE_NUMBER) {
-      data[pos++] = results[i].as.number;
-    } else if (results[i].type == VALUE_ARRAY) {
-      memcpy(data + pos, results[i].as.array.data,
-             results[i].as.array.size * sizeof(double));
-      pos += results[i].as.array.size;
-    } else if (results[i].type == VALUE_MATRIX) {
-      size_t size = results[i].as.matrix.rows * results[i].as.matrix.cols;
-      memcpy(data + pos, results[i].as.matrix.data, size * sizeof(double));
-      pos += size;
-    }
-    value_free(&results[i]);
-  }
-  safe_free(results);
-  *out_count = total;
-  return data;
+void engine_set_max_depth(engine_context_t *ctx, size_t depth) {
+  if (!ctx || ctx->max_depth == depth)
+    return;
+  ctx->max_depth = depth;
+  expr_cache_clear(ctx->cache);
 }
 
-static value_t eval_function(ast_node_t *node, engine_context_t *ctx,
-                             error_t *error) {
-  const char *fname = node->op;
+// Tree-walk state: the DAG being evaluated, the results of its shared
+// nodes (each computed on first use and reused as a borrowed view after)
+// and the pending frames. Operand values live on ctx->stack.
+typedef struct {
+  const ast_t *ast;
+  engine_context_t *ctx;
+  value_t *memo;
+  unsigned char *done;
+  size_t sp; // Values on ctx->stack
+} eval_t;
+
+// A node whose children next .. end are still to be evaluated. `taken`
+// marks an if() or a short-circuited and()/or() whose result is already
+// the single value on the stack once those children are done.
+typedef struct {
+  ast_index_t node;
+  uint32_t next;
+  uint32_t end;
+  uint32_t taken;
+} eval_frame_t;
+
+static int eval_push(eval_t *ev, value_t value, error_t *error) {
+  engine_context_t *ctx = ev->ctx;
+  if (ev->sp == ctx->stack_capacity) {
+    size_t capacity = ctx->stack_capacity ? ctx->stack_capacity * 2 : 64;
+    value_t *stack = safe_realloc(ctx->stack, capacity * sizeof(value_t));
+    if (!stack) {
+      value_free(&value);
+      *error = error_create(ERR_MEMORY, "Failed to grow value stack");
+      return -1;
+    }
+    ctx->stack = stack;
+    ctx->stack_capacity = capacity;
+  }
+  ctx->stack[ev->sp++] = value;
+  return 0;
+}
 
-  // Discrete Math
-  if (strcmp(fname, "gcd") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS, "gcd requires 2 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      return value_number(0);
-    }
-    long long result = discrete_gcd((long long)arg1.as.number,
-                                    (long long)arg2.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    return value_number((double)result);
-  }
+// Apply a node to its evaluated children, args[0 .. child_count)
+static value_t eval_apply(eval_t *ev, const ast_node_t *node, value_t *args,
+                          error_t *error) {
+  symbol_table_t *symbols = ev->ctx->symbols;
 
-  if (strcmp(fname, "lcm") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS, "lcm requires 2 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      return value_number(0);
-    }
-    long long result = discrete_lcm((long long)arg1.as.number,
-                                    (long long)arg2.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    return value_number((double)result);
-  }
+  switch (node->type) {
+  case NODE_NUMBER:
+    error_clear(error);
+    return value_number(ev->ast->constants[node->first]);
 
-  if (strcmp(fname, "mod") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS, "mod requires 2 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      return value_number(0);
-    }
-    long long result = discrete_mod((long long)arg1.as.number,
-                                    (long long)arg2.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    return value_number((double)result);
-  }
+  case NODE_ARRAY:
+  case NODE_MATRIX:
+    return ast_literal_value(ev->ast->constants + node->first, error);
 
-  if (strcmp(fname, "modpow") == 0) {
-    if (node->child_count != 3) {
-      *error = error_create(ERR_INVALID_ARGS, "modpow requires 3 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      return value_number(0);
-    }
-    value_t arg3 = eval_node(node->children[2], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      value_free(&arg2);
-      return value_number(0);
-    }
-    long long result =
-        discrete_modpow((long long)arg1.as.number, (long long)arg2.as.number,
-                        (long long)arg3.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    value_free(&arg3);
-    return value_number((double)result);
-  }
-
-  if (strcmp(fname, "is_prime") == 0) {
-    if (node->child_count != 1) {
-      *error = error_create(ERR_INVALID_ARGS, "is_prime requires 1 argument");
-      return value_number(0);
-    }
-    value_t arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    int result = discrete_is_prime((long long)arg.as.number, error);
-    value_free(&arg);
-    return value_number((double)result);
-  }
+  case NODE_STRING:
+    error_clear(error);
+    return value_string(ev->ast->strings + node->first);
 
-  // Probability
-  if (strcmp(fname, "ncr") == 0 || strcmp(fname, "nCr") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS, "nCr requires 2 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
-      return value_number(0);
-    }
-    double result = prob_ncr((int)arg1.as.number, (int)arg2.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    return value_number(result);
-  }
+  case NODE_FUNCTION:
+    return function_call((function_id_t)node->opcode, args, node->child_count,
+                         error);
 
-  if (strcmp(fname, "npr") == 0 || strcmp(fname, "nPr") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS, "nPr requires 2 arguments");
-      return value_number(0);
-    }
-    value_t arg1 = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t arg2 = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&arg1);
+  case NODE_VARIABLE: {
+    const value_t *var = symbol_get(symbols, (size_t)node->opcode);
+    if (!var) {
+      *error = symbol_undefined_error(symbols, (size_t)node->opcode);
       return value_number(0);
     }
-    double result = prob_npr((int)arg1.as.number, (int)arg2.as.number, error);
-    value_free(&arg1);
-    value_free(&arg2);
-    return value_number(result);
+    error_clear(error);
+    return value_borrow(var);
   }
 
-  if (strcmp(fname, "fact") == 0 || strcmp(fname, "factorial") == 0) {
-    if (node->child_count != 1) {
-      *error = error_create(ERR_INVALID_ARGS, "factorial requires 1 argument");
-      return value_number(0);
-    }
-    value_t arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    double result = prob_factorial((int)arg.as.number, error);
-    value_free(&arg);
-    return value_number(result);
-  }
-
-  // Statistics (taking multiple arguments as a dataset)
-  if (strcmp(fname, "mean") == 0 || strcmp(fname, "median") == 0 ||
-      strcmp(fname, "mode") == 0 || strcmp(fname, "var") == 0 ||
-      strcmp(fname, "stddev") == 0) {
-    if (node->child_count == 0) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "Stats functions require at least 1 argument");
-      return value_number(0);
-    }
-    size_t data_size;
-    double *data = collect_args(node, ctx, error, &data_size);
-    if (!error_is_ok(*error))
-      return value_number(0);
-
-    double result = 0;
-    if (strcmp(fname, "mean") == 0)
-      result = stats_mean(data, data_size, error);
-    else if (strcmp(fname, "median") == 0)
-      result = stats_median(data, data_size, error);
-    else if (strcmp(fname, "mode") == 0)
-      result = stats_mode(data, data_size, error);
-    else if (strcmp(fname, "var") == 0)
-      result = stats_variance(data, data_size, error);
-    else if (strcmp(fname, "stddev") == 0)
-      result = stats_stddev(data, data_size, error);
-
-    safe_free(data);
-    return value_number(result);
-  }
+  case NODE_ASSIGN:
+    // The value moves into the variable; its stack slot is left empty
+    symbol_set(symbols, (size_t)node->opcode, args[0]);
+    args[0] = value_number(0);
+    error_clear(error);
+    return value_borrow(symbol_get(symbols, (size_t)node->opcode));
 
-  // Z-score: zscore(value, data1, data2, ...)
-  if (strcmp(fname, "zscore") == 0) {
+  case NODE_OPERATOR: {
+    // Binary operators need 2 children
     if (node->child_count < 2) {
-      *error =
-          error_create(ERR_INVALID_ARGS, "zscore requires value and dataset");
-      return value_number(0);
-    }
-    value_t val_arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-
-    // Temp node for rest
-    ast_node_t temp;
-    temp.children = node->children + 1;
-    temp.child_count = node->child_count - 1;
-    size_t data_size;
-    double *data = collect_args(&temp, ctx, error, &data_size);
-    if (!error_is_ok(*error)) {
-      value_free(&val_arg);
+      *error = error_create(ERR_EVAL, "Operator requires 2 operands");
       return value_number(0);
     }
+    return value_binary_op((binary_op_t)node->opcode, &args[0], &args[1],
+                           error);
+  }
 
-    double result = stats_zscore(val_arg.as.number, data, data_size, error);
-    value_free(&val_arg);
-    safe_free(data);
-    return value_number(result);
+  default:
+    *error = error_create(ERR_UNSUPPORTED, "Unsupported node type");
+    return value_number(0);
   }
+}
 
-  // Correlation: correlation(x1, x2, ..., | y1, y2, ...) - split args in half
-  if (strcmp(fname, "correlation") == 0) {
-    if (node->child_count < 2 || node->child_count % 2 != 0) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "correlation requires even number of arguments");
-      return value_number(0);
-    }
-    size_t half = node->child_count / 2;
-    double *x = safe_malloc(half * sizeof(double));
-    double *y = safe_malloc(half * sizeof(double));
-
-    for (size_t i = 0; i < half; i++) {
-      value_t arg_x = eval_node(node->children[i], ctx, error);
-      if (!error_is_ok(*error)) {
-        safe_free(x);
-        safe_free(y);
-        return value_number(0);
+// Between two children of if(), and() or or(): pick the branch to take
+// once the condition is known, or settle a logic op on a decisive value
+// without evaluating the arguments after it
+static int eval_lazy(eval_t *ev, eval_frame_t *frame, const ast_node_t *node,
+                     error_t *error) {
+  value_t *stack = ev->ctx->stack;
+
+  if (node->opcode == FUNC_IF) {
+    int truth = function_condition(&stack[ev->sp - 1], error);
+    value_free(&stack[--ev->sp]);
+    if (truth < 0)
+      return -1;
+    frame->next = truth ? 1 : 2;
+    frame->end = frame->next + 1;
+    frame->taken = 1;
+    return 0;
+  }
+
+  double decided;
+  if (function_short_circuit((function_id_t)node->opcode,
+                             &stack[ev->sp - 1], &decided)) {
+    for (uint32_t i = 0; i < frame->next; i++)
+      value_free(&stack[--ev->sp]);
+    stack[ev->sp++] = value_number(decided);
+    frame->next = frame->end;
+    frame->taken = 1;
+  }
+  return 0;
+}
+
+// Post-order walk with explicit frames instead of recursion. A node's
+// children are evaluated left to right onto the value stack, then the node
+// replaces them with its result. Shared nodes already evaluated are not
+// entered again: their memoized value is pushed as a view.
+static value_t eval_walk(eval_t *ev, eval_frame_t *frames, error_t *error) {
+  const ast_t *ast = ev->ast;
+  size_t depth = 0;
+  frames[depth++] =
+      (eval_frame_t){ast->root, 0, ast->nodes[ast->root].child_count, 0};
+  error_clear(error);
+
+  while (depth > 0) {
+    eval_frame_t *frame = &frames[depth - 1];
+    const ast_node_t *node = &ast->nodes[frame->node];
+
+    if (frame->next < frame->end) {
+      if (frame->next > 0 && !frame->taken && node->type == NODE_FUNCTION &&
+          (node->opcode == FUNC_IF || node->opcode == FUNC_AND ||
+           node->opcode == FUNC_OR)) {
+        if (eval_lazy(ev, frame, node, error) != 0)
+          break;
+        if (frame->next == frame->end)
+          continue;
       }
-      x[i] = arg_x.as.number;
-      value_free(&arg_x);
-
-      value_t arg_y = eval_node(node->children[half + i], ctx, error);
-      if (!error_is_ok(*error)) {
-        safe_free(x);
-        safe_free(y);
-        return value_number(0);
+
+      ast_index_t child = ast->edges[node->first + frame->next++];
+      if (ast->nodes[child].shared && ev->done[child]) {
+        if (eval_push(ev, value_borrow(&ev->memo[child]), error) != 0)
+          break;
+      } else {
+        frames[depth++] =
+            (eval_frame_t){child, 0, ast->nodes[child].child_count, 0};
       }
-      y[i] = arg_y.as.number;
-      value_free(&arg_y);
+      continue;
     }
 
-    double result = stats_correlation(x, half, y, half, error);
-    safe_free(x);
-    safe_free(y);
-    return value_number(result);
-  }
-
-  // Binomial probability: binomial(n, p, k)
-  if (strcmp(fname, "binomial") == 0) {
-    if (node->child_count != 3) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "binomial requires 3 arguments (n, p, k)");
-      return value_number(0);
-    }
-    value_t n_arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t p_arg = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&n_arg);
-      return value_number(0);
-    }
-    value_t k_arg = eval_node(node->children[2], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&n_arg);
-      value_free(&p_arg);
-      return value_number(0);
+    value_t result;
+    if (frame->taken) {
+      result = ev->ctx->stack[--ev->sp];
+    } else {
+      value_t *args = ev->ctx->stack + ev->sp - node->child_count;
+      result = eval_apply(ev, node, args, error);
+      for (size_t i = 0; i < node->child_count; i++)
+        value_free(&args[i]);
+      ev->sp -= node->child_count;
+      if (!error_is_ok(*error))
+        break;
     }
 
-    double result = prob_binomial((int)n_arg.as.number, p_arg.as.number,
-                                  (int)k_arg.as.number, error);
-    value_free(&n_arg);
-    value_free(&p_arg);
-    value_free(&k_arg);
-    return value_number(result);
-  }
-
-  // Geometric probability: geometric(p, k)
-  if (strcmp(fname, "geometric") == 0) {
-    if (node->child_count != 2) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "geometric requires 2 arguments (p, k)");
-      return value_number(0);
-    }
-    value_t p_arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t k_arg = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&p_arg);
-      return value_number(0);
+    if (node->shared) {
+      ev->memo[frame->node] = result;
+      ev->done[frame->node] = 1;
+      result = value_borrow(&ev->memo[frame->node]);
     }
-
-    double result =
-        prob_geometric(p_arg.as.number, (int)k_arg.as.number, error);
-    value_free(&p_arg);
-    value_free(&k_arg);
-    return value_number(result);
+    depth--;
+    if (eval_push(ev, result, error) != 0)
+      break;
   }
 
-  // Linear Algebra - Vector operations
-  // vector(1, 2, 3) -> [1, 2, 3]
-  if (strcmp(fname, "vector") == 0) {
-    size_t data_size;
-    double *data = collect_args(node, ctx, error, &data_size);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    if (data_size == 0) {
-      safe_free(data);
-      *error = error_create(ERR_INVALID_ARGS, "vector requires elements");
-      return value_number(0);
-    }
-    return value_array(data, data_size);
+  if (!error_is_ok(*error)) {
+    while (ev->sp > 0)
+      value_free(&ev->ctx->stack[--ev->sp]);
+    return value_number(0);
   }
+  ev->sp = 0;
+  return ev->ctx->stack[0];
+}
 
-  // matrix(rows, cols, e1, e2, ...)
-  if (strcmp(fname, "matrix") == 0) {
-    if (node->child_count < 3) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "matrix requires rows, cols and elements");
-      return value_number(0);
-    }
-    value_t rows_v = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    value_t cols_v = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&rows_v);
-      return value_number(0);
-    }
-
-    size_t rows = (size_t)rows_v.as.number;
-    size_t cols = (size_t)cols_v.as.number;
-    value_free(&rows_v);
-    value_free(&cols_v);
+// Evaluate the root, then release the memoized shared results
+static value_t eval_tree(const ast_t *ast, engine_context_t *ctx,
+                         error_t *error) {
+  eval_t ev = {ast, ctx, NULL, NULL, 0};
+  ev.memo = arena_alloc(ctx->arena, ast->node_count * sizeof(value_t));
+  ev.done = arena_calloc(ctx->arena, ast->node_count, 1);
+  // No path through the DAG is longer than its node count
+  eval_frame_t *frames =
+      arena_alloc(ctx->arena, ast->node_count * sizeof(eval_frame_t));
+  if (!ev.memo || !ev.done || !frames) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate evaluator state");
+    return value_number(0);
+  }
 
-    if (node->child_count - 2 != rows * cols) {
-      *error = error_create(ERR_INVALID_ARGS,
-                            "Matrix element count does not match dimensions");
-      return value_number(0);
-    }
+  // The root is never shared, but an if() at the root can hand back a
+  // view of a memoized value; that value moves into the result instead
+  // of being freed under it
+  value_t result = eval_walk(&ev, frames, error);
 
-    double *mat_data = safe_malloc(rows * cols * sizeof(double));
-    for (size_t i = 0; i < rows * cols; i++) {
-      value_t arg = eval_node(node->children[i + 2], ctx, error);
-      if (!error_is_ok(*error)) {
-        safe_free(mat_data);
-        return value_number(0);
-      }
-      mat_data[i] = arg.as.number;
-      value_free(&arg);
+  for (size_t i = 0; i < ast->node_count; i++) {
+    if (!ev.done[i])
+      continue;
+    if (result.borrowed && result.type != VALUE_NUMBER &&
+        !ev.memo[i].borrowed &&
+        ev.memo[i].as.array.data == result.as.array.data) {
+      result = ev.memo[i];
+      continue;
     }
-    return value_matrix(mat_data, rows, cols);
+    value_free(&ev.memo[i]);
   }
+  return result;
+}
 
-  // vec_add(1, 2, 3, 4) treats first half as vector   a, second half as vector
-  // b
-  if (strcmp(fname, "vec_add") == 0 || strcmp(fname, "vec_sub") == 0 ||
-      strcmp(fname, "vec_scale") == 0 || strcmp(fname, "vec_dot") == 0 ||
-      strcmp(fname, "vec_mag") == 0) {
-
-    if (strcmp(fname, "vec_scale") == 0) {
-      if (node->child_count < 2) {
-        *error = error_create(ERR_INVALID_ARGS,
-                              "vec_scale requires scalar and vector");
-        return value_number(0);
-      }
-      value_t scalar_val = eval_node(node->children[0], ctx, error);
-      if (!error_is_ok(*error))
-        return value_number(0);
-      double scalar = scalar_val.as.number;
-      value_free(&scalar_val);
-
-      ast_node_t temp;
-      temp.children = node->children + 1;
-      temp.child_count = node->child_count - 1;
-      size_t vec_size;
-      double *vec_data = collect_args(&temp, ctx, error, &vec_size);
-      if (!error_is_ok(*error))
-        return value_number(0);
-
-      value_t v = value_array(vec_data, vec_size);
-      value_t result = linalg_vec_scale(&v, scalar, error);
-      value_free(&v);
-      return result;
-
-    } else if (strcmp(fname, "vec_mag") == 0) {
-      size_t data_size;
-      double *data = collect_args(node, ctx, error, &data_size);
-      if (!error_is_ok(*error))
-        return value_number(0);
-      if (data_size == 0) {
-        safe_free(data);
-        *error = error_create(ERR_INVALID_ARGS, "vec_mag requires elements");
-        return value_number(0);
-      }
-      value_t v = value_array(data, data_size);
-      double mag = linalg_vec_magnitude(&v, error);
-      value_free(&v);
-      return value_number(mag);
-
-    } else {
-      // vec_add, vec_sub, vec_dot
-      if (node->child_count == 2) {
-        value_t a = eval_node(node->children[0], ctx, error);
-        if (!error_is_ok(*error))
-          return value_number(0);
-        value_t b = eval_node(node->children[1], ctx, error);
-        if (!error_is_ok(*error)) {
-          value_free(&a);
-          return value_number(0);
-        }
-
-        if (a.type == VALUE_ARRAY && b.type == VALUE_ARRAY) {
-          value_t result;
-          if (strcmp(fname, "vec_add") == 0)
-            result = linalg_vec_add(&a, &b, error);
-          else if (strcmp(fname, "vec_sub") == 0)
-            result = linalg_vec_sub(&a, &b, error);
-          else
-            result = value_number(linalg_vec_dot(&a, &b, error));
-          value_free(&a);
-          value_free(&b);
-          return result;
-        }
-        value_free(&a);
-        value_free(&b);
-      }
-
-      size_t total;
-      double *full = collect_args(node, ctx, error, &total);
-      if (!error_is_ok(*error))
-        return value_number(0);
-      if (total < 2 || total % 2 != 0) {
-        safe_free(full);
-        *error =
-            error_create(ERR_INVALID_ARGS, "Requires even number of elements");
-        return value_number(0);
-      }
+// Height of the DAG, in one pass: children precede their parents in the
+// node pool. Deeper expressions than ctx->max_depth are rejected here, so
+// the evaluator, the emitter and the VM stack never see them.
+static int check_depth(const ast_t *ast, engine_context_t *ctx,
+                       error_t *error) {
+  uint32_t *height =
+      arena_alloc(ctx->arena, ast->node_count * sizeof(uint32_t));
+  if (!height) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate evaluator state");
+    return -1;
+  }
 
-      size_t half = total / 2;
-      double *v_a_data = safe_malloc(half * sizeof(double));
-      double *v_b_data = safe_malloc(half * sizeof(double));
-      memcpy(v_a_data, full, half * sizeof(double));
-      memcpy(v_b_data, full + half, half * sizeof(double));
-      safe_free(full);
-
-      value_t v_a = value_array(v_a_data, half);
-      value_t v_b = value_array(v_b_data, half);
-
-      value_t result;
-      if (strcmp(fname, "vec_add") == 0)
-        result = linalg_vec_add(&v_a, &v_b, error);
-      else if (strcmp(fname, "vec_sub") == 0)
-        result = linalg_vec_sub(&v_a, &v_b, error);
-      else
-        result = value_number(linalg_vec_dot(&v_a, &v_b, error));
-
-      value_free(&v_a);
-      value_free(&v_b);
-      return result;
+  for (size_t i = 0; i < ast->node_count; i++) {
+    const ast_node_t *node = &ast->nodes[i];
+    uint32_t deepest = 0;
+    for (size_t c = 0; c < node->child_count; c++) {
+      uint32_t h = height[ast->edges[node->first + c]];
+      if (h > deepest)
+        deepest = h;
     }
+    height[i] = deepest + 1;
   }
 
-  // Matrix operations
-  if (strcmp(fname, "mat_add") == 0 || strcmp(fname, "mat_sub") == 0 ||
-      strcmp(fname, "mat_mul") == 0 || strcmp(fname, "mat_vec_mul") == 0 ||
-      strcmp(fname, "mat_det") == 0 || strcmp(fname, "mat_transpose") == 0) {
-
-    if (strcmp(fname, "mat_det") == 0 || strcmp(fname, "mat_transpose") == 0) {
-      if (node->child_count == 0) {
-        *error = error_create(ERR_INVALID_ARGS, "Requires matrix arguments");
-        return value_number(0);
-      }
-      // If first child is a matrix, use it. Otherwise error.
-      // (For now we assume arguments are numbers that form a matrix, but that's
-      // complex without constructor) Let's assume the user uses constructor:
-      // mat_det(matrix(2, 2, 1, 0, 0, 1))
-      value_t arg = eval_node(node->children[0], ctx, error);
-      if (!error_is_ok(*error))
-        return value_number(0);
-
-      if (arg.type != VALUE_MATRIX) {
-        *error = error_create(
-            ERR_INVALID_ARGS,
-            "Operand must be a matrix. Use matrix(r, c, ...) function.");
-        value_free(&arg);
-        return value_number(0);
-      }
-
-      value_t result;
-      if (strcmp(fname, "mat_det") == 0) {
-        double det = linalg_mat_det(&arg, error);
-        result = value_number(det);
-      } else {
-        result = linalg_mat_transpose(&arg, error);
-      }
-      value_free(&arg);
-      return result;
-    } else {
-      // Binary matrix ops: mat_add(m1, m2), mat_mul(m1, m2), mat_vec_mul(m, v)
-      if (node->child_count != 2) {
-        *error =
-            error_create(ERR_INVALID_ARGS,
-                         "Matrix binary ops require 2 matrix/vector arguments");
-        return value_number(0);
-      }
-
-      value_t a = eval_node(node->children[0], ctx, error);
-      if (!error_is_ok(*error))
-        return value_number(0);
+  if (height[ast->root] > ctx->max_depth) {
+    *error = error_create(ERR_EVAL, "Expression nested too deeply");
+    return -1;
+  }
+  return 0;
+}
 
-      value_t b = eval_node(node->children[1], ctx, error);
-      if (!error_is_ok(*error)) {
-        value_free(&a);
-        return value_number(0);
-      }
+// Parse into the context arena and run the optimizer, so that whatever is
+// evaluated, compiled or cached is the folded, hash-consed DAG
+static ast_t *parse_folded(const char *expression, engine_context_t *ctx,
+                           error_t *error) {
+  ast_t *ast = parse(expression, ctx->arena, ctx->symbols, error);
+  if (ast && (check_depth(ast, ctx, error) != 0 ||
+              ast_fold(ast, ctx->arena, error) != 0 ||
+              ast_share(ast, ctx->arena, error) != 0))
+    return NULL;
+  return ast;
+}
 
-      value_t result;
-      if (strcmp(fname, "mat_add") == 0) {
-        result = linalg_mat_add(&a, &b, error);
-      } else if (strcmp(fname, "mat_sub") == 0) {
-        result = linalg_mat_sub(&a, &b, error);
-      } else if (strcmp(fname, "mat_mul") == 0) {
-        result = linalg_mat_mul(&a, &b, error);
-      } else { // mat_vec_mul
-        result = linalg_mat_vec_mul(&a, &b, error);
-      }
+// Keep a successful result as `ans` and hand the caller a view of it.
+// A fresh result is moved, not copied; only a view of another variable
+// (e.g. the expression `x`) has to be cloned so `ans` owns its data.
+// Assignments leave `ans` alone and return a view of their variable.
+static value_t publish_result(engine_context_t *ctx, value_t result,
+                              int assignment, const error_t *error) {
+  if (!error_is_ok(*error) || assignment)
+    return result;
+
+  symbol_set(ctx->symbols, SYMBOL_ANS, result);
+  return value_borrow(symbol_get(ctx->symbols, SYMBOL_ANS));
+}
 
-      value_free(&a);
-      value_free(&b);
-      return result;
+// Scratch for running a program: the context's value stack, which the tree
+// walker is not using meanwhile. Programs keep no state of their own, so
+// one program may run on several threads, each with its own context.
+static value_t *vm_scratch(engine_context_t *ctx, const bytecode_t *program,
+                           error_t *error) {
+  size_t needed = bytecode_scratch_size(program);
+  if (needed > ctx->stack_capacity) {
+    value_t *stack = safe_realloc(ctx->stack, needed * sizeof(value_t));
+    if (!stack) {
+      *error = error_create(ERR_MEMORY, "Failed to allocate VM stack");
+      return NULL;
     }
+    ctx->stack = stack;
+    ctx->stack_capacity = needed;
   }
+  return ctx->stack;
+}
 
-  // Unary operators as functions
-  // neg(x) = -x
-  if (strcmp(fname, "neg") == 0) {
-    if (node->child_count != 1) {
-      *error = error_create(ERR_INVALID_ARGS, "neg requires 1 argument");
-      return value_number(0);
-    }
-    value_t arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    double result = -arg.as.number;
-    value_free(&arg);
-    return value_number(result);
+// Look the normalized text up in the cache; on a miss compile it once and
+// keep the program after its first run. Expressions that fail to compile
+// are not cached, nor are failed ones that named new variables: those
+// names are forgotten again, so typos never use up the symbol table.
+static value_t eval_cached(const char *expression, engine_context_t *ctx,
+                           int *assignment, error_t *error) {
+  char *key = arena_alloc(ctx->arena, strlen(expression) + 1);
+  if (!key) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate cache key");
+    return value_number(0);
   }
 
-  // bnot(x) = bitwise NOT ~x
-  if (strcmp(fname, "bnot") == 0) {
-    if (node->child_count != 1) {
-      *error = error_create(ERR_INVALID_ARGS, "bnot requires 1 argument");
-      return value_number(0);
-    }
-    value_t arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    long long result = ~((long long)arg.as.number);
-    value_free(&arg);
-    return value_number((double)result);
-  }
+  size_t length = expr_cache_normalize(expression, key);
+  uint64_t hash = expr_cache_hash(key, length);
+  bytecode_t *program = expr_cache_lookup(ctx->cache, key, length, hash);
+  size_t known = ctx->symbols->count;
+  int fresh = 0;
 
-  // not(x) = logical NOT !x
-  if (strcmp(fname, "not") == 0) {
-    if (node->child_count != 1) {
-      *error = error_create(ERR_INVALID_ARGS, "not requires 1 argument");
-      return value_number(0);
-    }
-    value_t arg = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    double result = (arg.as.number == 0.0) ? 1.0 : 0.0;
-    value_free(&arg);
-    return value_number(result);
+  if (!program) {
+    ast_t *ast = parse_folded(expression, ctx, error);
+    program = ast ? bytecode_compile(ast, error) : NULL;
+    fresh = program != NULL;
   }
 
-  // Logic operators
-  if (strcmp(fname, "and") == 0 || strcmp(fname, "or") == 0 ||
-      strcmp(fname, "xor") == 0) {
-    size_t data_size;
-    double *data = collect_args(node, ctx, error, &data_size);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    if (data_size < 2) {
-      safe_free(data);
-      *error = error_create(ERR_INVALID_ARGS, "Logic ops require 2+ arguments");
-      return value_number(0);
-    }
-    int res = (data[0] != 0.0);
-    for (size_t i = 1; i < data_size; i++) {
-      int val = (data[i] != 0.0);
-      if (strcmp(fname, "and") == 0)
-        res = res && val;
-      else if (strcmp(fname, "or") == 0)
-        res = res || val;
-      else
-        res = res ^ val;
-    }
-    safe_free(data);
-    return value_number(res ? 1.0 : 0.0);
+  if (!program) {
+    arena_reset(ctx->arena);
+    symbol_forget(ctx->symbols, known);
+    return value_number(0);
   }
+  *assignment = program->code[program->code_size - 1].opcode == OP_STORE_VAR;
+  value_t *scratch = vm_scratch(ctx, program, error);
+  value_t result = scratch
+                       ? bytecode_exec(program, ctx->symbols, scratch, error)
+                       : value_number(0);
+
+  // The key lives in the arena, so it is reset only once the program is
+  // cached; the result may be a view of the program's constants
+  if (fresh && !error_is_ok(*error) && ctx->symbols->count > known) {
+    bytecode_free(program);
+    symbol_forget(ctx->symbols, known);
+  } else if (fresh &&
+             expr_cache_insert(ctx->cache, key, length, hash, program) != 0) {
+    value_free(&result);
+    *error = error_create(ERR_MEMORY, "Failed to cache expression");
+    result = value_number(0);
+  }
+  arena_reset(ctx->arena);
+  return result;
+}
 
-  // Set operations (treat arguments as two sets split in half)
-  if (strcmp(fname, "set_union") == 0 || strcmp(fname, "set_intersect") == 0 ||
-      strcmp(fname, "set_diff") == 0) {
-    if (node->child_count == 2) {
-      value_t a = eval_node(node->children[0], ctx, error);
-      if (!error_is_ok(*error))
-        return value_number(0);
-      value_t b = eval_node(node->children[1], ctx, error);
-      if (!error_is_ok(*error)) {
-        value_free(&a);
-        return value_number(0);
-      }
-
-      if (a.type == VALUE_ARRAY && b.type == VALUE_ARRAY) {
-        double *res_data;
-        size_t res_size;
-        if (strcmp(fname, "set_union") == 0)
-          res_data =
-              set_union(a.as.array.data, a.as.array.size, b.as.array.data,
-                        b.as.array.size, &res_size, error);
-        else if (strcmp(fname, "set_intersect") == 0)
-          res_data = set_intersection(a.as.array.data, a.as.array.size,
-                                      b.as.array.data, b.as.array.size,
-                                      &res_size, error);
-        else
-          res_data =
-              set_difference(a.as.array.data, a.as.array.size, b.as.array.data,
-                             b.as.array.size, &res_size, error);
-        value_free(&a);
-        value_free(&b);
-        if (!error_is_ok(*error) || !res_data)
-          return value_number(0);
-        return value_array(res_data, res_size);
-      }
-      value_free(&a);
-      value_free(&b);
-    }
-
-    size_t total;
-    double *full = collect_args(node, ctx, error, &total);
-    if (!error_is_ok(*error))
-      return value_number(0);
-    if (total < 2 || total % 2 != 0) {
-      safe_free(full);
-      *error = error_create(ERR_INVALID_ARGS,
-                            "Set ops require even number of elements");
-      return value_number(0);
-    }
-
-    size_t half = total / 2;
-    size_t res_size = 0;
-    double *res_data = NULL;
-    if (strcmp(fname, "set_union") == 0)
-      res_data = set_union(full, half, full + half, half, &res_size, error);
-    else if (strcmp(fname, "set_intersect") == 0)
-      res_data =
-          set_intersection(full, half, full + half, half, &res_size, error);
-    else
-      res_data =
-          set_difference(full, half, full + half, half, &res_size, error);
-
-    safe_free(full);
-    if (!error_is_ok(*error) || !res_data)
-      return value_number(0);
-    return value_array(res_data, res_size);
+// Evaluate without touching `ans`. The result is owned by the caller,
+// except after an assignment or a bare variable read: then it is a view
+// of that variable.
+static value_t eval_expression(const char *expression, engine_context_t *ctx,
+                               int *assignment, error_t *error) {
+  *assignment = 0;
+  if (ctx->cache->capacity > 0)
+    return eval_cached(expression, ctx, assignment, error);
+
+  // The tree and all parser scratch live in the context arena; one reset
+  // releases them and keeps the blocks for the next expression
+  size_t known = ctx->symbols->count;
+  ast_t *ast = parse_folded(expression, ctx, error);
+  if (!ast) {
+    arena_reset(ctx->arena);
+    symbol_forget(ctx->symbols, known);
+    return value_number(0);
   }
 
-  *error = error_create(ERR_UNSUPPORTED, "Unknown function");
-  return value_number(0);
+  *assignment = ast->nodes[ast->root].type == NODE_ASSIGN;
+  value_t result = eval_tree(ast, ctx, error);
+  arena_reset(ctx->arena);
+  if (!error_is_ok(*error))
+    symbol_forget(ctx->symbols, known);
+  return result;
 }
 
-// Simple recursive evaluator for AST
-static value_t eval_node(ast_node_t *node, engine_context_t *ctx,
-                         error_t *error) {
-  if (!node) {
-    *error = error_create(ERR_EVAL, "Null node");
+value_t engine_eval(const char *expression, engine_context_t *ctx,
+                    error_t *error) {
+  if (!expression || !ctx) {
+    if (error)
+      *error = error_create(ERR_EVAL, "Invalid input");
     return value_number(0);
   }
 
-  if (node->type == NODE_NUMBER) {
-    *error = error_ok();
-    return value_number(node->num_value);
-  }
+  int assignment;
+  value_t result = eval_expression(expression, ctx, &assignment, error);
+  return publish_result(ctx, result, assignment, error);
+}
+
+// Batch state shared by the workers. Expressions are handed out in chunks
+// through an atomic cursor; each worker writes only its own indices.
+typedef struct {
+  const engine_context_t *source;
+  const char *const *expressions;
+  value_t *results;
+  error_t *errors;
+  size_t count;
+  atomic_size_t next;
+} batch_t;
+
+#define BATCH_CHUNK 16
+
+// Private context for one worker: the settings and variables of the
+// source context, so workers never write to shared state
+static engine_context_t *batch_context(const engine_context_t *source) {
+  engine_context_t *ctx = engine_context_create(source->mode);
+  if (!ctx)
+    return NULL;
 
-  if (node->type == NODE_FUNCTION) {
-    return eval_function(node, ctx, error);
+  symbol_table_t *symbols = symbol_table_clone(source->symbols);
+  if (!symbols ||
+      expr_cache_set_capacity(ctx->cache, source->cache->capacity) != 0) {
+    symbol_table_free(symbols);
+    engine_context_free(ctx);
+    return NULL;
   }
+  symbol_table_free(ctx->symbols);
+  ctx->symbols = symbols;
+  ctx->base = source->base;
+  ctx->jit = source->jit;
+  ctx->max_depth = source->max_depth;
+  return ctx;
+}
 
-  if (node->type == NODE_OPERATOR) {
-    // Binary operators need 2 children
-    if (node->child_count < 2) {
-      *error = error_create(ERR_EVAL, "Operator requires 2 operands");
-      return value_number(0);
-    }
+static void *batch_worker(void *arg) {
+  batch_t *batch = arg;
+  engine_context_t *ctx = batch_context(batch->source);
+  if (!ctx)
+    return NULL;
 
-    value_t left = eval_node(node->children[0], ctx, error);
-    if (!error_is_ok(*error))
-      return value_number(0);
+  for (;;) {
+    size_t start = atomic_fetch_add(&batch->next, BATCH_CHUNK);
+    if (start >= batch->count)
+      break;
+    size_t end = start + BATCH_CHUNK < batch->count ? start + BATCH_CHUNK
+                                                      : batch->count;
 
-    value_t right = eval_node(node->children[1], ctx, error);
-    if (!error_is_ok(*error)) {
-      value_free(&left);
-      return value_number(0);
+    for (size_t i = start; i < end; i++) {
+      int assignment;
+      error_t *error = &batch->errors[i];
+      value_t result =
+          eval_expression(batch->expressions[i], ctx, &assignment, error);
+      // Views of variables die with the worker context
+      batch->results[i] = result.borrowed ? value_clone(&result) : result;
     }
+  }
 
-    // Only handle number operations for now
-    if (left.type != VALUE_NUMBER || right.type != VALUE_NUMBER) {
-      *error = error_create(ERR_EVAL, "Operator requires numeric operands");
-      value_free(&left);
-      value_free(&right);
-      return value_number(0);
-    }
+  engine_context_free(ctx);
+  return NULL;
+}
 
-    double result = 0;
-    *error = error_ok();
-
-    if (strcmp(node->op, "+") == 0) {
-      result = left.as.number + right.as.number;
-    } else if (strcmp(node->op, "-") == 0) {
-      result = left.as.number - right.as.number;
-    } else if (strcmp(node->op, "*") == 0) {
-      result = left.as.number * right.as.number;
-    } else if (strcmp(node->op, "/") == 0) {
-      if (right.as.number == 0) {
-        *error = error_create(ERR_DIV_ZERO, "Division by zero");
-        value_free(&left);
-        value_free(&right);
-        return value_number(0);
-      }
-      result = left.as.number / right.as.number;
-    } else if (strcmp(node->op, "%") == 0) {
-      result = fmod(left.as.number, right.as.number);
-    } else if (strcmp(node->op, "&") == 0) {
-      result = (double)((long long)left.as.number & (long long)right.as.number);
-    } else if (strcmp(node->op, "|") == 0) {
-      result = (double)((long long)left.as.number | (long long)right.as.number);
-    } else if (strcmp(node->op, "^") == 0) {
-      result = (double)((long long)left.as.number ^ (long long)right.as.number);
-    } else if (strcmp(node->op, "<<") == 0) {
-      long long shift = (long long)right.as.number;
-      if (shift < 0 || shift > 63) {
-        *error = error_create(ERR_INVALID_ARGS, "Invalid shift count");
-        value_free(&left);
-        value_free(&right);
-        return value_number(0);
-      }
-      result = (double)((long long)left.as.number << shift);
-    } else if (strcmp(node->op, ">>") == 0) {
-      long long shift = (long long)right.as.number;
-      if (shift < 0 || shift > 63) {
-        *error = error_create(ERR_INVALID_ARGS, "Invalid shift count");
-        value_free(&left);
-        value_free(&right);
-        return value_number(0);
-      }
-      result = (double)((long long)left.as.number >> shift);
-    } else {
-      *error = error_create(ERR_UNSUPPORTED, "Unsupported operator");
-      value_free(&left);
-      value_free(&right);
-      return value_number(0);
-    }
+int engine_eval_batch(const engine_context_t *ctx,
+                      const char *const *expressions, size_t count,
+                      value_t *results, error_t *errors, size_t threads) {
+  if (!ctx || (count && (!expressions || !results || !errors)))
+    return -1;
+
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (size_t)online : 1;
+  }
+  size_t chunks = (count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+  if (threads > chunks)
+    threads = chunks ? chunks : 1;
+
+  // Anything no worker reaches keeps this error
+  for (size_t i = 0; i < count; i++) {
+    results[i] = value_number(0);
+    errors[i] = error_create(ERR_MEMORY, "Failed to start batch worker");
+  }
+
+  batch_t batch = {ctx, expressions, results, errors, count, 0};
+  pthread_t *workers = safe_malloc(threads * sizeof(pthread_t));
+  size_t started = 0;
+  // The calling thread is worker 0; a thread that fails to start just
+  // leaves its share to the others
+  while (workers && started + 1 < threads &&
+         pthread_create(&workers[started], NULL, batch_worker, &batch) == 0)
+    started++;
+  batch_worker(&batch);
+  for (size_t i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  safe_free(workers);
+
+  return atomic_load(&batch.next) >= count ? 0 : -1;
+}
 
-    value_free(&left);
-    value_free(&right);
+bytecode_t *engine_compile(const char *expression, engine_context_t *ctx,
+                           error_t *error) {
+  if (!expression || !ctx) {
+    if (error)
+      *error = error_create(ERR_EVAL, "Invalid input");
+    return NULL;
+  }
 
-    // Check for NaN or Inf
-    if (isnan(result) || isinf(result)) {
-      *error = error_create(ERR_DOMAIN, "Result is not a finite number");
-      return value_number(0);
-    }
+  size_t known = ctx->symbols->count;
+  ast_t *ast = parse_folded(expression, ctx, error);
+  bytecode_t *program = ast ? bytecode_compile(ast, error) : NULL;
+  arena_reset(ctx->arena);
+  if (!program)
+    symbol_forget(ctx->symbols, known);
 
-    return value_number(result);
+  // Programs the JIT rejects simply stay on the VM
+  if (program && ctx->jit) {
+    error_t ignored;
+    program->native = jit_compile(program, &ignored);
   }
-
-  *error = error_create(ERR_UNSUPPORTED, "Unsupported node type");
-  return value_number(0);
+  return program;
 }
 
-value_t engine_eval(const char *expression, engine_context_t *ctx,
+value_t engine_exec(bytecode_t *program, engine_context_t *ctx,
                     error_t *error) {
-  if (!expression || !ctx) {
-    if (error)
-      *error = error_create(ERR_EVAL, "Invalid input");
+  if (!program || !ctx) {
+    *error = error_create(ERR_EVAL, "Invalid input");
     return value_number(0);
   }
 
-  ast_node_t *ast = parse(expression, error);
-  if (!ast) {
+  double number;
+  if (program->native &&
+      jit_exec(program->native, ctx->symbols, &number, error) == 0)
+    return value_number(number);
+  value_t *scratch = vm_scratch(ctx, program, error);
+  if (!scratch)
     return value_number(0);
-  }
-
-  value_t result = eval_node(ast, ctx, error);
-  ast_free(ast);
+  return bytecode_exec(program, ctx->symbols, scratch, error);
+}
 
-  return result;
+int engine_eval_columns(bytecode_t *program, engine_context_t *ctx,
+                        const engine_column_t *bindings, size_t binding_count,
+                        size_t rows, double *out, error_t *error) {
+  if (!program || !ctx || (binding_count && !bindings) || (rows && !out)) {
+    *error = error_create(ERR_EVAL, "Invalid input");
+    return -1;
+  }
+
+  // Resolve every name first: resolving may add slots to the table
+  int *slots = arena_alloc(ctx->arena, (binding_count + 1) * sizeof(int));
+  if (!slots) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate bindings");
+    return -1;
+  }
+  for (size_t i = 0; i < binding_count; i++) {
+    slots[i] = symbol_resolve(ctx->symbols, bindings[i].name,
+                              strlen(bindings[i].name), error);
+    if (slots[i] < 0) {
+      arena_reset(ctx->arena);
+      return -1;
+    }
+  }
+
+  size_t column_count = ctx->symbols->count;
+  const double **columns =
+      arena_calloc(ctx->arena, column_count, sizeof(const double *));
+  if (!columns) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate bindings");
+    arena_reset(ctx->arena);
+    return -1;
+  }
+  for (size_t i = 0; i < binding_count; i++)
+    columns[slots[i]] = bindings[i].values;
+
+  value_t *scratch = vm_scratch(ctx, program, error);
+  int status = scratch ? bytecode_exec_columns(program, ctx->symbols,
+                                               (const double *const *)columns,
+                                               column_count, rows, out,
+                                               scratch, error)
+                       : -1;
+  arena_reset(ctx->arena);
+  return status;
 }
 
 char *value_to_string(const value_t *val, int base) {
@@ -925,9 +688,11 @@ char *value_to_string(const value_t *val, int base) {
       snprintf(buffer, 256, "%.10g", num);
     }
   } else if (val->type == VALUE_ARRAY) {
+    // Stop early enough that one more element, its separator and the
+    // closing bracket still fit in the buffer
     int pos = 0;
     pos += snprintf(buffer + pos, 256 - pos, "[");
-    for (size_t i = 0; i < val->as.array.size && pos < 250; i++) {
+    for (size_t i = 0; i < val->as.array.size && pos < 238; i++) {
       if (i > 0)
         pos += snprintf(buffer + pos, 256 - pos, ", ");
       pos += snprintf(buffer + pos, 256 - pos, "%.6g", val->as.array.data[i]);
@@ -937,12 +702,14 @@ char *value_to_string(const value_t *val, int base) {
     int pos = 0;
     size_t total = val->as.matrix.rows * val->as.matrix.cols;
     pos += snprintf(buffer + pos, 256 - pos, "[");
-    for (size_t i = 0; i < total && pos < 250; i++) {
+    for (size_t i = 0; i < total && pos < 238; i++) {
       if (i > 0)
         pos += snprintf(buffer + pos, 256 - pos, ", ");
       pos += snprintf(buffer + pos, 256 - pos, "%.6g", val->as.matrix.data[i]);
     }
     snprintf(buffer + pos, 256 - pos, "]");
+  } else if (val->type == VALUE_STRING) {
+    snprintf(buffer, 256, "\"%.250s\"", val->as.string);
   }
 
   return buffer;
@@ -0,0 +1,1081 @@
+#include "engine/functions.h"
+#include "engine/discrete.h"
+#include "engine/linalg.h"
+#include "engine/loader.h"
+#include "engine/probability.h"
+#include "engine/set_ops.h"
+#include "engine/statistics.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+binary_op_t binary_op_lookup(const char *op, size_t length) {
+  if (length == 1) {
+    switch (op[0]) {
+    case '+':
+      return BINOP_ADD;
+    case '-':
+      return BINOP_SUB;
+    case '*':
+      return BINOP_MUL;
+    case '/':
+      return BINOP_DIV;
+    case '%':
+      return BINOP_MOD;
+    case '&':
+      return BINOP_AND;
+    case '|':
+      return BINOP_OR;
+    case '^':
+      return BINOP_XOR;
+    default:
+      return BINOP_INVALID;
+    }
+  }
+  if (length == 2 && op[0] == '<' && op[1] == '<')
+    return BINOP_SHL;
+  if (length == 2 && op[0] == '>' && op[1] == '>')
+    return BINOP_SHR;
+  return BINOP_INVALID;
+}
+
+double binary_op_apply(binary_op_t op, double left, double right,
+                       error_t *error) {
+  double result = 0;
+  error_clear(error);
+
+  switch (op) {
+  case BINOP_ADD:
+    result = left + right;
+    break;
+  case BINOP_SUB:
+    result = left - right;
+    break;
+  case BINOP_MUL:
+    result = left * right;
+    break;
+  case BINOP_DIV:
+    if (right == 0) {
+      *error = error_create(ERR_DIV_ZERO, "Division by zero");
+      return 0;
+    }
+    result = left / right;
+    break;
+  case BINOP_MOD:
+    result = fmod(left, right);
+    break;
+  case BINOP_AND:
+    result = (double)((long long)left & (long long)right);
+    break;
+  case BINOP_OR:
+    result = (double)((long long)left | (long long)right);
+    break;
+  case BINOP_XOR:
+    result = (double)((long long)left ^ (long long)right);
+    break;
+  case BINOP_SHL:
+  case BINOP_SHR: {
+    long long shift = (long long)right;
+    if (shift < 0 || shift > 63) {
+      *error = error_create(ERR_INVALID_ARGS, "Invalid shift count");
+      return 0;
+    }
+    if (op == BINOP_SHL)
+      result = (double)((long long)left << shift);
+    else
+      result = (double)((long long)left >> shift);
+    break;
+  }
+  default:
+    *error = error_create(ERR_UNSUPPORTED, "Unsupported operator");
+    return 0;
+  }
+
+  // Check for NaN or Inf
+  if (isnan(result) || isinf(result)) {
+    *error = error_create(ERR_DOMAIN, "Result is not a finite number");
+    return 0;
+  }
+
+  return result;
+}
+
+// out[i] = SCALAR(x, y) over x = left[i], y = right[i], where an operand
+// with a count of 1 is broadcast. With SSE2 (the x86-64 baseline) two
+// lanes go through VECTOR at a time; -O2 leaves these loops scalar since
+// out may alias either operand.
+#ifdef __SSE2__
+#define ELEMENTWISE(SCALAR, VECTOR)                                            \
+  do {                                                                         \
+    size_t i = 0;                                                              \
+    if (left_count == right_count) {                                           \
+      for (; i + 2 <= n; i += 2)                                               \
+        _mm_storeu_pd(out + i, VECTOR(_mm_loadu_pd(left + i),                  \
+                                      _mm_loadu_pd(right + i)));               \
+    } else if (left_count == 1) {                                              \
+      __m128d x2 = _mm_set1_pd(lhs);                                           \
+      for (; i + 2 <= n; i += 2)                                               \
+        _mm_storeu_pd(out + i, VECTOR(x2, _mm_loadu_pd(right + i)));           \
+    } else {                                                                   \
+      __m128d y2 = _mm_set1_pd(rhs);                                           \
+      for (; i + 2 <= n; i += 2)                                               \
+        _mm_storeu_pd(out + i, VECTOR(_mm_loadu_pd(left + i), y2));            \
+    }                                                                          \
+    for (; i < n; i++)                                                         \
+      out[i] = SCALAR(LEFT(i), RIGHT(i));                                      \
+  } while (0)
+#else
+#define ELEMENTWISE(SCALAR, VECTOR)                                            \
+  do {                                                                         \
+    for (size_t i = 0; i < n; i++)                                             \
+      out[i] = SCALAR(LEFT(i), RIGHT(i));                                      \
+  } while (0)
+#endif
+
+// A broadcast operand is read before out is written, since out may be
+// its only element
+#define LEFT(i) (left_count == 1 ? lhs : left[i])
+#define RIGHT(i) (right_count == 1 ? rhs : right[i])
+
+#define SCALAR_ADD(x, y) ((x) + (y))
+#define SCALAR_SUB(x, y) ((x) - (y))
+#define SCALAR_MUL(x, y) ((x) * (y))
+#define SCALAR_DIV(x, y) ((x) / (y))
+
+// Whether any of n values is zero, or (finite == 1) not finite
+static int any_element(const double *values, size_t n, int finite) {
+  size_t i = 0;
+  int found = 0;
+#ifdef __SSE2__
+  // x - x is NaN exactly when x is infinite or NaN
+  __m128d zero = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2) {
+    __m128d v = _mm_loadu_pd(values + i);
+    __m128d test = finite ? _mm_sub_pd(v, v) : v;
+    __m128d hit =
+        finite ? _mm_cmpunord_pd(test, test) : _mm_cmpeq_pd(test, zero);
+    found |= _mm_movemask_pd(hit);
+  }
+#endif
+  for (; i < n; i++)
+    found |= finite ? !isfinite(values[i]) : values[i] == 0;
+  return found != 0;
+}
+
+int binary_op_elements(binary_op_t op, double *out, const double *left,
+                       size_t left_count, const double *right,
+                       size_t right_count, error_t *error) {
+  size_t n = left_count > right_count ? left_count : right_count;
+  double lhs = left[0], rhs = right[0];
+
+  switch (op) {
+  case BINOP_ADD:
+    ELEMENTWISE(SCALAR_ADD, _mm_add_pd);
+    break;
+  case BINOP_SUB:
+    ELEMENTWISE(SCALAR_SUB, _mm_sub_pd);
+    break;
+  case BINOP_MUL:
+    ELEMENTWISE(SCALAR_MUL, _mm_mul_pd);
+    break;
+  case BINOP_DIV:
+    if (any_element(right, right_count, 0)) {
+      *error = error_create(ERR_DIV_ZERO, "Division by zero");
+      return -1;
+    }
+    ELEMENTWISE(SCALAR_DIV, _mm_div_pd);
+    break;
+  case BINOP_MOD:
+    for (size_t i = 0; i < n; i++)
+      out[i] = fmod(LEFT(i), RIGHT(i));
+    break;
+  default:
+    // Integer operators may fail per element (shift counts)
+    for (size_t i = 0; i < n; i++) {
+      out[i] = binary_op_apply(op, LEFT(i), RIGHT(i), error);
+      if (!error_is_ok(*error))
+        return -1;
+    }
+    break;
+  }
+
+  if (any_element(out, n, 1)) {
+    *error = error_create(ERR_DOMAIN, "Result is not a finite number");
+    return -1;
+  }
+  error_clear(error);
+  return 0;
+}
+
+#undef ELEMENTWISE
+#undef LEFT
+#undef RIGHT
+
+// Elements of an operand, or NULL for a number
+static double *operand_data(const value_t *val, size_t *count) {
+  if (val->type == VALUE_ARRAY) {
+    *count = val->as.array.size;
+    return val->as.array.data;
+  }
+  if (val->type == VALUE_MATRIX) {
+    *count = val->as.matrix.rows * val->as.matrix.cols;
+    return val->as.matrix.data;
+  }
+  *count = 1;
+  return NULL;
+}
+
+// The operand's buffer when it can hold the result: not shared with any
+// other value, same shape
+static double *reusable(value_t *val, const value_t *shape) {
+  if (val->type != shape->type || !value_unique(val))
+    return NULL;
+  return val->as.array.data;
+}
+
+value_t value_binary_op(binary_op_t op, value_t *left, value_t *right,
+                        error_t *error) {
+  if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+    double r =
+        binary_op_apply(op, left->as.number, right->as.number, error);
+    return value_number(error_is_ok(*error) ? r : 0);
+  }
+
+  // Operands of the same kind must agree in shape; a number broadcasts
+  const value_t *shape = left->type == VALUE_NUMBER ? right : left;
+  if (left->type != VALUE_NUMBER && right->type != VALUE_NUMBER) {
+    if (left->type != right->type ||
+        (left->type == VALUE_ARRAY &&
+         left->as.array.size != right->as.array.size) ||
+        (left->type == VALUE_MATRIX &&
+         (left->as.matrix.rows != right->as.matrix.rows ||
+          left->as.matrix.cols != right->as.matrix.cols))) {
+      *error = error_create(ERR_DIMENSION, "Operand shapes must match");
+      return value_number(0);
+    }
+  }
+
+  size_t left_count, right_count;
+  const double *a = operand_data(left, &left_count);
+  const double *b = operand_data(right, &right_count);
+  if (!a)
+    a = &left->as.number;
+  if (!b)
+    b = &right->as.number;
+
+  // Write over an operand's own buffer when nothing else can see it
+  value_t result = *shape;
+  result.borrowed = 0;
+  value_t *donor = reusable(left, shape) ? left
+                   : reusable(right, shape) ? right
+                                            : NULL;
+  double *out;
+  if (donor) {
+    out = donor->as.array.data;
+  } else {
+    size_t n = left_count > right_count ? left_count : right_count;
+    out = value_alloc(n);
+    if (!out) {
+      *error = error_create(ERR_MEMORY, "Failed to allocate result");
+      return value_number(0);
+    }
+  }
+
+  if (binary_op_elements(op, out, a, left_count, b, right_count, error) !=
+      0) {
+    if (!donor)
+      value_data_release(out);
+    return value_number(0);
+  }
+  if (donor)
+    *donor = value_number(0);
+  result.as.array.data = out;
+  return result;
+}
+
+// Helper to collect all arguments as a flattened array of doubles.
+// Handles nesting: flatten_args(1, [2, 3], matrix(2, 1, 4, 5)) -> [1, 2, 3, 4,
+// 5]. The result is a value_alloc() buffer, released with
+// value_data_release(); a single array or matrix argument is shared rather
+// than copied. NULL when out of memory.
+static double *flatten_args(const value_t *args, size_t argc,
+                            size_t *out_count) {
+  if (argc == 1 && args[0].type != VALUE_NUMBER) {
+    *out_count = args[0].type == VALUE_ARRAY
+                     ? args[0].as.array.size
+                     : args[0].as.matrix.rows * args[0].as.matrix.cols;
+    return value_data_retain(args[0].as.array.data);
+  }
+
+  size_t total = 0;
+  for (size_t i = 0; i < argc; i++) {
+    if (args[i].type == VALUE_NUMBER) {
+      total++;
+    } else if (args[i].type == VALUE_ARRAY) {
+      total += args[i].as.array.size;
+    } else if (args[i].type == VALUE_MATRIX) {
+      total += args[i].as.matrix.rows * args[i].as.matrix.cols;
+    }
+  }
+
+  *out_count = total;
+  double *data = value_alloc(total);
+  if (!data)
+    return NULL;
+
+  size_t pos = 0;
+  for (size_t i = 0; i < argc; i++) {
+    if (args[i].type == VALUE_NUMBER) {
+      data[pos++] = args[i].as.number;
+    } else if (args[i].type == VALUE_ARRAY) {
+      memcpy(data + pos, args[i].as.array.data,
+             args[i].as.array.size * sizeof(double));
+      pos += args[i].as.array.size;
+    } else if (args[i].type == VALUE_MATRIX) {
+      size_t size = args[i].as.matrix.rows * args[i].as.matrix.cols;
+      memcpy(data + pos, args[i].as.matrix.data, size * sizeof(double));
+      pos += size;
+    }
+  }
+  return data;
+}
+
+// Discrete Math
+
+static value_t fn_gcd(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  long long result = discrete_gcd((long long)args[0].as.number,
+                                  (long long)args[1].as.number, error);
+  return value_number((double)result);
+}
+
+static value_t fn_lcm(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  long long result = discrete_lcm((long long)args[0].as.number,
+                                  (long long)args[1].as.number, error);
+  return value_number((double)result);
+}
+
+static value_t fn_mod(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  long long result = discrete_mod((long long)args[0].as.number,
+                                  (long long)args[1].as.number, error);
+  return value_number((double)result);
+}
+
+static value_t fn_modpow(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  long long result =
+      discrete_modpow((long long)args[0].as.number, (long long)args[1].as.number,
+                      (long long)args[2].as.number, error);
+  return value_number((double)result);
+}
+
+static value_t fn_is_prime(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  int result = discrete_is_prime((long long)args[0].as.number, error);
+  return value_number((double)result);
+}
+
+// Probability
+
+static value_t fn_ncr(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return value_number(
+      prob_ncr((int)args[0].as.number, (int)args[1].as.number, error));
+}
+
+static value_t fn_npr(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return value_number(
+      prob_npr((int)args[0].as.number, (int)args[1].as.number, error));
+}
+
+static value_t fn_fact(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return value_number(prob_factorial((int)args[0].as.number, error));
+}
+
+// Binomial probability: binomial(n, p, k)
+static value_t fn_binomial(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return value_number(prob_binomial((int)args[0].as.number, args[1].as.number,
+                                    (int)args[2].as.number, error));
+}
+
+// Geometric probability: geometric(p, k)
+static value_t fn_geometric(const value_t *args, size_t argc,
+                            error_t *error) {
+  (void)argc;
+  return value_number(
+      prob_geometric(args[0].as.number, (int)args[1].as.number, error));
+}
+
+// Statistics (taking multiple arguments as a dataset)
+
+typedef double (*stats_fn_t)(const dataset_t *set, error_t *error);
+
+// Spans kept on the stack; longer argument lists allocate theirs
+#define LOCAL_SPANS 16
+
+// View the arguments as one dataset without copying them: an array or
+// matrix is a span over its data, a number a span of one over the
+// argument itself. The spans live in local when argc fits; release them
+// with dataset_release().
+static int args_dataset(const value_t *args, size_t argc, span_t *local,
+                        dataset_t *set, error_t *error) {
+  span_t *spans =
+      argc <= LOCAL_SPANS ? local : safe_malloc(argc * sizeof(span_t));
+  if (!spans) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate dataset");
+    return -1;
+  }
+
+  *set = (dataset_t){spans, argc, 0};
+  for (size_t i = 0; i < argc; i++) {
+    if (args[i].type == VALUE_NUMBER) {
+      spans[i] = (span_t){&args[i].as.number, 1};
+    } else {
+      size_t size = args[i].type == VALUE_ARRAY
+                        ? args[i].as.array.size
+                        : args[i].as.matrix.rows * args[i].as.matrix.cols;
+      spans[i] = (span_t){args[i].as.array.data, size};
+    }
+    set->size += spans[i].size;
+  }
+  return 0;
+}
+
+static void dataset_release(dataset_t *set, span_t *local) {
+  if (set->spans != local)
+    safe_free((span_t *)set->spans);
+}
+
+static value_t reduce_dataset(stats_fn_t fn, const value_t *args, size_t argc,
+                              error_t *error) {
+  span_t local[LOCAL_SPANS];
+  dataset_t set;
+  if (args_dataset(args, argc, local, &set, error) != 0)
+    return value_number(0);
+  double result = fn(&set, error);
+  dataset_release(&set, local);
+  return value_number(result);
+}
+
+static value_t fn_mean(const value_t *args, size_t argc, error_t *error) {
+  return reduce_dataset(stats_mean, args, argc, error);
+}
+
+static value_t fn_median(const value_t *args, size_t argc, error_t *error) {
+  return reduce_dataset(stats_median, args, argc, error);
+}
+
+static value_t fn_mode(const value_t *args, size_t argc, error_t *error) {
+  return reduce_dataset(stats_mode, args, argc, error);
+}
+
+static value_t fn_var(const value_t *args, size_t argc, error_t *error) {
+  return reduce_dataset(stats_variance, args, argc, error);
+}
+
+static value_t fn_stddev(const value_t *args, size_t argc, error_t *error) {
+  return reduce_dataset(stats_stddev, args, argc, error);
+}
+
+// Z-score: zscore(value, data1, data2, ...)
+static value_t fn_zscore(const value_t *args, size_t argc, error_t *error) {
+  span_t local[LOCAL_SPANS];
+  dataset_t set;
+  if (args_dataset(args + 1, argc - 1, local, &set, error) != 0)
+    return value_number(0);
+  double result = stats_zscore(args[0].as.number, &set, error);
+  dataset_release(&set, local);
+  return value_number(result);
+}
+
+// Correlation: correlation(x1, x2, ..., | y1, y2, ...) - split args in half
+static value_t fn_correlation(const value_t *args, size_t argc,
+                              error_t *error) {
+  size_t half = argc / 2;
+  double *x = safe_malloc(half * sizeof(double));
+  double *y = safe_malloc(half * sizeof(double));
+  if (!x || !y) {
+    safe_free(x);
+    safe_free(y);
+    *error = error_create(ERR_MEMORY, "Failed to allocate for correlation");
+    return value_number(0);
+  }
+
+  for (size_t i = 0; i < half; i++) {
+    x[i] = args[i].as.number;
+    y[i] = args[half + i].as.number;
+  }
+
+  double result = stats_correlation(x, half, y, half, error);
+  safe_free(x);
+  safe_free(y);
+  return value_number(result);
+}
+
+// Linear Algebra - Vector operations
+
+// vector(1, 2, 3) -> [1, 2, 3]
+static value_t fn_vector(const value_t *args, size_t argc, error_t *error) {
+  size_t data_size;
+  double *data = flatten_args(args, argc, &data_size);
+  if (!data) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate vector");
+    return value_number(0);
+  }
+  if (data_size == 0) {
+    value_data_release(data);
+    *error = error_create(ERR_INVALID_ARGS, "vector requires elements");
+    return value_number(0);
+  }
+  return value_array(data, data_size);
+}
+
+// matrix(rows, cols, e1, e2, ...), or matrix(rows, cols, row1, row2, ...)
+// with each row an array of cols elements; cols 0 takes the first row's
+static value_t fn_matrix(const value_t *args, size_t argc, error_t *error) {
+  size_t rows = (size_t)args[0].as.number;
+  size_t cols = (size_t)args[1].as.number;
+  int by_row = args[2].type == VALUE_ARRAY;
+  if (by_row && cols == 0)
+    cols = args[2].as.array.size;
+
+  int fits = argc - 2 == (by_row ? rows : rows * cols);
+  for (size_t i = 2; fits && i < argc; i++) {
+    fits = by_row ? args[i].type == VALUE_ARRAY &&
+                        args[i].as.array.size == cols
+                  : args[i].type == VALUE_NUMBER;
+  }
+  if (!fits) {
+    *error = error_create(ERR_INVALID_ARGS,
+                          "Matrix element count does not match dimensions");
+    return value_number(0);
+  }
+
+  double *mat_data = value_alloc(rows * cols);
+  if (!mat_data) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate matrix");
+    return value_number(0);
+  }
+  for (size_t i = 0; i < argc - 2; i++) {
+    if (by_row)
+      memcpy(mat_data + i * cols, args[i + 2].as.array.data,
+             cols * sizeof(double));
+    else
+      mat_data[i] = args[i + 2].as.number;
+  }
+  return value_matrix(mat_data, rows, cols);
+}
+
+// vec_add(1, 2, 3, 4) treats first half as vector a, second half as vector b
+static value_t vector_pair_op(function_id_t id, const value_t *args,
+                              size_t argc, error_t *error) {
+  if (argc == 2 && args[0].type == VALUE_ARRAY &&
+      args[1].type == VALUE_ARRAY) {
+    if (id == FUNC_VEC_ADD)
+      return linalg_vec_add(&args[0], &args[1], error);
+    if (id == FUNC_VEC_SUB)
+      return linalg_vec_sub(&args[0], &args[1], error);
+    return value_number(linalg_vec_dot(&args[0], &args[1], error));
+  }
+
+  size_t total;
+  double *full = flatten_args(args, argc, &total);
+  if (!full) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate vector");
+    return value_number(0);
+  }
+  if (total < 2 || total % 2 != 0) {
+    value_data_release(full);
+    *error = error_create(ERR_INVALID_ARGS, "Requires even number of elements");
+    return value_number(0);
+  }
+
+  // Both halves are views of the flattened buffer, which outlives them
+  size_t half = total / 2;
+  value_t v_a = value_array(full, half);
+  value_t v_b = value_array(full + half, half);
+  v_a.borrowed = v_b.borrowed = 1;
+
+  value_t result;
+  if (id == FUNC_VEC_ADD)
+    result = linalg_vec_add(&v_a, &v_b, error);
+  else if (id == FUNC_VEC_SUB)
+    result = linalg_vec_sub(&v_a, &v_b, error);
+  else
+    result = value_number(linalg_vec_dot(&v_a, &v_b, error));
+
+  value_data_release(full);
+  return result;
+}
+
+static value_t fn_vec_add(const value_t *args, size_t argc, error_t *error) {
+  return vector_pair_op(FUNC_VEC_ADD, args, argc, error);
+}
+
+static value_t fn_vec_sub(const value_t *args, size_t argc, error_t *error) {
+  return vector_pair_op(FUNC_VEC_SUB, args, argc, error);
+}
+
+static value_t fn_vec_dot(const value_t *args, size_t argc, error_t *error) {
+  return vector_pair_op(FUNC_VEC_DOT, args, argc, error);
+}
+
+static value_t fn_vec_scale(const value_t *args, size_t argc,
+                            error_t *error) {
+  double scalar = args[0].as.number;
+  size_t vec_size;
+  double *vec_data = flatten_args(args + 1, argc - 1, &vec_size);
+  if (!vec_data) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate vector");
+    return value_number(0);
+  }
+  value_t v = value_array(vec_data, vec_size);
+  value_t result = linalg_vec_scale(&v, scalar, error);
+  value_free(&v);
+  return result;
+}
+
+static value_t fn_vec_mag(const value_t *args, size_t argc, error_t *error) {
+  size_t data_size;
+  double *data = flatten_args(args, argc, &data_size);
+  if (!data) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate vector");
+    return value_number(0);
+  }
+  if (data_size == 0) {
+    value_data_release(data);
+    *error = error_create(ERR_INVALID_ARGS, "vec_mag requires elements");
+    return value_number(0);
+  }
+  value_t v = value_array(data, data_size);
+  double mag = linalg_vec_magnitude(&v, error);
+  value_free(&v);
+  return value_number(mag);
+}
+
+// Matrix operations (operands are built with matrix(r, c, ...))
+
+static value_t fn_mat_add(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return linalg_mat_add(&args[0], &args[1], error);
+}
+
+static value_t fn_mat_sub(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return linalg_mat_sub(&args[0], &args[1], error);
+}
+
+static value_t fn_mat_mul(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return linalg_mat_mul(&args[0], &args[1], error);
+}
+
+static value_t fn_mat_vec_mul(const value_t *args, size_t argc,
+                              error_t *error) {
+  (void)argc;
+  return linalg_mat_vec_mul(&args[0], &args[1], error);
+}
+
+static value_t fn_mat_det(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return value_number(linalg_mat_det(&args[0], error));
+}
+
+static value_t fn_mat_transpose(const value_t *args, size_t argc,
+                                error_t *error) {
+  (void)argc;
+  return linalg_mat_transpose(&args[0], error);
+}
+
+// Unary operators as functions
+
+// neg(x) = -x, element-wise over an array or matrix
+static value_t fn_neg(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  if (args[0].type == VALUE_NUMBER)
+    return value_number(-args[0].as.number);
+  value_t operand = value_borrow(&args[0]);
+  value_t minus_one = value_number(-1);
+  return value_binary_op(BINOP_MUL, &operand, &minus_one, error);
+}
+
+// bnot(x) = bitwise NOT ~x
+static value_t fn_bnot(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  (void)error;
+  return value_number((double)(~((long long)args[0].as.number)));
+}
+
+// not(x) = logical NOT !x
+static value_t fn_not(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  (void)error;
+  return value_number((args[0].as.number == 0.0) ? 1.0 : 0.0);
+}
+
+// Elements of a logic argument: a number, or every array/matrix entry
+static const double *logic_elements(const value_t *arg, size_t *count) {
+  if (arg->type == VALUE_ARRAY) {
+    *count = arg->as.array.size;
+    return arg->as.array.data;
+  }
+  if (arg->type == VALUE_MATRIX) {
+    *count = arg->as.matrix.rows * arg->as.matrix.cols;
+    return arg->as.matrix.data;
+  }
+  *count = 1;
+  return &arg->as.number;
+}
+
+// Logic operators over all (flattened) arguments, read in place
+static value_t logic_op(function_id_t id, const value_t *args, size_t argc,
+                        error_t *error) {
+  size_t total = 0;
+  int res = 0;
+  for (size_t i = 0; i < argc; i++) {
+    size_t count;
+    const double *data = logic_elements(&args[i], &count);
+    for (size_t j = 0; j < count; j++, total++) {
+      int val = (data[j] != 0.0);
+      if (total == 0)
+        res = val;
+      else if (id == FUNC_AND)
+        res = res && val;
+      else if (id == FUNC_OR)
+        res = res || val;
+      else
+        res = res ^ val;
+    }
+  }
+  if (total < 2) {
+    *error = error_create(ERR_INVALID_ARGS, "Logic ops require 2+ arguments");
+    return value_number(0);
+  }
+  return value_number(res ? 1.0 : 0.0);
+}
+
+int function_short_circuit(function_id_t id, const value_t *arg,
+                           double *result) {
+  if (id != FUNC_AND && id != FUNC_OR)
+    return 0;
+
+  // and() is settled by any zero, or() by any non-zero
+  size_t count;
+  const double *data = logic_elements(arg, &count);
+  for (size_t i = 0; i < count; i++) {
+    if ((data[i] != 0.0) == (id == FUNC_OR)) {
+      *result = id == FUNC_OR ? 1.0 : 0.0;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int function_condition(const value_t *cond, error_t *error) {
+  if (cond->type != VALUE_NUMBER) {
+    *error = error_create(ERR_INVALID_ARGS, "if: argument 1 must be a number");
+    return -1;
+  }
+  error_clear(error);
+  return cond->as.number != 0.0;
+}
+
+static value_t fn_and(const value_t *args, size_t argc, error_t *error) {
+  return logic_op(FUNC_AND, args, argc, error);
+}
+
+static value_t fn_or(const value_t *args, size_t argc, error_t *error) {
+  return logic_op(FUNC_OR, args, argc, error);
+}
+
+static value_t fn_xor(const value_t *args, size_t argc, error_t *error) {
+  return logic_op(FUNC_XOR, args, argc, error);
+}
+
+// if(cond, a, b) with every argument already evaluated (constant folding);
+// the evaluators themselves only evaluate the branch taken
+static value_t fn_if(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  int truth = function_condition(&args[0], error);
+  if (truth < 0)
+    return value_number(0);
+  return value_clone(&args[truth ? 1 : 2]);
+}
+
+// Set operations (two arrays, or all arguments split in half)
+static value_t set_op(function_id_t id, const value_t *args, size_t argc,
+                      error_t *error) {
+  const double *a_data, *b_data;
+  size_t a_size, b_size;
+  double *full = NULL;
+
+  if (argc == 2 && args[0].type == VALUE_ARRAY &&
+      args[1].type == VALUE_ARRAY) {
+    a_data = args[0].as.array.data;
+    a_size = args[0].as.array.size;
+    b_data = args[1].as.array.data;
+    b_size = args[1].as.array.size;
+  } else {
+    size_t total;
+    full = flatten_args(args, argc, &total);
+    if (!full) {
+      *error = error_create(ERR_MEMORY, "Failed to allocate set");
+      return value_number(0);
+    }
+    if (total < 2 || total % 2 != 0) {
+      value_data_release(full);
+      *error = error_create(ERR_INVALID_ARGS,
+                            "Set ops require even number of elements");
+      return value_number(0);
+    }
+    a_data = full;
+    b_data = full + total / 2;
+    a_size = b_size = total / 2;
+  }
+
+  size_t res_size = 0;
+  double *res_data;
+  if (id == FUNC_SET_UNION)
+    res_data = set_union(a_data, a_size, b_data, b_size, &res_size, error);
+  else if (id == FUNC_SET_INTERSECT)
+    res_data =
+        set_intersection(a_data, a_size, b_data, b_size, &res_size, error);
+  else
+    res_data = set_difference(a_data, a_size, b_data, b_size, &res_size, error);
+
+  value_data_release(full);
+  if (!error_is_ok(*error) || !res_data)
+    return value_number(0);
+  return value_array(res_data, res_size);
+}
+
+static value_t fn_set_union(const value_t *args, size_t argc,
+                            error_t *error) {
+  return set_op(FUNC_SET_UNION, args, argc, error);
+}
+
+static value_t fn_set_intersect(const value_t *args, size_t argc,
+                                error_t *error) {
+  return set_op(FUNC_SET_INTERSECT, args, argc, error);
+}
+
+static value_t fn_set_diff(const value_t *args, size_t argc, error_t *error) {
+  return set_op(FUNC_SET_DIFF, args, argc, error);
+}
+
+// load("file.npy")
+static value_t fn_load(const value_t *args, size_t argc, error_t *error) {
+  (void)argc;
+  return loader_npy(args[0].as.string, error);
+}
+
+// load_raw("file.bin"), load_raw("file.bin", n), load_raw("file.bin", r, c)
+static value_t fn_load_raw(const value_t *args, size_t argc,
+                           error_t *error) {
+  for (size_t i = 1; i < argc; i++) {
+    if (!(args[i].as.number >= 1 && args[i].as.number <= 1e15) ||
+        args[i].as.number != floor(args[i].as.number)) {
+      *error = error_create(ERR_INVALID_ARGS,
+                            "load_raw: dimensions must be positive integers");
+      return value_number(0);
+    }
+  }
+  size_t rows = argc == 3 ? (size_t)args[1].as.number : 0;
+  size_t cols = argc > 1 ? (size_t)args[argc - 1].as.number : 0;
+  return loader_raw(args[0].as.string, rows, cols, error);
+}
+
+// Function registry, indexed by function_id_t
+#define N ARG_NUMBER
+#define A ARG_ARRAY
+#define M ARG_MATRIX
+#define S ARG_STRING
+#define V ARG_ANY
+#define MANY ARGS_UNBOUNDED
+
+static const function_info_t registry[FUNC_COUNT] = {
+    [FUNC_GCD] = {"gcd", fn_gcd, 2, 2, 0, {N}, 1, "gcd requires 2 arguments"},
+    [FUNC_LCM] = {"lcm", fn_lcm, 2, 2, 0, {N}, 1, "lcm requires 2 arguments"},
+    [FUNC_MOD] = {"mod", fn_mod, 2, 2, 0, {N}, 1, "mod requires 2 arguments"},
+    [FUNC_MODPOW] = {"modpow", fn_modpow, 3, 3, 0, {N}, 1,
+                     "modpow requires 3 arguments"},
+    [FUNC_IS_PRIME] = {"is_prime", fn_is_prime, 1, 1, 0, {N}, 1,
+                       "is_prime requires 1 argument"},
+    [FUNC_NCR] = {"ncr", fn_ncr, 2, 2, 0, {N}, 1, "nCr requires 2 arguments"},
+    [FUNC_NPR] = {"npr", fn_npr, 2, 2, 0, {N}, 1, "nPr requires 2 arguments"},
+    [FUNC_FACT] = {"fact", fn_fact, 1, 1, 0, {N}, 1,
+                   "factorial requires 1 argument"},
+    [FUNC_MEAN] = {"mean", fn_mean, 1, MANY, 0, {V}, 1,
+                   "Stats functions require at least 1 argument"},
+    [FUNC_MEDIAN] = {"median", fn_median, 1, MANY, 0, {V}, 1,
+                     "Stats functions require at least 1 argument"},
+    [FUNC_MODE] = {"mode", fn_mode, 1, MANY, 0, {V}, 1,
+                   "Stats functions require at least 1 argument"},
+    [FUNC_VAR] = {"var", fn_var, 1, MANY, 0, {V}, 1,
+                  "Stats functions require at least 1 argument"},
+    [FUNC_STDDEV] = {"stddev", fn_stddev, 1, MANY, 0, {V}, 1,
+                     "Stats functions require at least 1 argument"},
+    [FUNC_ZSCORE] = {"zscore", fn_zscore, 2, MANY, 0, {N, V}, 2,
+                     "zscore requires value and dataset"},
+    [FUNC_CORRELATION] = {"correlation", fn_correlation, 2, MANY, 1, {N}, 1,
+                          "correlation requires even number of arguments"},
+    [FUNC_BINOMIAL] = {"binomial", fn_binomial, 3, 3, 0, {N}, 1,
+                       "binomial requires 3 arguments (n, p, k)"},
+    [FUNC_GEOMETRIC] = {"geometric", fn_geometric, 2, 2, 0, {N}, 1,
+                        "geometric requires 2 arguments (p, k)"},
+    [FUNC_VECTOR] = {"vector", fn_vector, 1, MANY, 0, {V}, 1,
+                     "vector requires elements"},
+    [FUNC_MATRIX] = {"matrix", fn_matrix, 3, MANY, 0, {N, N, V}, 3,
+                     "matrix requires rows, cols and elements"},
+    [FUNC_VEC_ADD] = {"vec_add", fn_vec_add, 1, MANY, 0, {V}, 1,
+                      "Requires even number of elements"},
+    [FUNC_VEC_SUB] = {"vec_sub", fn_vec_sub, 1, MANY, 0, {V}, 1,
+                      "Requires even number of elements"},
+    [FUNC_VEC_SCALE] = {"vec_scale", fn_vec_scale, 2, MANY, 0, {N, V}, 2,
+                        "vec_scale requires scalar and vector"},
+    [FUNC_VEC_DOT] = {"vec_dot", fn_vec_dot, 1, MANY, 0, {V}, 1,
+                      "Requires even number of elements"},
+    [FUNC_VEC_MAG] = {"vec_mag", fn_vec_mag, 1, MANY, 0, {V}, 1,
+                      "vec_mag requires elements"},
+    [FUNC_MAT_ADD] = {"mat_add", fn_mat_add, 2, 2, 0, {M}, 1,
+                      "Matrix binary ops require 2 matrix/vector arguments"},
+    [FUNC_MAT_SUB] = {"mat_sub", fn_mat_sub, 2, 2, 0, {M}, 1,
+                      "Matrix binary ops require 2 matrix/vector arguments"},
+    [FUNC_MAT_MUL] = {"mat_mul", fn_mat_mul, 2, 2, 0, {M}, 1,
+                      "Matrix binary ops require 2 matrix/vector arguments"},
+    [FUNC_MAT_VEC_MUL] = {"mat_vec_mul", fn_mat_vec_mul, 2, 2, 0, {M, A}, 2,
+                          "Matrix binary ops require 2 matrix/vector "
+                          "arguments"},
+    [FUNC_MAT_DET] = {"mat_det", fn_mat_det, 1, 1, 0, {M}, 1,
+                      "Requires matrix arguments"},
+    [FUNC_MAT_TRANSPOSE] = {"mat_transpose", fn_mat_transpose, 1, 1, 0, {M}, 1,
+                            "Requires matrix arguments"},
+    [FUNC_NEG] = {"neg", fn_neg, 1, 1, 0, {V}, 1, "neg requires 1 argument"},
+    [FUNC_BNOT] = {"bnot", fn_bnot, 1, 1, 0, {N}, 1,
+                   "bnot requires 1 argument"},
+    [FUNC_NOT] = {"not", fn_not, 1, 1, 0, {N}, 1, "not requires 1 argument"},
+    [FUNC_AND] = {"and", fn_and, 1, MANY, 0, {V}, 1,
+                  "Logic ops require 2+ arguments"},
+    [FUNC_OR] = {"or", fn_or, 1, MANY, 0, {V}, 1,
+                 "Logic ops require 2+ arguments"},
+    [FUNC_XOR] = {"xor", fn_xor, 1, MANY, 0, {V}, 1,
+                  "Logic ops require 2+ arguments"},
+    [FUNC_IF] = {"if", fn_if, 3, 3, 0, {N, V}, 2, "if requires 3 arguments"},
+    [FUNC_SET_UNION] = {"set_union", fn_set_union, 1, MANY, 0, {V}, 1,
+                        "Set ops require even number of elements"},
+    [FUNC_SET_INTERSECT] = {"set_intersect", fn_set_intersect, 1, MANY, 0, {V},
+                            1, "Set ops require even number of elements"},
+    [FUNC_SET_DIFF] = {"set_diff", fn_set_diff, 1, MANY, 0, {V}, 1,
+                       "Set ops require even number of elements"},
+    [FUNC_LOAD] = {"load", fn_load, 1, 1, 0, {S}, 1,
+                   "load requires a file name"},
+    [FUNC_LOAD_RAW] = {"load_raw", fn_load_raw, 1, 3, 0, {S, N}, 2,
+                       "load_raw requires a file name and up to 2 "
+                       "dimensions"},
+};
+
+#undef N
+#undef A
+#undef M
+#undef S
+#undef V
+#undef MANY
+
+// Alternative spellings accepted by the parser
+static const struct {
+  const char *name;
+  function_id_t id;
+} aliases[] = {
+    {"nCr", FUNC_NCR},
+    {"nPr", FUNC_NPR},
+    {"factorial", FUNC_FACT},
+};
+
+// Compare a registry name against a token span (not NUL-terminated)
+static int name_equals(const char *name, const char *text, size_t length) {
+  return strncmp(name, text, length) == 0 && name[length] == '\0';
+}
+
+function_id_t function_lookup(const char *name, size_t length) {
+  for (int i = 0; i < FUNC_COUNT; i++) {
+    if (name_equals(registry[i].name, name, length))
+      return (function_id_t)i;
+  }
+  for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+    if (name_equals(aliases[i].name, name, length))
+      return aliases[i].id;
+  }
+  return FUNC_INVALID;
+}
+
+const function_info_t *function_info(function_id_t id) {
+  if (id < 0 || id >= FUNC_COUNT)
+    return NULL;
+  return &registry[id];
+}
+
+int function_is_pure(function_id_t id) {
+  return id != FUNC_LOAD && id != FUNC_LOAD_RAW;
+}
+
+int function_check_arity(function_id_t id, size_t argc, error_t *error) {
+  const function_info_t *info = function_info(id);
+  if (!info) {
+    *error = error_create(ERR_UNSUPPORTED, "Unknown function");
+    return -1;
+  }
+  if (argc < info->min_args || argc > info->max_args ||
+      (info->even_args && argc % 2 != 0)) {
+    *error = error_create(ERR_INVALID_ARGS, info->arity_message);
+    return -1;
+  }
+  return 0;
+}
+
+static const char *arg_type_name(unsigned char types) {
+  switch (types) {
+  case ARG_NUMBER:
+    return "a number";
+  case ARG_ARRAY:
+    return "a vector";
+  case ARG_MATRIX:
+    return "a matrix. Use matrix(r, c, ...) function";
+  case ARG_STRING:
+    return "a quoted file name";
+  default:
+    return "a value";
+  }
+}
+
+value_t function_call(function_id_t id, const value_t *args, size_t argc,
+                      error_t *error) {
+  const function_info_t *info = function_info(id);
+  if (!info) {
+    *error = error_create(ERR_UNSUPPORTED, "Unknown function");
+    return value_number(0);
+  }
+
+  for (size_t i = 0; i < argc; i++) {
+    size_t slot = i < info->signature_length ? i : info->signature_length - 1;
+    unsigned char expected = info->arg_types[slot];
+    if (!(expected & (1u << args[i].type))) {
+      char message[128];
+      snprintf(message, sizeof(message), "%s: argument %zu must be %s",
+               info->name, i + 1, arg_type_name(expected));
+      *error = error_create(ERR_INVALID_ARGS, message);
+      return value_number(0);
+    }
+  }
+
+  error_clear(error);
+  return info->impl(args, argc, error);
+}
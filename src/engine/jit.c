@@ -0,0 +1,516 @@
+#define _DEFAULT_SOURCE
+#include "engine/jit.h"
+#include "engine/functions.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <math.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Generated code has the signature below (System V ABI). The VM stack is
+// kept in registers: depth d lives in xmm<d>, so at most JIT_REGISTERS
+// values may be live; xmm14 and xmm15 are scratch. rbx holds the variable
+// array and rbp the status pointer, both callee-saved across calls to fmod.
+typedef double (*jit_fn_t)(const value_t *values, int *status);
+
+#define JIT_REGISTERS 14
+#define XMM_SCRATCH 14
+#define XMM_ZERO 15
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSP 4
+
+// Status codes written by the error stubs
+enum {
+  JIT_OK,
+  JIT_DIV_ZERO,
+  JIT_NOT_FINITE,
+  JIT_BAD_SHIFT,
+  JIT_MOD_ZERO,
+  JIT_STATUS_COUNT
+};
+
+// Worst-case bytes emitted per instruction, for sizing the buffer
+#define JIT_MAX_INSTRUCTION 256
+#define JIT_MAX_PROLOGUE 256
+
+typedef struct {
+  unsigned char *code;
+  size_t size;
+  size_t stubs[JIT_STATUS_COUNT]; // Offset of each error stub
+  size_t epilogue;
+  int32_t frame;           // Bytes reserved below the saved registers
+  size_t spill;            // Frame offset of the first local
+} assembler_t;
+
+static void byte(assembler_t *as, unsigned value) {
+  as->code[as->size++] = (unsigned char)value;
+}
+
+static void imm32(assembler_t *as, uint32_t value) {
+  for (int i = 0; i < 4; i++)
+    byte(as, (value >> (8 * i)) & 0xFF);
+}
+
+static void imm64(assembler_t *as, uint64_t value) {
+  imm32(as, (uint32_t)value);
+  imm32(as, (uint32_t)(value >> 32));
+}
+
+// Optional REX prefix for an instruction with reg/rm register fields
+static void rex(assembler_t *as, int wide, int reg, int rm) {
+  unsigned prefix =
+      0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+  if (prefix != 0x40)
+    byte(as, prefix);
+}
+
+// SSE register-register op: [prefix] [REX] 0F op modrm
+static void sse(assembler_t *as, unsigned prefix, int wide, unsigned op,
+                int reg, int rm) {
+  if (prefix)
+    byte(as, prefix);
+  rex(as, wide, reg, rm);
+  byte(as, 0x0F);
+  byte(as, op);
+  byte(as, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// movsd xmm, [base + disp] (load) or movsd [base + disp], xmm (store)
+static void movsd_mem(assembler_t *as, int store, int xmm, int base,
+                      int32_t disp) {
+  byte(as, 0xF2);
+  rex(as, 0, xmm, base);
+  byte(as, 0x0F);
+  byte(as, store ? 0x11 : 0x10);
+  byte(as, 0x80 | ((xmm & 7) << 3) | base);
+  if (base == RSP)
+    byte(as, 0x24);
+  imm32(as, (uint32_t)disp);
+}
+
+static void movapd(assembler_t *as, int dst, int src) {
+  if (dst != src)
+    sse(as, 0x66, 0, 0x28, dst, src);
+}
+
+static void cvttsd2si(assembler_t *as, int gpr, int xmm) {
+  sse(as, 0xF2, 1, 0x2C, gpr, xmm);
+}
+
+static void cvtsi2sd(assembler_t *as, int xmm, int gpr) {
+  sse(as, 0xF2, 1, 0x2A, xmm, gpr);
+}
+
+static void zero_scratch(assembler_t *as) {
+  sse(as, 0x66, 0, 0x57, XMM_ZERO, XMM_ZERO); // xorpd
+}
+
+// Conditional jump (0F cc) to an error stub, which precedes the body
+static void jcc_stub(assembler_t *as, unsigned cc, int status) {
+  byte(as, 0x0F);
+  byte(as, cc);
+  imm32(as, (uint32_t)(int32_t)(as->stubs[status] - (as->size + 4)));
+}
+
+// Short forward jump whose target is patched by land()
+static size_t jump8(assembler_t *as, unsigned op) {
+  byte(as, op);
+  byte(as, 0);
+  return as->size - 1;
+}
+
+static void land(assembler_t *as, size_t at) {
+  as->code[at] = (unsigned char)(as->size - (at + 1));
+}
+
+// Fail with JIT_NOT_FINITE unless xmm holds a finite number: shifting
+// out the sign leaves the exponent on top, all ones for inf and NaN
+static void check_finite(assembler_t *as, int xmm) {
+  sse(as, 0x66, 1, 0x7E, xmm, RAX); // movq rax, xmm
+  byte(as, 0x48), byte(as, 0xD1), byte(as, 0xE0); // shl rax, 1
+  byte(as, 0x48), byte(as, 0xB9); // mov rcx, imm64
+  imm64(as, 0xFFE0000000000000ULL);
+  byte(as, 0x48), byte(as, 0x39), byte(as, 0xC8); // cmp rax, rcx
+  jcc_stub(as, 0x83, JIT_NOT_FINITE);             // jae
+}
+
+// a = fmod(a, b) through a call; live registers below a are spilled to
+// the frame because every xmm register is caller-saved
+static void call_fmod(assembler_t *as, int a) {
+  double (*target)(double, double) = fmod;
+  uint64_t address;
+  memcpy(&address, &target, sizeof(address));
+
+  for (int i = 0; i < a; i++)
+    movsd_mem(as, 1, i, RSP, 8 * i);
+  movapd(as, 0, a);
+  movapd(as, 1, a + 1);
+  byte(as, 0x48), byte(as, 0xB8); // mov rax, imm64
+  imm64(as, address);
+  byte(as, 0xFF), byte(as, 0xD0); // call rax
+  movapd(as, a, 0);
+  for (int i = 0; i < a; i++)
+    movsd_mem(as, 0, i, RSP, 8 * i);
+}
+
+// a = (long long)a <op> (long long)b for the bitwise operators and shifts
+static void emit_integer(assembler_t *as, uint32_t opcode, int a) {
+  cvttsd2si(as, RAX, a);
+  cvttsd2si(as, RCX, a + 1);
+  byte(as, 0x48);
+  switch (opcode) {
+  case OP_AND:
+    byte(as, 0x21), byte(as, 0xC8);
+    break;
+  case OP_OR:
+    byte(as, 0x09), byte(as, 0xC8);
+    break;
+  case OP_XOR:
+    byte(as, 0x31), byte(as, 0xC8);
+    break;
+  default:
+    // Shift counts outside 0..63 (negative ones included) are errors
+    byte(as, 0x83), byte(as, 0xF9), byte(as, 63); // cmp rcx, 63
+    jcc_stub(as, 0x87, JIT_BAD_SHIFT);              // ja
+    byte(as, 0x48), byte(as, 0xD3);
+    byte(as, opcode == OP_SHL ? 0xE0 : 0xF8); // shl/sar rax, cl
+    break;
+  }
+  cvtsi2sd(as, a, RAX);
+}
+
+static void emit_binary(assembler_t *as, uint32_t opcode, int a) {
+  int b = a + 1;
+  switch (opcode) {
+  case OP_ADD:
+    sse(as, 0xF2, 0, 0x58, a, b);
+    break;
+  case OP_SUB:
+    sse(as, 0xF2, 0, 0x5C, a, b);
+    break;
+  case OP_MUL:
+    sse(as, 0xF2, 0, 0x59, a, b);
+    break;
+  case OP_DIV: {
+    // b == 0 fails; an unordered compare (NaN) is not zero
+    zero_scratch(as);
+    sse(as, 0x66, 0, 0x2E, b, XMM_ZERO); // ucomisd
+    size_t skip = jump8(as, 0x7A);       // jp
+    jcc_stub(as, 0x84, JIT_DIV_ZERO);    // je
+    land(as, skip);
+    sse(as, 0xF2, 0, 0x5E, a, b);
+    break;
+  }
+  case OP_MOD:
+    call_fmod(as, a);
+    break;
+  default:
+    emit_integer(as, opcode, a);
+    return;
+  }
+  check_finite(as, a);
+}
+
+// mod(a, b) on integers, with a non-negative result as discrete_mod
+static void emit_mod(assembler_t *as, int a) {
+  cvttsd2si(as, RAX, a);
+  cvttsd2si(as, RCX, a + 1);
+  byte(as, 0x48), byte(as, 0x85), byte(as, 0xC9); // test rcx, rcx
+  jcc_stub(as, 0x84, JIT_MOD_ZERO);               // je
+
+  // x % -1 is 0; idiv would trap on LLONG_MIN / -1
+  byte(as, 0x48), byte(as, 0x83), byte(as, 0xF9), byte(as, 0xFF);
+  size_t divide = jump8(as, 0x75);    // jne
+  byte(as, 0x31), byte(as, 0xD2);     // xor edx, edx
+  size_t divided = jump8(as, 0xEB);   // jmp
+  land(as, divide);
+  byte(as, 0x48), byte(as, 0x99);     // cqo
+  byte(as, 0x48), byte(as, 0xF7), byte(as, 0xF9); // idiv rcx
+  land(as, divided);
+
+  // A negative remainder gets llabs(b) added
+  byte(as, 0x48), byte(as, 0x85), byte(as, 0xD2); // test rdx, rdx
+  size_t positive = jump8(as, 0x79);              // jns
+  byte(as, 0x48), byte(as, 0x89), byte(as, 0xC8); // mov rax, rcx
+  byte(as, 0x48), byte(as, 0xF7), byte(as, 0xD8); // neg rax
+  byte(as, 0x48), byte(as, 0x0F), byte(as, 0x48), byte(as, 0xC1); // cmovs
+  byte(as, 0x48), byte(as, 0x01), byte(as, 0xC2); // add rdx, rax
+  land(as, positive);
+  cvtsi2sd(as, a, RDX);
+}
+
+static int emit_call(assembler_t *as, const instruction_t *ins, int top) {
+  switch ((function_id_t)ins->operand) {
+  case FUNC_NEG:
+    if (ins->argc != 1)
+      return -1;
+    sse(as, 0x66, 1, 0x7E, top, RAX); // movq rax, xmm
+    byte(as, 0x48), byte(as, 0x0F), byte(as, 0xBA), byte(as, 0xF8);
+    byte(as, 63);                     // btc rax, 63
+    sse(as, 0x66, 1, 0x6E, top, RAX); // movq xmm, rax
+    return 0;
+  case FUNC_BNOT:
+    if (ins->argc != 1)
+      return -1;
+    cvttsd2si(as, RAX, top);
+    byte(as, 0x48), byte(as, 0xF7), byte(as, 0xD0); // not rax
+    cvtsi2sd(as, top, RAX);
+    return 0;
+  case FUNC_NOT:
+    if (ins->argc != 1)
+      return -1;
+    zero_scratch(as);
+    sse(as, 0x66, 0, 0x2E, top, XMM_ZERO);         // ucomisd
+    byte(as, 0x0F), byte(as, 0x94), byte(as, 0xC0); // sete al
+    byte(as, 0x0F), byte(as, 0x9B), byte(as, 0xC1); // setnp cl
+    byte(as, 0x20), byte(as, 0xC8);                 // and al, cl
+    byte(as, 0x0F), byte(as, 0xB6), byte(as, 0xC0); // movzx eax, al
+    cvtsi2sd(as, top, RAX);
+    return 0;
+  case FUNC_MOD:
+    if (ins->argc != 2)
+      return -1;
+    emit_mod(as, top - 1);
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+static void emit_prologue(assembler_t *as) {
+  // Epilogue and error stubs come first so that every jump to them is a
+  // backward jump with a known displacement
+  as->epilogue = as->size;
+  byte(as, 0x48), byte(as, 0x81), byte(as, 0xC4); // add rsp, frame
+  imm32(as, (uint32_t)as->frame);
+  byte(as, 0x5D); // pop rbp
+  byte(as, 0x5B); // pop rbx
+  byte(as, 0xC3); // ret
+
+  size_t fail = as->size;
+  sse(as, 0x66, 0, 0x57, 0, 0); // xorpd xmm0, xmm0
+  byte(as, 0xEB);
+  byte(as, (unsigned)(as->epilogue - (as->size + 1)) & 0xFF);
+
+  for (int status = JIT_DIV_ZERO; status < JIT_STATUS_COUNT; status++) {
+    as->stubs[status] = as->size;
+    byte(as, 0xC7), byte(as, 0x45), byte(as, 0x00); // mov [rbp], status
+    imm32(as, (uint32_t)status);
+    byte(as, 0xEB);
+    byte(as, (unsigned)(fail - (as->size + 1)) & 0xFF);
+  }
+}
+
+static size_t emit_entry(assembler_t *as) {
+  size_t entry = as->size;
+  byte(as, 0x53); // push rbx
+  byte(as, 0x55); // push rbp
+  byte(as, 0x48), byte(as, 0x81), byte(as, 0xEC); // sub rsp, frame
+  imm32(as, (uint32_t)as->frame);
+  byte(as, 0x48), byte(as, 0x89), byte(as, 0xFB); // mov rbx, rdi
+  byte(as, 0x48), byte(as, 0x89), byte(as, 0xF5); // mov rbp, rsi
+  return entry;
+}
+
+static void emit_exit(assembler_t *as) {
+  byte(as, 0xC7), byte(as, 0x45), byte(as, 0x00); // mov [rbp], JIT_OK
+  imm32(as, JIT_OK);
+  byte(as, 0xE9); // jmp epilogue
+  imm32(as, (uint32_t)(int32_t)(as->epilogue - (as->size + 4)));
+}
+
+static int emit_program(assembler_t *as, const bytecode_t *prog) {
+  const int32_t value_offset = (int32_t)offsetof(value_t, as.number);
+  int depth = 0;
+
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    const instruction_t *ins = &prog->code[pc];
+    int32_t local = (int32_t)(as->spill + 8 * (size_t)ins->operand);
+
+    switch (ins->opcode) {
+    case OP_PUSH: {
+      uint64_t bits;
+      memcpy(&bits, &prog->constants[ins->operand], sizeof(bits));
+      byte(as, 0x48), byte(as, 0xB8); // mov rax, imm64
+      imm64(as, bits);
+      sse(as, 0x66, 1, 0x6E, depth++, RAX); // movq xmm, rax
+      break;
+    }
+    case OP_LOAD_VAR:
+      movsd_mem(as, 0, depth++, RBX,
+                (int32_t)(ins->operand * sizeof(value_t)) + value_offset);
+      break;
+    case OP_LOAD_LOCAL:
+      movsd_mem(as, 0, depth++, RSP, local);
+      break;
+    case OP_STORE_LOCAL:
+      movsd_mem(as, 1, depth - 1, RSP, local);
+      break;
+    case OP_CALL:
+      if (emit_call(as, ins, depth - 1) != 0)
+        return -1;
+      depth = depth - (int)ins->argc + 1;
+      break;
+    default:
+      if (ins->opcode > OP_SHR)
+        return -1;
+      depth--;
+      emit_binary(as, ins->opcode, depth - 1);
+      break;
+    }
+  }
+  return 0;
+}
+
+// Collect the distinct variable slots, checked before every run
+static int collect_slots(jit_code_t *code, const bytecode_t *prog) {
+  code->slots = safe_malloc((prog->code_size + 1) * sizeof(uint32_t));
+  if (!code->slots)
+    return -1;
+
+  for (size_t pc = 0; pc < prog->code_size; pc++) {
+    if (prog->code[pc].opcode != OP_LOAD_VAR)
+      continue;
+    uint32_t slot = prog->code[pc].operand;
+    size_t i = 0;
+    while (i < code->slot_count && code->slots[i] != slot)
+      i++;
+    if (i == code->slot_count)
+      code->slots[code->slot_count++] = slot;
+  }
+  return 0;
+}
+
+jit_code_t *jit_compile(const bytecode_t *prog, error_t *error) {
+  if (!prog || prog->stack_size > JIT_REGISTERS) {
+    *error = error_create(ERR_UNSUPPORTED, "Program not supported by JIT");
+    return NULL;
+  }
+
+  size_t capacity =
+      JIT_MAX_PROLOGUE + prog->code_size * JIT_MAX_INSTRUCTION;
+  assembler_t as = {0};
+  as.code = safe_malloc(capacity);
+  if (!as.code) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate JIT buffer");
+    return NULL;
+  }
+
+  // Spill area for the register stack, then locals; rsp is 16-byte
+  // aligned at calls once two registers are pushed and frame is 8 mod 16
+  size_t frame = 8 * (prog->stack_size + prog->local_count);
+  as.frame = (int32_t)(frame + ((frame % 16 == 8) ? 0 : 8));
+  as.spill = 8 * prog->stack_size;
+
+  emit_prologue(&as);
+  size_t entry = emit_entry(&as);
+  if (emit_program(&as, prog) != 0) {
+    safe_free(as.code);
+    *error = error_create(ERR_UNSUPPORTED, "Program not supported by JIT");
+    return NULL;
+  }
+  emit_exit(&as);
+
+  jit_code_t *code = safe_calloc(1, sizeof(jit_code_t));
+  long page = sysconf(_SC_PAGESIZE);
+  size_t size = (as.size + (size_t)page - 1) / (size_t)page * (size_t)page;
+  void *memory = MAP_FAILED;
+  if (code && collect_slots(code, prog) == 0)
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    safe_free(as.code);
+    jit_free(code);
+    *error = error_create(ERR_MEMORY, "Failed to map JIT code");
+    return NULL;
+  }
+
+  // Write, then flip to executable: the mapping is never both
+  memcpy(memory, as.code, as.size);
+  safe_free(as.code);
+  code->memory = memory;
+  code->size = size;
+  code->entry = entry;
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    jit_free(code);
+    *error = error_create(ERR_MEMORY, "Failed to map JIT code");
+    return NULL;
+  }
+
+  error_clear(error);
+  return code;
+}
+
+int jit_exec(const jit_code_t *code, const symbol_table_t *symbols,
+             double *result, error_t *error) {
+  for (size_t i = 0; i < code->slot_count; i++) {
+    const value_t *var = symbol_get(symbols, code->slots[i]);
+    if (!var || var->type != VALUE_NUMBER)
+      return -1;
+  }
+
+  jit_fn_t fn;
+  void *entry = (unsigned char *)code->memory + code->entry;
+  memcpy(&fn, &entry, sizeof(fn));
+
+  int status = JIT_OK;
+  *result = fn(symbols ? symbols->values : NULL, &status);
+
+  switch (status) {
+  case JIT_DIV_ZERO:
+    *error = error_create(ERR_DIV_ZERO, "Division by zero");
+    break;
+  case JIT_NOT_FINITE:
+    *error = error_create(ERR_DOMAIN, "Result is not a finite number");
+    break;
+  case JIT_BAD_SHIFT:
+    *error = error_create(ERR_INVALID_ARGS, "Invalid shift count");
+    break;
+  case JIT_MOD_ZERO:
+    *error = error_create(ERR_DIV_ZERO, "Modulo by zero");
+    break;
+  default:
+    error_clear(error);
+    break;
+  }
+  return 0;
+}
+
+void jit_free(jit_code_t *code) {
+  if (!code)
+    return;
+  if (code->memory)
+    munmap(code->memory, code->size);
+  safe_free(code->slots);
+  free(code);
+}
+
+#else
+
+jit_code_t *jit_compile(const bytecode_t *prog, error_t *error) {
+  (void)prog;
+  *error = error_create(ERR_UNSUPPORTED, "JIT requires x86-64");
+  return NULL;
+}
+
+int jit_exec(const jit_code_t *code, const symbol_table_t *symbols,
+             double *result, error_t *error) {
+  (void)code;
+  (void)symbols;
+  (void)result;
+  (void)error;
+  return -1;
+}
+
+void jit_free(jit_code_t *code) {
+  free(code);
+}
+
+#endif
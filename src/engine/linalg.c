@@ -22,7 +22,7 @@ value_t linalg_vec_add(const value_t *a, const value_t *b, error_t *error) {
   }
 
   size_t size = a->as.array.size;
-  double *result_data = safe_malloc(size * sizeof(double));
+  double *result_data = value_alloc(size);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result vector");
     return value_number(0);
@@ -32,7 +32,7 @@ value_t linalg_vec_add(const value_t *a, const value_t *b, error_t *error) {
     result_data[i] = a->as.array.data[i] + b->as.array.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_array(result_data, size);
 }
 
@@ -55,7 +55,7 @@ value_t linalg_vec_sub(const value_t *a, const value_t *b, error_t *error) {
   }
 
   size_t size = a->as.array.size;
-  double *result_data = safe_malloc(size * sizeof(double));
+  double *result_data = value_alloc(size);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result vector");
     return value_number(0);
@@ -65,7 +65,7 @@ value_t linalg_vec_sub(const value_t *a, const value_t *b, error_t *error) {
     result_data[i] = a->as.array.data[i] - b->as.array.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_array(result_data, size);
 }
 
@@ -82,7 +82,7 @@ value_t linalg_vec_scale(const value_t *v, double scalar, error_t *error) {
   }
 
   size_t size = v->as.array.size;
-  double *result_data = safe_malloc(size * sizeof(double));
+  double *result_data = value_alloc(size);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result vector");
     return value_number(0);
@@ -92,7 +92,7 @@ value_t linalg_vec_scale(const value_t *v, double scalar, error_t *error) {
     result_data[i] = v->as.array.data[i] * scalar;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_array(result_data, size);
 }
 
@@ -119,7 +119,7 @@ double linalg_vec_dot(const value_t *a, const value_t *b, error_t *error) {
     result += a->as.array.data[i] * b->as.array.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -140,7 +140,7 @@ double linalg_vec_magnitude(const value_t *v, error_t *error) {
     sum_sq += v->as.array.data[i] * v->as.array.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return sqrt(sum_sq);
 }
 
@@ -167,7 +167,7 @@ value_t linalg_mat_add(const value_t *a, const value_t *b, error_t *error) {
   size_t cols = a->as.matrix.cols;
   size_t total = rows * cols;
 
-  double *result_data = safe_malloc(total * sizeof(double));
+  double *result_data = value_alloc(total);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result matrix");
     return value_number(0);
@@ -177,7 +177,7 @@ value_t linalg_mat_add(const value_t *a, const value_t *b, error_t *error) {
     result_data[i] = a->as.matrix.data[i] + b->as.matrix.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_matrix(result_data, rows, cols);
 }
 
@@ -204,7 +204,7 @@ value_t linalg_mat_sub(const value_t *a, const value_t *b, error_t *error) {
   size_t cols = a->as.matrix.cols;
   size_t total = rows * cols;
 
-  double *result_data = safe_malloc(total * sizeof(double));
+  double *result_data = value_alloc(total);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result matrix");
     return value_number(0);
@@ -214,7 +214,7 @@ value_t linalg_mat_sub(const value_t *a, const value_t *b, error_t *error) {
     result_data[i] = a->as.matrix.data[i] - b->as.matrix.data[i];
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_matrix(result_data, rows, cols);
 }
 
@@ -234,7 +234,7 @@ value_t linalg_mat_scale(const value_t *m, double scalar, error_t *error) {
   size_t cols = m->as.matrix.cols;
   size_t total = rows * cols;
 
-  double *result_data = safe_malloc(total * sizeof(double));
+  double *result_data = value_alloc(total);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result matrix");
     return value_number(0);
@@ -244,7 +244,7 @@ value_t linalg_mat_scale(const value_t *m, double scalar, error_t *error) {
     result_data[i] = m->as.matrix.data[i] * scalar;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_matrix(result_data, rows, cols);
 }
 
@@ -271,7 +271,7 @@ value_t linalg_mat_mul(const value_t *a, const value_t *b, error_t *error) {
   size_t n = a->as.matrix.cols;
   size_t p = b->as.matrix.cols;
 
-  double *result_data = safe_malloc(m * p * sizeof(double));
+  double *result_data = value_alloc(m * p);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result matrix");
     return value_number(0);
@@ -288,7 +288,7 @@ value_t linalg_mat_mul(const value_t *a, const value_t *b, error_t *error) {
     }
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_matrix(result_data, m, p);
 }
 
@@ -315,7 +315,7 @@ value_t linalg_mat_vec_mul(const value_t *m, const value_t *v, error_t *error) {
   size_t rows = m->as.matrix.rows;
   size_t cols = m->as.matrix.cols;
 
-  double *result_data = safe_malloc(rows * sizeof(double));
+  double *result_data = value_alloc(rows);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result vector");
     return value_number(0);
@@ -329,7 +329,7 @@ value_t linalg_mat_vec_mul(const value_t *m, const value_t *v, error_t *error) {
     result_data[i] = sum;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_array(result_data, rows);
 }
 
@@ -356,11 +356,11 @@ double linalg_mat_det(const value_t *m, error_t *error) {
 
   if (n == 2) {
     // det([[a, b], [c, d]]) = ad - bc
-    *error = error_ok();
+    error_clear(error);
     return d[0] * d[3] - d[1] * d[2];
   } else if (n == 3) {
     // det([[a,b,c],[d,e,f],[g,h,i]]) = aei + bfg + cdh - ceg - bdi - afh
-    *error = error_ok();
+    error_clear(error);
     return d[0] * d[4] * d[8] + d[1] * d[5] * d[6] + d[2] * d[3] * d[7] -
            d[2] * d[4] * d[6] - d[1] * d[3] * d[8] - d[0] * d[5] * d[7];
   } else {
@@ -385,7 +385,7 @@ value_t linalg_mat_transpose(const value_t *m, error_t *error) {
   size_t rows = m->as.matrix.rows;
   size_t cols = m->as.matrix.cols;
 
-  double *result_data = safe_malloc(rows * cols * sizeof(double));
+  double *result_data = value_alloc(rows * cols);
   if (!result_data) {
     *error = error_create(ERR_MEMORY, "Failed to allocate result matrix");
     return value_number(0);
@@ -398,6 +398,6 @@ value_t linalg_mat_transpose(const value_t *m, error_t *error) {
     }
   }
 
-  *error = error_ok();
+  error_clear(error);
   return value_matrix(result_data, cols, rows); // Note: dimensions swapped
 }
@@ -0,0 +1,194 @@
+#define _DEFAULT_SOURCE
+#include "engine/loader.h"
+#include "common/memory.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Longest .npy header accepted; NumPy writes a few hundred bytes at most
+#define NPY_HEADER_MAX 65536
+
+static value_t load_fail(error_t *error, error_code_t code,
+                         const char *path, const char *problem) {
+  char message[256];
+  snprintf(message, sizeof(message), "load: %.150s: %s", path, problem);
+  *error = error_create(code, message);
+  return value_number(0);
+}
+
+static int open_file(const char *path, size_t *size, error_t *error) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    load_fail(error, ERR_IO, path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    load_fail(error, ERR_IO, path, "not a regular file");
+    close(fd);
+    return -1;
+  }
+  *size = (size_t)st.st_size;
+  return fd;
+}
+
+// Map rows x cols doubles (rows == 0: an array of cols) at offset, once
+// the file is known to hold them
+static value_t map_doubles(int fd, const char *path, size_t size,
+                           size_t offset, size_t rows, size_t cols,
+                           error_t *error) {
+  size_t count = rows ? rows * cols : cols;
+  if (count == 0)
+    return load_fail(error, ERR_INVALID_ARGS, path, "no data");
+  if ((rows && count / rows != cols) || offset > size ||
+      count > (size - offset) / sizeof(double))
+    return load_fail(error, ERR_IO, path, "file is too short");
+
+  double *data = value_map(fd, offset, count);
+  if (!data && errno == EINVAL) {
+    // Data too misaligned to map in place: read it instead
+    data = value_alloc(count);
+    if (!data)
+      return load_fail(error, ERR_MEMORY, path, "out of memory");
+    size_t done = 0, total = count * sizeof(double);
+    while (done < total) {
+      ssize_t got = pread(fd, (char *)data + done, total - done,
+                          (off_t)(offset + done));
+      if (got <= 0) {
+        value_data_release(data);
+        return load_fail(error, ERR_IO, path,
+                         got < 0 ? strerror(errno) : "file is too short");
+      }
+      done += (size_t)got;
+    }
+  }
+  if (!data)
+    return load_fail(error, ERR_IO, path, strerror(errno));
+  error_clear(error);
+  return rows ? value_matrix(data, rows, cols) : value_array(data, count);
+}
+
+value_t loader_raw(const char *path, size_t rows, size_t cols,
+                   error_t *error) {
+  size_t size;
+  int fd = open_file(path, &size, error);
+  if (fd < 0)
+    return value_number(0);
+  if (rows == 0 && cols == 0)
+    cols = size / sizeof(double);
+  value_t result = map_doubles(fd, path, size, 0, rows, cols, error);
+  close(fd);
+  return result;
+}
+
+// Value of key in a .npy header dictionary, e.g. "'<f8'" for 'descr'
+static const char *npy_field(const char *header, const char *key) {
+  const char *p = strstr(header, key);
+  if (!p)
+    return NULL;
+  p += strlen(key);
+  while (*p == ' ' || *p == ':')
+    p++;
+  return p;
+}
+
+// Dimensions from "(3,)" or "(2, 3)"; returns how many, or -1
+static int npy_shape(const char *p, size_t dims[2]) {
+  if (!p || *p++ != '(')
+    return -1;
+  int count = 0;
+  for (;;) {
+    while (*p == ' ' || *p == ',')
+      p++;
+    if (*p == ')')
+      return count;
+    if (*p < '0' || *p > '9' || count == 2)
+      return -1;
+    char *end;
+    errno = 0;
+    unsigned long long dim = strtoull(p, &end, 10);
+    if (errno != 0 || dim > SIZE_MAX)
+      return -1;
+    dims[count++] = (size_t)dim;
+    p = end;
+  }
+}
+
+// Version 1 headers have a 2-byte length, versions 2 and 3 a 4-byte one
+static char *npy_header(int fd, size_t *offset) {
+  unsigned char preamble[12];
+  if (pread(fd, preamble, sizeof(preamble), 0) != (ssize_t)sizeof(preamble) ||
+      memcmp(preamble, "\x93NUMPY", 6) != 0)
+    return NULL;
+
+  size_t length;
+  if (preamble[6] == 1) {
+    length = preamble[8] | (size_t)preamble[9] << 8;
+    *offset = 10;
+  } else if (preamble[6] == 2 || preamble[6] == 3) {
+    length = preamble[8] | (size_t)preamble[9] << 8 |
+             (size_t)preamble[10] << 16 | (size_t)preamble[11] << 24;
+    *offset = 12;
+  } else {
+    return NULL;
+  }
+  if (length > NPY_HEADER_MAX)
+    return NULL;
+
+  char *header = safe_malloc(length + 1);
+  if (!header)
+    return NULL;
+  if (pread(fd, header, length, (off_t)*offset) != (ssize_t)length) {
+    safe_free(header);
+    return NULL;
+  }
+  header[length] = '\0';
+  *offset += length;
+  return header;
+}
+
+value_t loader_npy(const char *path, error_t *error) {
+  size_t size;
+  int fd = open_file(path, &size, error);
+  if (fd < 0)
+    return value_number(0);
+
+  size_t offset;
+  char *header = npy_header(fd, &offset);
+  if (!header) {
+    close(fd);
+    return load_fail(error, ERR_IO, path, "not a .npy file");
+  }
+
+  const char *descr = npy_field(header, "'descr'");
+  const char *order = npy_field(header, "'fortran_order'");
+  size_t dims[2];
+  int ndim = npy_shape(npy_field(header, "'shape'"), dims);
+  const char *problem = NULL;
+  if (!descr || strncmp(descr, "'<f8'", 5) != 0)
+    problem = "only little-endian float64 data is supported";
+  else if (ndim < 1)
+    problem = "only 1-D and 2-D arrays are supported";
+  else if (ndim == 2 && dims[0] == 0)
+    problem = "no data";
+  else if (ndim == 2 && (!order || strncmp(order, "False", 5) != 0))
+    problem = "Fortran-order arrays are not supported";
+  safe_free(header);
+
+  value_t result;
+  if (problem)
+    result = load_fail(error, ERR_INVALID_ARGS, path, problem);
+  else if (ndim == 1)
+    result = map_doubles(fd, path, size, offset, 0, dims[0], error);
+  else
+    result = map_doubles(fd, path, size, offset, dims[0], dims[1], error);
+  close(fd);
+  return result;
+}
@@ -0,0 +1,351 @@
+#include "engine/optimizer.h"
+#include "engine/functions.h"
+#include <string.h>
+#include <stdint.h>
+
+// Value of a node known at compile time: numbers always, and array or
+// matrix results of constant calls so that e.g. mat_det(matrix(...)) folds
+typedef struct {
+  int known;
+  value_t value;
+} fold_slot_t;
+
+static int is_literal(const ast_node_t *node) {
+  return node->type == NODE_ARRAY || node->type == NODE_MATRIX;
+}
+
+static int is_number(const ast_t *ast, ast_index_t index, double value) {
+  const ast_node_t *node = &ast->nodes[index];
+  return node->type == NODE_NUMBER && ast->constants[node->first] == value;
+}
+
+// Exact identities only: x + 0 is left alone because it turns -0 into +0.
+// They hold element-wise too, so x may be an array or matrix.
+static ast_index_t simplify(const ast_t *ast, const ast_node_t *node,
+                            ast_index_t self) {
+  ast_index_t left = ast->edges[node->first];
+  ast_index_t right = ast->edges[node->first + 1];
+
+  switch ((binary_op_t)node->opcode) {
+  case BINOP_MUL:
+    if (is_number(ast, right, 1))
+      return left;
+    if (is_number(ast, left, 1))
+      return right;
+    break;
+  case BINOP_DIV:
+    if (is_number(ast, right, 1))
+      return left;
+    break;
+  case BINOP_SUB:
+    if (is_number(ast, right, 0))
+      return left;
+    break;
+  default:
+    break;
+  }
+  return self;
+}
+
+// Evaluate a node whose children all have known values
+static int fold_node(const ast_t *ast, const ast_node_t *node,
+                     fold_slot_t *slots, value_t *args, value_t *result) {
+  error_t error;
+
+  for (size_t i = 0; i < node->child_count; i++)
+    args[i] = slots[ast->edges[node->first + i]].value;
+
+  if (node->type == NODE_OPERATOR) {
+    // Views, so that the slots keep their buffers
+    value_t left = value_borrow(&args[0]);
+    value_t right = value_borrow(&args[1]);
+    *result = value_binary_op((binary_op_t)node->opcode, &left, &right,
+                              &error);
+  } else {
+    // Only pure built-ins get here: the same arguments give the same result
+    *result = function_call((function_id_t)node->opcode, args,
+                            node->child_count, &error);
+  }
+  return error_is_ok(error);
+}
+
+// if() with a known condition becomes the branch it takes, and and()/or()
+// whose first argument already decides them become that number; the
+// arguments skipped this way are never evaluated, even if they would fail
+static ast_index_t settle(ast_t *ast, ast_node_t *node, fold_slot_t *slots,
+                          ast_index_t self) {
+  if (node->child_count == 0)
+    return self;
+  ast_index_t first = ast->edges[node->first];
+  if (!slots[first].known)
+    return self;
+
+  if (node->opcode == FUNC_IF) {
+    const value_t *cond = &slots[first].value;
+    if (cond->type != VALUE_NUMBER)
+      return self;
+    return ast->edges[node->first + (cond->as.number != 0.0 ? 1 : 2)];
+  }
+
+  double decided;
+  if (function_short_circuit((function_id_t)node->opcode,
+                             &slots[first].value, &decided)) {
+    node->type = NODE_NUMBER;
+    node->first = (uint32_t)ast->constant_count;
+    node->child_count = 0;
+    ast->constants[ast->constant_count++] = decided;
+    slots[self].known = 1;
+    slots[self].value = value_number(decided);
+  }
+  return self;
+}
+
+// Drop nodes no longer reachable from the root and renumber the pool
+static int compact(ast_t *ast, arena_t *arena) {
+  size_t count = ast->node_count;
+  unsigned char *live = arena_calloc(arena, count, 1);
+  ast_index_t *renumber = arena_alloc(arena, count * sizeof(ast_index_t));
+  if (!live || !renumber)
+    return -1;
+
+  // Parents follow their children, so one backward sweep marks everything
+  live[ast->root] = 1;
+  for (size_t i = count; i-- > 0;) {
+    if (!live[i] || ast->nodes[i].type == NODE_NUMBER)
+      continue;
+    for (size_t c = 0; c < ast->nodes[i].child_count; c++)
+      live[ast->edges[ast->nodes[i].first + c]] = 1;
+  }
+
+  size_t nodes = 0, edges = 0, constants = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!live[i])
+      continue;
+    ast_node_t node = ast->nodes[i];
+    if (node.type == NODE_NUMBER) {
+      ast->constants[constants] = ast->constants[node.first];
+      node.first = (uint32_t)constants++;
+    } else if (node.type == NODE_STRING) {
+      // Strings stay where they are
+    } else if (is_literal(&node)) {
+      // Live constants only ever move down
+      size_t length = ast_literal_length(&ast->constants[node.first]);
+      memmove(&ast->constants[constants], &ast->constants[node.first],
+              length * sizeof(double));
+      node.first = (uint32_t)constants;
+      constants += length;
+    } else {
+      for (size_t c = 0; c < node.child_count; c++)
+        ast->edges[edges + c] = renumber[ast->edges[node.first + c]];
+      node.first = (uint32_t)edges;
+      edges += node.child_count;
+    }
+    renumber[i] = (ast_index_t)nodes;
+    ast->nodes[nodes++] = node;
+  }
+
+  ast->root = renumber[ast->root];
+  ast->node_count = nodes;
+  ast->edge_count = edges;
+  ast->constant_count = constants;
+  return 0;
+}
+
+int ast_fold(ast_t *ast, arena_t *arena, error_t *error) {
+  size_t count = ast->node_count;
+  fold_slot_t *slots = arena_calloc(arena, count, sizeof(fold_slot_t));
+  ast_index_t *forward = arena_alloc(arena, count * sizeof(ast_index_t));
+  // Folded literals need a constant slot of their own; a tree never has
+  // more of them than nodes
+  size_t capacity = ast->constant_count + count;
+  double *constants = arena_alloc(arena, capacity * sizeof(double));
+  value_t *args = arena_alloc(arena, count * sizeof(value_t));
+  if (!slots || !forward || !constants || !args) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate optimizer state");
+    return -1;
+  }
+  memcpy(constants, ast->constants, ast->constant_count * sizeof(double));
+  ast->constants = constants;
+
+  for (size_t i = 0; i < count; i++) {
+    ast_node_t *node = &ast->nodes[i];
+    forward[i] = (ast_index_t)i;
+
+    if (node->type == NODE_NUMBER) {
+      slots[i].known = 1;
+      slots[i].value = value_number(ast->constants[node->first]);
+      continue;
+    }
+    if (is_literal(node)) {
+      error_t error;
+      slots[i].value =
+          ast_literal_value(&ast->constants[node->first], &error);
+      slots[i].known = error_is_ok(error);
+      continue;
+    }
+    if (node->type == NODE_VARIABLE || node->type == NODE_STRING)
+      continue;
+
+    // Children may have been replaced by a simpler equivalent
+    int all_known = 1;
+    for (size_t c = 0; c < node->child_count; c++) {
+      ast_index_t *edge = &ast->edges[node->first + c];
+      *edge = forward[*edge];
+      all_known &= slots[*edge].known;
+    }
+    if (node->type == NODE_ASSIGN)
+      continue;
+
+    value_t result;
+    if (all_known &&
+        (node->type != NODE_FUNCTION ||
+         function_is_pure((function_id_t)node->opcode)) &&
+        fold_node(ast, node, slots, args, &result)) {
+      if (result.type == VALUE_NUMBER) {
+        node->type = NODE_NUMBER;
+        node->first = (uint32_t)ast->constant_count;
+        node->child_count = 0;
+        ast->constants[ast->constant_count++] = result.as.number;
+      }
+      slots[i].known = 1;
+      slots[i].value = result;
+      continue;
+    }
+
+    if (node->type == NODE_OPERATOR)
+      forward[i] = simplify(ast, node, (ast_index_t)i);
+    else
+      forward[i] = settle(ast, node, slots, (ast_index_t)i);
+  }
+  ast->root = forward[ast->root];
+
+  // Array and matrix intermediates were only needed while folding
+  for (size_t i = 0; i < count; i++) {
+    if (slots[i].known)
+      value_free(&slots[i].value);
+  }
+
+  if (compact(ast, arena) != 0) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate optimizer state");
+    return -1;
+  }
+  return 0;
+}
+
+// Structural hash of a node whose children are already canonical
+static uint64_t node_hash(const ast_t *ast, const ast_node_t *node) {
+  uint64_t hash = 14695981039346656037ULL;
+  uint64_t words[3] = {node->type, (uint64_t)(uint16_t)node->opcode,
+                       node->child_count};
+
+  if (node->type == NODE_NUMBER) {
+    // Bit pattern, so that 0 and -0 stay distinct
+    memcpy(&words[2], &ast->constants[node->first], sizeof(double));
+  } else if (is_literal(node)) {
+    // Length and first element; node_equal compares the rest
+    const double *literal = &ast->constants[node->first];
+    words[1] = ast_literal_length(literal);
+    memcpy(&words[2], &literal[2], sizeof(double));
+  } else if (node->type == NODE_STRING) {
+    for (const char *c = ast->strings + node->first; *c; c++) {
+      hash ^= (unsigned char)*c;
+      hash *= 1099511628211ULL;
+    }
+  }
+  for (size_t i = 0; i < 3; i++) {
+    hash ^= words[i];
+    hash *= 1099511628211ULL;
+  }
+  for (size_t c = 0; c < node->child_count; c++) {
+    hash ^= ast->edges[node->first + c];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static int node_equal(const ast_t *ast, const ast_node_t *a,
+                      const ast_node_t *b) {
+  if (a->type != b->type || a->opcode != b->opcode ||
+      a->child_count != b->child_count)
+    return 0;
+  if (a->type == NODE_NUMBER)
+    return memcmp(&ast->constants[a->first], &ast->constants[b->first],
+                  sizeof(double)) == 0;
+  if (is_literal(a)) {
+    const double *x = &ast->constants[a->first];
+    const double *y = &ast->constants[b->first];
+    size_t length = ast_literal_length(x);
+    return length == ast_literal_length(y) &&
+           memcmp(x, y, length * sizeof(double)) == 0;
+  }
+  if (a->type == NODE_STRING)
+    return strcmp(ast->strings + a->first, ast->strings + b->first) == 0;
+  return memcmp(&ast->edges[a->first], &ast->edges[b->first],
+                a->child_count * sizeof(ast_index_t)) == 0;
+}
+
+int ast_share(ast_t *ast, arena_t *arena, error_t *error) {
+  size_t count = ast->node_count;
+  size_t table_size = 16;
+  while (table_size < count * 2)
+    table_size *= 2;
+
+  // Open addressing over node indices; AST_NONE marks an empty slot
+  ast_index_t *table = arena_alloc(arena, table_size * sizeof(ast_index_t));
+  ast_index_t *forward = arena_alloc(arena, count * sizeof(ast_index_t));
+  unsigned char *uses = arena_calloc(arena, count, 1);
+  if (!table || !forward || !uses) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate optimizer state");
+    return -1;
+  }
+  memset(table, 0xFF, table_size * sizeof(ast_index_t));
+
+  // Children precede parents, so by the time a node is hashed its
+  // children already point at their canonical copies
+  for (size_t i = 0; i < count; i++) {
+    ast_node_t *node = &ast->nodes[i];
+    for (size_t c = 0; c < node->child_count; c++) {
+      ast_index_t *edge = &ast->edges[node->first + c];
+      *edge = forward[*edge];
+    }
+
+    // A file is read again on every call, so loads are never merged (nor,
+    // through their distinct children, is anything above them)
+    if (node->type == NODE_FUNCTION &&
+        !function_is_pure((function_id_t)node->opcode)) {
+      forward[i] = (ast_index_t)i;
+      continue;
+    }
+
+    size_t slot = node_hash(ast, node) & (table_size - 1);
+    while (table[slot] != AST_NONE &&
+           !node_equal(ast, &ast->nodes[table[slot]], node))
+      slot = (slot + 1) & (table_size - 1);
+
+    if (table[slot] == AST_NONE)
+      table[slot] = (ast_index_t)i;
+    forward[i] = table[slot];
+  }
+  ast->root = forward[ast->root];
+
+  if (compact(ast, arena) != 0) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate optimizer state");
+    return -1;
+  }
+
+  // Count parents; numbers, variable loads and file names are cheaper to
+  // repeat than to share
+  for (size_t i = 0; i < ast->node_count; i++) {
+    const ast_node_t *node = &ast->nodes[i];
+    for (size_t c = 0; c < node->child_count; c++) {
+      ast_index_t child = ast->edges[node->first + c];
+      if (uses[child] < 2)
+        uses[child]++;
+    }
+  }
+  for (size_t i = 0; i < ast->node_count; i++)
+    ast->nodes[i].shared = uses[i] > 1 && ast->nodes[i].type != NODE_NUMBER &&
+                           ast->nodes[i].type != NODE_VARIABLE &&
+                           ast->nodes[i].type != NODE_STRING;
+  return 0;
+}
@@ -1,18 +1,207 @@
+#define _DEFAULT_SOURCE
 #include "engine/parser.h"
+#include "engine/functions.h"
+#include "engine/symbols.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Reference count stored just ahead of array and matrix data; 16 bytes,
+// so the doubles that follow stay aligned for SSE2
+typedef struct {
+  _Alignas(16) atomic_size_t refs;
+  size_t capacity; // Doubles that fit after the header; 0 for a mapping
+} value_header_t;
+
+// A value_map() buffer: the header sits just ahead of the file's doubles,
+// with the extent of the whole mapping in front of it
+typedef struct {
+  void *base;
+  size_t length;
+  value_header_t header;
+} value_mapping_t;
+
+// Buffers of up to VALUE_SMALL doubles (short vectors, 3x3 and 4x4
+// matrices) all have that capacity. Released ones are kept on a per-thread
+// free list, VALUE_SMALL_CACHED at most, and handed out again without
+// touching the heap. A buffer goes to the list of the thread releasing it,
+// wherever it was allocated, so a thread that frees the results of
+// workers can fill its list from them, but never past the cap. A thread's
+// list is freed when the thread exits, and by value_cache_drain(), which
+// engine_context_free() calls: the main thread's list would otherwise
+// outlive every context, since returning from main() runs no
+// thread-exit destructors.
+#define VALUE_SMALL 16
+#define VALUE_SMALL_CACHED 64
+
+static _Thread_local value_header_t *small_free;
+static _Thread_local size_t small_cached;
+static _Thread_local int small_registered;
+static pthread_once_t small_once = PTHREAD_ONCE_INIT;
+static pthread_key_t small_key;
+static atomic_size_t heap_allocations;
+
+static value_header_t **next_free(value_header_t *header) {
+  return (value_header_t **)(void *)(header + 1);
+}
+
+void value_cache_drain(void) {
+  while (small_free) {
+    value_header_t *next = *next_free(small_free);
+    safe_free(small_free);
+    small_free = next;
+  }
+  small_cached = 0;
+}
+
+static void small_drain(void *unused) {
+  (void)unused;
+  value_cache_drain();
+}
+
+static void small_make_key(void) {
+  pthread_key_create(&small_key, small_drain);
+}
+
+// The key's destructor only runs for threads that set it
+static int small_register(void) {
+  if (!small_registered) {
+    pthread_once(&small_once, small_make_key);
+    small_registered = pthread_setspecific(small_key, &small_registered) == 0;
+  }
+  return small_registered;
+}
+
+static value_header_t *header_of(const double *data) {
+  return (value_header_t *)(void *)data - 1;
+}
+
+double *value_alloc(size_t count) {
+  value_header_t *header;
+  if (count <= VALUE_SMALL && small_free) {
+    header = small_free;
+    small_free = *next_free(header);
+    small_cached--;
+  } else {
+    size_t capacity = count < VALUE_SMALL ? VALUE_SMALL : count;
+    if (capacity > (SIZE_MAX - sizeof(value_header_t)) / sizeof(double))
+      return NULL;
+    header = safe_malloc(sizeof(value_header_t) + capacity * sizeof(double));
+    if (!header)
+      return NULL;
+    header->capacity = capacity;
+    atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+  }
+  atomic_store_explicit(&header->refs, 1, memory_order_relaxed);
+  return (double *)(void *)(header + 1);
+}
+
+double *value_data_retain(const double *data) {
+  if (data)
+    atomic_fetch_add_explicit(&header_of(data)->refs, 1, memory_order_relaxed);
+  return (double *)data;
+}
+
+void value_data_release(double *data) {
+  if (!data)
+    return;
+  value_header_t *header = header_of(data);
+  if (atomic_fetch_sub_explicit(&header->refs, 1, memory_order_acq_rel) != 1)
+    return;
+  if (header->capacity == 0) {
+    value_mapping_t *mapping =
+        (value_mapping_t *)(void *)((char *)header -
+                                    offsetof(value_mapping_t, header));
+    munmap(mapping->base, mapping->length);
+    return;
+  }
+  if (header->capacity == VALUE_SMALL && small_cached < VALUE_SMALL_CACHED &&
+      small_register()) {
+    *next_free(header) = small_free;
+    small_free = header;
+    small_cached++;
+    return;
+  }
+  safe_free(header);
+}
+
+size_t value_heap_allocations(void) {
+  return atomic_load_explicit(&heap_allocations, memory_order_relaxed);
+}
+
+double *value_map(int fd, size_t offset, size_t count) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t skip = offset % page;
+  if (skip % 16 != 0 || (skip > 0 && skip < sizeof(value_mapping_t))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (count > (SIZE_MAX - 2 * page - skip) / sizeof(double)) {
+    errno = EFBIG;
+    return NULL;
+  }
+  size_t span = (skip + count * sizeof(double) + page - 1) / page * page;
+
+  // One spare page in front holds the header when the doubles start on a
+  // page boundary; otherwise it goes in the file's first page, made
+  // writable (and so private to this mapping) for the reference count
+  char *base = mmap(NULL, page + span, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+  if (mmap(base + page, span, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+           (off_t)(offset - skip)) == MAP_FAILED ||
+      (skip > 0 && mprotect(base + page, page, PROT_READ | PROT_WRITE) != 0)) {
+    int saved = errno;
+    munmap(base, page + span);
+    errno = saved;
+    return NULL;
+  }
+
+  double *data = (double *)(void *)(base + page + skip);
+  value_mapping_t *mapping = (value_mapping_t *)(void *)data - 1;
+  mapping->base = base;
+  mapping->length = page + span;
+  mapping->header.capacity = 0;
+  atomic_store_explicit(&mapping->header.refs, 1, memory_order_relaxed);
+  return data;
+}
+
+int value_unique(const value_t *val) {
+  if (val->type == VALUE_NUMBER || val->borrowed || !val->as.array.data)
+    return 0;
+  const value_header_t *header = header_of(val->as.array.data);
+  return header->capacity != 0 &&
+         atomic_load_explicit(&header->refs, memory_order_acquire) == 1;
+}
 
 // Value constructors
 value_t value_number(double num) {
   value_t val;
+  val.borrowed = 0;
   val.type = VALUE_NUMBER;
   val.as.number = num;
   return val;
 }
 
+value_t value_string(const char *text) {
+  value_t val;
+  val.borrowed = 1;
+  val.type = VALUE_STRING;
+  val.as.string = text;
+  return val;
+}
+
 value_t value_array(double *data, size_t size) {
   value_t val;
+  val.borrowed = 0;
   val.type = VALUE_ARRAY;
   val.as.array.data = data;
   val.as.array.size = size;
@@ -21,6 +210,7 @@ value_t value_array(double *data, size_t size) {
 
 value_t value_matrix(double *data, size_t rows, size_t cols) {
   value_t val;
+  val.borrowed = 0;
   val.type = VALUE_MATRIX;
   val.as.matrix.data = data;
   val.as.matrix.rows = rows;
@@ -32,484 +222,721 @@ void value_free(value_t *val) {
   if (!val)
     return;
 
-  if (val->type == VALUE_ARRAY && val->as.array.data) {
-    safe_free(val->as.array.data);
+  if (val->borrowed) {
+    val->borrowed = 0;
+    if (val->type != VALUE_NUMBER)
+      val->as.array.data = NULL;
+    return;
+  }
+
+  if (val->type == VALUE_ARRAY || val->type == VALUE_MATRIX) {
+    value_data_release(val->as.array.data);
     val->as.array.data = NULL;
-  } else if (val->type == VALUE_MATRIX && val->as.matrix.data) {
-    safe_free(val->as.matrix.data);
-    val->as.matrix.data = NULL;
   }
 }
 
+value_t value_borrow(const value_t *val) {
+  value_t view = *val;
+  view.borrowed = 1;
+  return view;
+}
+
 value_t value_clone(const value_t *val) {
-  if (!val) {
+  if (!val)
     return value_number(0);
-  }
 
-  if (val->type == VALUE_NUMBER) {
-    return value_number(val->as.number);
-  } else if (val->type == VALUE_ARRAY) {
-    size_t size = val->as.array.size;
-    double *data = safe_malloc(size * sizeof(double));
-    if (data) {
-      memcpy(data, val->as.array.data, size * sizeof(double));
-    }
-    return value_array(data, size);
-  } else if (val->type == VALUE_MATRIX) {
-    size_t total = val->as.matrix.rows * val->as.matrix.cols;
-    double *data = safe_malloc(total * sizeof(double));
-    if (data) {
-      memcpy(data, val->as.matrix.data, total * sizeof(double));
-    }
-    return value_matrix(data, val->as.matrix.rows, val->as.matrix.cols);
-  }
+  // A file name stays a view of its owner's text
+  if (val->type == VALUE_STRING)
+    return value_string(val->as.string);
 
-  return value_number(0);
+  value_t copy = *val;
+  copy.borrowed = 0;
+  if (copy.type != VALUE_NUMBER)
+    value_data_retain(copy.as.array.data);
+  return copy;
 }
 
-// AST node functions
-static ast_node_t *ast_node_create(node_type_t type) {
-  ast_node_t *node = safe_calloc(1, sizeof(ast_node_t));
-  if (node) {
-    node->type = type;
-    node->children = NULL;
-    node->child_count = 0;
-  }
-  return node;
+size_t ast_literal_length(const double *literal) {
+  size_t rows = (size_t)literal[0];
+  return 2 + (rows ? rows : 1) * (size_t)literal[1];
 }
 
-/* Unused for now - will be needed for function calls with arguments
-static int ast_node_add_child(ast_node_t *parent, ast_node_t *child) {
-    if (!parent || !child) return -1;
-
-    ast_node_t **new_children = safe_realloc(parent->children,
-                                              (parent->child_count + 1) *
-sizeof(ast_node_t *)); if (!new_children) return -1;
-
-    parent->children = new_children;
-    parent->children[parent->child_count] = child;
-    parent->child_count++;
+value_t ast_literal_value(const double *literal, error_t *error) {
+  size_t rows = (size_t)literal[0];
+  size_t cols = (size_t)literal[1];
+  size_t count = (rows ? rows : 1) * cols;
+  double *data = value_alloc(count);
+  if (!data) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate literal");
+    return value_number(0);
+  }
+  memcpy(data, literal + 2, count * sizeof(double));
+  error_clear(error);
+  return rows ? value_matrix(data, rows, cols) : value_array(data, count);
+}
 
-    return 0;
+// Operator, call or bracket still waiting for operands
+typedef enum {
+  PENDING_BINARY, // opcode is a binary_op_t
+  PENDING_UNARY,  // opcode is FUNC_NEG or FUNC_BNOT
+  PENDING_GROUP,  // '('
+  PENDING_CALL,   // opcode is a function_id_t; argc arguments finished
+  PENDING_LIST    // '['; argc elements finished
+} pending_kind_t;
+
+typedef struct {
+  uint8_t kind;
+  uint8_t precedence;
+  int16_t opcode;
+  uint32_t position;
+  uint32_t argc;
+  uint32_t header;  // Lists: constant index reserved for rows and cols
+  uint32_t rows;    // Lists: elements that were themselves bare lists
+  uint32_t width;   // Lists: length of the first of those with a known one
+  uint32_t numbers; // Lists: elements that were plain numbers
+  uint8_t uneven;   // Lists: two rows of known length disagree
+} pending_t;
+
+// Operator precedence, indexed by binary_op_t
+static const uint8_t precedence[BINOP_INVALID + 1] = {
+    [BINOP_SHL] = 1, [BINOP_SHR] = 1, [BINOP_ADD] = 2, [BINOP_SUB] = 2,
+    [BINOP_MUL] = 3, [BINOP_DIV] = 3, [BINOP_MOD] = 3, [BINOP_AND] = 4,
+    [BINOP_XOR] = 5, [BINOP_OR] = 6,  [BINOP_INVALID] = 0,
+};
+
+// Prefix '-' and '~' bind tighter than every binary operator
+#define UNARY_PRECEDENCE 7
+
+// Nodes are appended to the pool as soon as their last operand is
+// complete, which is post-order; operands holds the roots of the finished
+// subtrees that no node has claimed yet
+typedef struct {
+  darray_t *nodes;
+  darray_t *edges;
+  darray_t *constants;
+  darray_t *strings;
+  darray_t *operands;
+  darray_t *pending;
+  uint32_t row; // Length of the list on top of operands, if it was just
+                // closed (ROW_UNSIZED when only known at run time); 0 once
+                // anything else is emitted
+  int nested;   // That list was itself a matrix literal
+} builder_t;
+
+#define ROW_UNSIZED UINT32_MAX
+
+// darray_append() that the compiler can inline: the parser appends once
+// or twice per token, and the call dominated the loop
+static inline int push(darray_t *arr, const void *elem) {
+  if (arr->size == arr->capacity &&
+      darray_reserve(arr, 2 * arr->capacity) != 0)
+    return -1;
+  memcpy((char *)arr->data + arr->size++ * arr->elem_size, elem,
+         arr->elem_size);
+  return 0;
 }
-*/
-void ast_free(ast_node_t *node) {
-  if (!node)
-    return;
 
-  for (size_t i = 0; i < node->child_count; i++) {
-    ast_free(node->children[i]);
+// Append a node whose children are the top child_count operands, and
+// leave it as an operand in their place
+static int emit(builder_t *b, ast_node_t node) {
+  ast_index_t index = (ast_index_t)b->nodes->size;
+  b->row = 0;
+  b->nested = 0;
+  if (node.child_count > 0) {
+    darray_t *edges = b->edges;
+    if (edges->size + node.child_count > edges->capacity &&
+        darray_reserve(edges, 2 * edges->capacity + node.child_count) != 0)
+      return -1;
+    ast_index_t *top = (ast_index_t *)b->operands->data +
+                       b->operands->size - node.child_count;
+    node.first = (uint32_t)edges->size;
+    memcpy((ast_index_t *)edges->data + edges->size, top,
+           node.child_count * sizeof(ast_index_t));
+    edges->size += node.child_count;
+    // The node takes its first child's operand slot
+    b->operands->size -= node.child_count - 1;
+    *top = index;
+    return push(b->nodes, &node);
   }
+  if (push(b->nodes, &node) != 0 ||
+      push(b->operands, &index) != 0)
+    return -1;
+  return 0;
+}
 
-  safe_free(node->children);
-  free(node);
+static pending_t *pending_top(builder_t *b) {
+  if (b->pending->size == 0)
+    return NULL;
+  return (pending_t *)b->pending->data + b->pending->size - 1;
 }
 
-// Operator precedence
-static int get_precedence(const char *op) {
-  if (strcmp(op, "<<") == 0 || strcmp(op, ">>") == 0)
-    return 1;
-  if (strcmp(op, "+") == 0 || strcmp(op, "-") == 0)
-    return 2;
-  if (strcmp(op, "*") == 0 || strcmp(op, "/") == 0 || strcmp(op, "%") == 0)
-    return 3;
-  if (strcmp(op, "&") == 0)
-    return 4;
-  if (strcmp(op, "^") == 0)
-    return 5;
-  if (strcmp(op, "|") == 0)
-    return 6;
+// Turn waiting operators into nodes while they bind at least as tightly
+// as min_precedence; stops at a parenthesis or call
+static int reduce(builder_t *b, int min_precedence) {
+  pending_t *top;
+  while ((top = pending_top(b)) &&
+         (top->kind == PENDING_BINARY || top->kind == PENDING_UNARY) &&
+         top->precedence >= min_precedence) {
+    // -2 is the literal -2, so that [-1, 2] stays a constant list
+    ast_node_t *last = (ast_node_t *)b->nodes->data + b->nodes->size - 1;
+    if (top->kind == PENDING_UNARY && top->opcode == FUNC_NEG &&
+        last->type == NODE_NUMBER &&
+        *((ast_index_t *)b->operands->data + b->operands->size - 1) ==
+            b->nodes->size - 1) {
+      double *value = (double *)b->constants->data + last->first;
+      *value = -*value;
+      b->pending->size--;
+      continue;
+    }
+    ast_node_t node = {0};
+    node.position = top->position;
+    node.opcode = top->opcode;
+    if (top->kind == PENDING_BINARY) {
+      node.type = NODE_OPERATOR;
+      node.child_count = 2;
+    } else {
+      node.type = NODE_FUNCTION;
+      node.child_count = 1;
+    }
+    b->pending->size--;
+    if (emit(b, node) != 0)
+      return -1;
+  }
   return 0;
 }
 
-static int is_right_associative(const char *op) {
-  (void)op; // All our operators are left-associative
+// Close a call on its ')' once its argc arguments are operands
+static int finish_call(builder_t *b, const pending_t *call, error_t *error) {
+  if (function_check_arity((function_id_t)call->opcode, call->argc, error) !=
+      0) {
+    error->has_position = 1;
+    error->position = call->position;
+    return -1;
+  }
+  ast_node_t node = {0};
+  node.type = NODE_FUNCTION;
+  node.opcode = call->opcode;
+  node.position = call->position;
+  node.child_count = call->argc;
+  b->pending->size--;
+  if (emit(b, node) != 0) {
+    *error = error_create(ERR_MEMORY, "Failed to create parser stacks");
+    return -1;
+  }
   return 0;
 }
 
-// Shunting-yard algorithm implementation with function call support
-ast_node_t *parse(const char *expression, error_t *error) {
-  if (!expression) {
-    if (error)
-      *error = error_create(ERR_PARSE, "Null expression");
-    return NULL;
+// Note an element of a list once it is complete. Only a bracketed list is
+// a row; anything else is a number or left for matrix() to check
+static void list_element(builder_t *b, pending_t *list) {
+  const ast_index_t top =
+      *((const ast_index_t *)b->operands->data + b->operands->size - 1);
+  if (b->nested) {
+    list->rows = list->argc + 2; // Never a valid row count: rejected later
+  } else if (b->row) {
+    if (b->row != ROW_UNSIZED) {
+      list->uneven |= list->width != 0 && list->width != b->row;
+      if (list->width == 0)
+        list->width = b->row;
+    }
+    list->rows++;
+  } else if (((const ast_node_t *)b->nodes->data)[top].type == NODE_NUMBER) {
+    list->numbers++;
   }
+  list->argc++;
+}
 
-  error_t tok_error;
-  darray_t *tokens = tokenize(expression, &tok_error);
-  if (!tokens) {
-    if (error)
-      *error = tok_error;
-    return NULL;
+// Whether the top count operands are the last count nodes, all of type
+// type: then they are leaves that nothing else refers to
+static int trailing(const builder_t *b, uint32_t count, node_type_t type) {
+  const ast_index_t *top =
+      (const ast_index_t *)b->operands->data + b->operands->size - count;
+  const ast_node_t *nodes = (const ast_node_t *)b->nodes->data;
+  for (uint32_t i = 0; i < count; i++) {
+    ast_index_t index = (ast_index_t)(b->nodes->size - count + i);
+    if (top[i] != index || nodes[index].type != type)
+      return 0;
   }
+  return 1;
+}
 
-  // Operator stack and output queue for shunting-yard
-  darray_t *operator_stack = darray_create(sizeof(token_t), 16);
-  darray_t *output_queue = darray_create(sizeof(ast_node_t *), 16);
-  darray_t *arg_count_stack =
-      darray_create(sizeof(int), 16); // Track argument counts
+// Replace the top count leaves with one literal over constants[header ..]
+static int emit_literal(builder_t *b, const pending_t *list, uint32_t count,
+                        node_type_t type) {
+  b->nodes->size -= count;
+  b->operands->size -= count;
+  ast_node_t node = {0};
+  node.type = type;
+  node.position = list->position;
+  node.first = list->header;
+  return emit(b, node);
+}
 
-  if (!operator_stack || !output_queue || !arg_count_stack) {
-    if (error)
-      *error = error_create(ERR_MEMORY, "Failed to create parser stacks");
-    darray_free(tokens);
-    darray_free(operator_stack);
-    darray_free(output_queue);
-    darray_free(arg_count_stack);
-    return NULL;
+// Close a list on its ']'. Numbers alone become one NODE_ARRAY, equal
+// rows of numbers one NODE_MATRIX, with the elements already in place in
+// constants; other elements are left to vector() or matrix() at run time.
+// A list with any bracketed row is a matrix, its other elements rows
+// whose length only matrix() can check.
+static int finish_list(builder_t *b, const pending_t *list, error_t *error) {
+  uint32_t n = list->argc;
+  double *constants = (double *)b->constants->data;
+  double *header = constants + list->header;
+  b->pending->size--;
+
+  if (list->rows > n) {
+    *error = error_create_at(ERR_PARSE, "Lists nest at most two deep",
+                             list->position);
+    return -1;
+  }
+  if (list->uneven) {
+    *error = error_create_at(ERR_PARSE, "Matrix rows must have equal length",
+                             list->position);
+    return -1;
+  }
+  if (list->rows > 0 && list->numbers > 0) {
+    *error = error_create_at(ERR_PARSE, "Matrix rows must all be lists",
+                             list->position);
+    return -1;
   }
 
-  // Process tokens
-  for (size_t i = 0; i < tokens->size; i++) {
-    token_t *tok = (token_t *)darray_get(tokens, i);
+  if (list->rows > 0) {
+    uint32_t cols = list->width;
+    if (trailing(b, n, NODE_ARRAY)) {
+      // Each row has its own header: close the gaps they leave
+      const ast_node_t *rows = (const ast_node_t *)b->nodes->data +
+                               b->nodes->size - n;
+      size_t end = list->header + 2;
+      for (uint32_t i = 0; i < n; i++) {
+        memmove(constants + end, constants + rows[i].first + 2,
+                cols * sizeof(double));
+        end += cols;
+      }
+      b->constants->size = end;
+      header[0] = n;
+      header[1] = cols;
+      if (emit_literal(b, list, n, NODE_MATRIX) != 0)
+        goto out_of_memory;
+      b->nested = 1;
+      return 0;
+    }
 
-    if (tok->type == TOKEN_NUMBER) {
-      ast_node_t *node = ast_node_create(NODE_NUMBER);
-      node->num_value = tok->num_value;
-      darray_append(output_queue, &node);
+    // matrix(rows, cols, row1, row2, ...): the dimensions go first, cols 0
+    // when no row has a known length
+    double dims[2] = {n, cols};
+    for (int i = 0; i < 2; i++) {
+      ast_node_t node = {0};
+      node.type = NODE_NUMBER;
+      node.position = list->position;
+      node.first = (uint32_t)b->constants->size;
+      if (push(b->constants, &dims[i]) != 0 || emit(b, node) != 0)
+        goto out_of_memory;
+    }
+    ast_index_t *top =
+        (ast_index_t *)b->operands->data + b->operands->size - n - 2;
+    ast_index_t rows = top[n], cols_node = top[n + 1];
+    memmove(top + 2, top, n * sizeof(ast_index_t));
+    top[0] = rows;
+    top[1] = cols_node;
+    ast_node_t node = {0};
+    node.type = NODE_FUNCTION;
+    node.opcode = FUNC_MATRIX;
+    node.position = list->position;
+    node.child_count = n + 2;
+    if (emit(b, node) != 0)
+      goto out_of_memory;
+    b->nested = 1;
+    return 0;
+  }
 
-    } else if (tok->type == TOKEN_FUNCTION) {
-      // Push function onto operator stack
-      darray_append(operator_stack, tok);
+  // Bare numbers were appended to constants right after the header
+  int in_place = trailing(b, n, NODE_NUMBER);
+  const ast_node_t *elements =
+      (const ast_node_t *)b->nodes->data + b->nodes->size - n;
+  for (uint32_t i = 0; in_place && i < n; i++)
+    in_place = elements[i].first == list->header + 2 + i;
+  if (in_place) {
+    header[0] = 0;
+    header[1] = n;
+    if (emit_literal(b, list, n, NODE_ARRAY) != 0)
+      goto out_of_memory;
+  } else {
+    ast_node_t node = {0};
+    node.type = NODE_FUNCTION;
+    node.opcode = FUNC_VECTOR;
+    node.position = list->position;
+    node.child_count = n;
+    if (emit(b, node) != 0)
+      goto out_of_memory;
+  }
+  // vector() flattens array elements, so its length is not n
+  b->row = in_place ? n : ROW_UNSIZED;
+  return 0;
 
-      // Check if next token is '('
-      if (i + 1 < tokens->size) {
-        token_t *next = (token_t *)darray_get(tokens, i + 1);
-        if (next->type == TOKEN_LPAREN) {
-          int arg_count = 0;
-          darray_append(arg_count_stack, &arg_count);
-        }
-      }
+out_of_memory:
+  *error = error_create(ERR_MEMORY, "Failed to create parser stacks");
+  return -1;
+}
 
-    } else if (tok->type == TOKEN_COMMA) {
-      // Comma separates function arguments
-      // Pop operators until we find '('
-      int found = 0;
-      while (operator_stack->size > 0) {
-        token_t *top =
-            (token_t *)darray_get(operator_stack, operator_stack->size - 1);
-
-        if (top->type == TOKEN_LPAREN) {
-          found = 1;
-          // Increment argument count
-          if (arg_count_stack->size > 0) {
-            int *count =
-                (int *)darray_get(arg_count_stack, arg_count_stack->size - 1);
-            (*count)++;
-          }
-          break;
-        }
+static ast_t *parse_fail(error_t *error, error_t err) {
+  if (error)
+    *error = err;
+  return NULL;
+}
 
-        operator_stack->size--;
+// The message is only formatted once a parser stack actually fails to grow
+static ast_t *parse_out_of_memory(error_t *error) {
+  return parse_fail(error,
+                    error_create(ERR_MEMORY, "Failed to create parser stacks"));
+}
 
-        if (top->type == TOKEN_OPERATOR) {
-          ast_node_t *node = ast_node_create(NODE_OPERATOR);
-          snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-          darray_append(output_queue, &node);
-        }
-      }
+static ast_t *parse_unexpected(error_t *error, const char *input,
+                               const token_t *token) {
+  char message[32];
+  snprintf(message, sizeof(message), "Unexpected '%.*s'",
+           (int)(token->length < 8 ? token->length : 8),
+           input + token->position);
+  return parse_fail(error, error_create_at(ERR_PARSE, message,
+                                           token->position));
+}
 
-      if (!found) {
-        if (error)
-          *error = error_create(ERR_PARSE, "Misplaced comma");
-        // Cleanup
-        darray_free(tokens);
-        darray_free(operator_stack);
-        darray_free(arg_count_stack);
-        for (size_t j = 0; j < output_queue->size; j++) {
-          ast_node_t **node_ptr = (ast_node_t **)darray_get(output_queue, j);
-          ast_free(*node_ptr);
-        }
-        darray_free(output_queue);
-        return NULL;
-      }
+// A name not followed by '(' is a variable
+static int parse_variable(builder_t *b, const char *input,
+                          const token_t *token, symbol_table_t *symbols,
+                          error_t *error) {
+  if (!symbols) {
+    parse_fail(error, error_create_at(ERR_UNSUPPORTED,
+                                      "Variables are not supported",
+                                      token->position));
+    return -1;
+  }
+  error_t sym_error;
+  int slot = symbol_resolve(symbols, input + token->position, token->length,
+                            &sym_error);
+  if (slot < 0) {
+    parse_fail(error, sym_error);
+    return -1;
+  }
 
-    } else if (tok->type == TOKEN_OPERATOR) {
-      while (operator_stack->size > 0) {
-        token_t *top =
-            (token_t *)darray_get(operator_stack, operator_stack->size - 1);
+  ast_node_t node = {0};
+  node.type = NODE_VARIABLE;
+  node.opcode = (int16_t)slot;
+  node.position = (uint32_t)token->position;
+  if (emit(b, node) != 0) {
+    parse_out_of_memory(error);
+    return -1;
+  }
+  return 0;
+}
 
-        if (top->type != TOKEN_OPERATOR)
-          break;
+// Precedence climbing in a single pass over the tokens, with an explicit
+// stack of waiting operators instead of recursion, so that nesting depth
+// costs heap rather than C stack (the engine enforces its own limit on the
+// finished tree). The parser alternates between expecting an operand and
+// expecting an operator; each node goes straight into the final post-order
+// pool, with its edges, as soon as its operands are complete.
+// Every buffer comes from the arena, so error paths simply return and
+// arena_reset() releases the whole tree.
+ast_t *parse(const char *expression, arena_t *arena,
+             symbol_table_t *symbols, error_t *error) {
+  if (!expression) {
+    return parse_fail(error, error_create(ERR_PARSE, "Null expression"));
+  }
+  if (!arena) {
+    return parse_fail(error, error_create(ERR_MEMORY, "No parser arena"));
+  }
 
-        int prec = get_precedence(tok->value);
-        int top_prec = get_precedence(top->value);
+  tokenizer_t tokenizer;
+  tokenizer_init(&tokenizer, expression);
+
+  // Rough guess of the node count (a short literal and an operator per
+  // few characters) so that long inputs rarely regrow the pool
+  size_t capacity = tokenizer.length / 4 + 16;
+  builder_t b;
+  b.nodes = darray_create_in(arena, sizeof(ast_node_t), capacity);
+  b.edges = darray_create_in(arena, sizeof(ast_index_t), capacity);
+  b.constants = darray_create_in(arena, sizeof(double), capacity);
+  b.strings = darray_create_in(arena, 1, 16);
+  b.operands = darray_create_in(arena, sizeof(ast_index_t), 16);
+  b.pending = darray_create_in(arena, sizeof(pending_t), 16);
+  if (!b.nodes || !b.edges || !b.constants || !b.strings || !b.operands || !b.pending) {
+    return parse_out_of_memory(error);
+  }
 
-        if ((top_prec > prec) ||
-            (top_prec == prec && !is_right_associative(tok->value))) {
-          operator_stack->size--;
+  // `name = expression` assigns; anything else is rescanned from the start
+  int assign_slot = -1;
+  uint32_t assign_position = 0;
+  token_t target, equals;
+  if (tokenizer_next(&tokenizer, &target) > 0 &&
+      target.type == TOKEN_FUNCTION &&
+      tokenizer_next(&tokenizer, &equals) > 0 &&
+      equals.type == TOKEN_ASSIGN) {
+    if (!symbols) {
+      return parse_fail(error, error_create_at(ERR_UNSUPPORTED,
+                                               "Variables are not supported",
+                                               target.position));
+    }
+    error_t sym_error;
+    assign_slot = symbol_resolve(symbols, expression + target.position,
+                                 target.length, &sym_error);
+    if (assign_slot < 0)
+      return parse_fail(error, sym_error);
+    assign_position = (uint32_t)target.position;
+  } else {
+    tokenizer_init(&tokenizer, expression);
+  }
 
-          ast_node_t *node = ast_node_create(NODE_OPERATOR);
-          snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-          darray_append(output_queue, &node);
-        } else {
-          break;
+  int expect_operand = 1;
+  for (;;) {
+    token_t token;
+    int status = tokenizer_next(&tokenizer, &token);
+    if (status < 0)
+      return parse_fail(error, tokenizer_get_error(&tokenizer));
+    if (status == 0) {
+      token.type = TOKEN_END;
+      token.position = tokenizer.position;
+      token.length = 0;
+    }
+    pending_t entry = {0};
+    entry.position = (uint32_t)token.position;
+
+    if (token.type == TOKEN_ASSIGN)
+      return parse_unexpected(error, expression, &token);
+
+    if (expect_operand) {
+      if (token.type == TOKEN_NUMBER) {
+        ast_node_t node = {0};
+        node.type = NODE_NUMBER;
+        node.position = (uint32_t)token.position;
+        node.first = (uint32_t)b.constants->size;
+        if (push(b.constants, &token.num_value) != 0 ||
+            emit(&b, node) != 0)
+          return parse_out_of_memory(error);
+        expect_operand = 0;
+
+      } else if (token.type == TOKEN_FUNCTION) {
+        token_t next;
+        if (tokenizer_peek(&tokenizer, &next) <= 0 ||
+            next.type != TOKEN_LPAREN) {
+          if (parse_variable(&b, expression, &token, symbols, error) != 0)
+            return NULL;
+          expect_operand = 0;
+          continue;
         }
-      }
-
-      darray_append(operator_stack, tok);
-
-    } else if (tok->type == TOKEN_LPAREN) {
-      darray_append(operator_stack, tok);
-
-    } else if (tok->type == TOKEN_RPAREN) {
-      // Pop until matching (
-      int found_lparen = 0;
-      while (operator_stack->size > 0) {
-        token_t *top =
-            (token_t *)darray_get(operator_stack, operator_stack->size - 1);
-        operator_stack->size--;
-
-        if (top->type == TOKEN_LPAREN) {
-          found_lparen = 1;
-
-          // Check if there's a function before the '('
-          if (operator_stack->size > 0) {
-            token_t *maybe_func =
-                (token_t *)darray_get(operator_stack, operator_stack->size - 1);
-            if (maybe_func->type == TOKEN_FUNCTION) {
-              operator_stack->size--;
-
-              ast_node_t *node = ast_node_create(NODE_FUNCTION);
-              snprintf(node->op, MAX_TOKEN_LENGTH, "%s", maybe_func->value);
-
-              // Get argument count
-              int arg_count = 1; // Default to 1 if we have any content
-              if (arg_count_stack->size > 0) {
-                int *count = (int *)darray_get(arg_count_stack,
-                                               arg_count_stack->size - 1);
-                arg_count = *count + 1; // +1 for the last argument
-                arg_count_stack->size--;
-              }
-
-              // Store arg count in a marker node (will be processed during AST
-              // building)
-              node->child_count = arg_count;
-
-              darray_append(output_queue, &node);
-            }
-          }
-          break;
+        entry.kind = PENDING_CALL;
+        entry.opcode = (int16_t)function_lookup(expression + token.position,
+                                                token.length);
+        if (entry.opcode == FUNC_INVALID) {
+          return parse_fail(error,
+                            error_create_at(ERR_UNSUPPORTED,
+                                            "Unknown function",
+                                            token.position));
         }
-
-        if (top->type == TOKEN_OPERATOR) {
-          ast_node_t *node = ast_node_create(NODE_OPERATOR);
-          snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-          darray_append(output_queue, &node);
-        } else if (top->type == TOKEN_FUNCTION) {
-          ast_node_t *node = ast_node_create(NODE_FUNCTION);
-          snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-          darray_append(output_queue, &node);
+        tokenizer_next(&tokenizer, &next); // The '('
+        if (push(b.pending, &entry) != 0)
+          return parse_out_of_memory(error);
+        // f() has no arguments rather than one missing one
+        if (tokenizer_peek(&tokenizer, &next) > 0 &&
+            next.type == TOKEN_RPAREN) {
+          tokenizer_next(&tokenizer, &next);
+          error_t call_error;
+          if (finish_call(&b, pending_top(&b), &call_error) != 0)
+            return parse_fail(error, call_error);
+          expect_operand = 0;
         }
-      }
 
-      if (!found_lparen) {
-        if (error)
-          *error = error_create(ERR_PARSE, "Mismatched parentheses");
-        darray_free(tokens);
-        darray_free(operator_stack);
-        darray_free(arg_count_stack);
-        for (size_t j = 0; j < output_queue->size; j++) {
-          ast_node_t **node_ptr = (ast_node_t **)darray_get(output_queue, j);
-          ast_free(*node_ptr);
+      } else if (token.type == TOKEN_LPAREN) {
+        entry.kind = PENDING_GROUP;
+        if (push(b.pending, &entry) != 0)
+          return parse_out_of_memory(error);
+
+      } else if (token.type == TOKEN_STRING) {
+        // Only as a file name; the loader gets it as a VALUE_STRING
+        pending_t *call = pending_top(&b);
+        if (!call || call->kind != PENDING_CALL || call->argc != 0 ||
+            (call->opcode != FUNC_LOAD && call->opcode != FUNC_LOAD_RAW)) {
+          return parse_fail(error,
+                            error_create_at(ERR_PARSE,
+                                            "Strings are only allowed as "
+                                            "file names",
+                                            token.position));
+        }
+        if (token.length == 2) {
+          return parse_fail(error, error_create_at(ERR_PARSE,
+                                                   "Empty file name",
+                                                   token.position));
         }
-        darray_free(output_queue);
-        return NULL;
+        ast_node_t node = {0};
+        node.type = NODE_STRING;
+        node.position = (uint32_t)token.position;
+        node.first = (uint32_t)b.strings->size;
+        size_t length = token.length - 2;
+        if (darray_reserve(b.strings, b.strings->size + length + 1) != 0)
+          return parse_out_of_memory(error);
+        char *text = (char *)b.strings->data + b.strings->size;
+        memcpy(text, expression + token.position + 1, length);
+        text[length] = '\0';
+        b.strings->size += length + 1;
+        if (emit(&b, node) != 0)
+          return parse_out_of_memory(error);
+        // The name is the whole argument: no operator may take it
+        token_t next;
+        if (tokenizer_peek(&tokenizer, &next) > 0 &&
+            next.type != TOKEN_COMMA && next.type != TOKEN_RPAREN)
+          return parse_unexpected(error, expression, &next);
+        expect_operand = 0;
+
+      } else if (token.type == TOKEN_LBRACKET) {
+        token_t next;
+        if (tokenizer_peek(&tokenizer, &next) > 0 &&
+            next.type == TOKEN_RBRACKET) {
+          return parse_fail(error, error_create_at(ERR_PARSE, "Empty list",
+                                                   token.position));
+        }
+        // Rows and cols go before the elements, which bare numbers then
+        // append in place
+        static const double dims[2] = {0, 0};
+        entry.kind = PENDING_LIST;
+        entry.header = (uint32_t)b.constants->size;
+        if (push(b.constants, &dims[0]) != 0 ||
+            push(b.constants, &dims[1]) != 0 ||
+            push(b.pending, &entry) != 0)
+          return parse_out_of_memory(error);
+
+      } else if (token.type == TOKEN_OPERATOR && token.length == 1 &&
+                 (expression[token.position] == '-' ||
+                  expression[token.position] == '~')) {
+        entry.kind = PENDING_UNARY;
+        entry.precedence = UNARY_PRECEDENCE;
+        entry.opcode = expression[token.position] == '-' ? FUNC_NEG
+                                                         : FUNC_BNOT;
+        if (push(b.pending, &entry) != 0)
+          return parse_out_of_memory(error);
+
+      } else if (token.type == TOKEN_END && b.nodes->size == 0 &&
+                 b.pending->size == 0) {
+        return parse_fail(error, error_create(ERR_PARSE, "Empty expression"));
+      } else if (token.type == TOKEN_COMMA) {
+        return parse_fail(error, error_create_at(ERR_PARSE, "Misplaced comma",
+                                                 token.position));
+      } else if (token.type == TOKEN_RBRACKET) {
+        return parse_unexpected(error, expression, &token);
+      } else {
+        return parse_fail(error, error_create_at(ERR_PARSE,
+                                                 "Not enough operands",
+                                                 token.position));
       }
+      continue;
     }
-  }
 
-  // Pop remaining operators
-  while (operator_stack->size > 0) {
-    token_t *top =
-        (token_t *)darray_get(operator_stack, operator_stack->size - 1);
-    operator_stack->size--;
-
-    if (top->type == TOKEN_LPAREN || top->type == TOKEN_RPAREN) {
-      if (error)
-        *error = error_create(ERR_PARSE, "Mismatched parentheses");
-      darray_free(tokens);
-      darray_free(operator_stack);
-      darray_free(arg_count_stack);
-      for (size_t j = 0; j < output_queue->size; j++) {
-        ast_node_t **node_ptr = (ast_node_t **)darray_get(output_queue, j);
-        ast_free(*node_ptr);
+    // An operand is complete: what follows must combine or close it
+    if (token.type == TOKEN_OPERATOR) {
+      binary_op_t op =
+          binary_op_lookup(expression + token.position, token.length);
+      if (op == BINOP_INVALID) {
+        return parse_fail(error,
+                          error_create_at(ERR_UNSUPPORTED,
+                                          "Unsupported operator",
+                                          token.position));
       }
-      darray_free(output_queue);
-      return NULL;
+      // Left-associative: equal precedence reduces first
+      if (reduce(&b, precedence[op]) != 0)
+        return parse_out_of_memory(error);
+      entry.kind = PENDING_BINARY;
+      entry.precedence = precedence[op];
+      entry.opcode = (int16_t)op;
+      if (push(b.pending, &entry) != 0)
+        return parse_out_of_memory(error);
+      expect_operand = 1;
+      continue;
     }
 
-    if (top->type == TOKEN_OPERATOR) {
-      ast_node_t *node = ast_node_create(NODE_OPERATOR);
-      snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-      darray_append(output_queue, &node);
-    } else if (top->type == TOKEN_FUNCTION) {
-      ast_node_t *node = ast_node_create(NODE_FUNCTION);
-      snprintf(node->op, MAX_TOKEN_LENGTH, "%s", top->value);
-      darray_append(output_queue, &node);
+    if (token.type != TOKEN_COMMA && token.type != TOKEN_RPAREN &&
+        token.type != TOKEN_RBRACKET && token.type != TOKEN_END) {
+      return parse_fail(error, error_create_at(ERR_PARSE, "Missing operator",
+                                               token.position));
     }
-  }
-
-  // Build AST from postfix notation using a stack
-  darray_t *build_stack = darray_create(sizeof(ast_node_t *), 16);
-  if (!build_stack) {
-    if (error)
-      *error = error_create(ERR_MEMORY, "Failed to create build stack");
-    for (size_t j = 0; j < output_queue->size; j++) {
-      ast_node_t **node_ptr = (ast_node_t **)darray_get(output_queue, j);
-      ast_free(*node_ptr);
-    }
-    darray_free(output_queue);
-    darray_free(tokens);
-    darray_free(operator_stack);
-    darray_free(arg_count_stack);
-    return NULL;
-  }
-
-  for (size_t i = 0; i < output_queue->size; i++) {
-    ast_node_t **node_ptr = (ast_node_t **)darray_get(output_queue, i);
-    ast_node_t *node = *node_ptr;
 
-    if (node->type == NODE_NUMBER) {
-      // Push number onto stack
-      darray_append(build_stack, &node);
+    if (reduce(&b, 0) != 0)
+      return parse_out_of_memory(error);
+    pending_t *top = pending_top(&b);
 
-    } else if (node->type == NODE_FUNCTION) {
-      // Pop arguments for function
-      int arg_count = node->child_count;
-
-      if ((size_t)arg_count > build_stack->size) {
-        if (error)
-          *error = error_create(ERR_PARSE, "Not enough arguments for function");
-        ast_free(node);
-        for (size_t j = 0; j < build_stack->size; j++) {
-          ast_node_t **n = (ast_node_t **)darray_get(build_stack, j);
-          ast_free(*n);
-        }
-        darray_free(build_stack);
-        darray_free(output_queue);
-        darray_free(tokens);
-        darray_free(operator_stack);
-        darray_free(arg_count_stack);
-        return NULL;
-      }
-
-      // Allocate children array
-      if (arg_count > 0) {
-        node->children = safe_malloc(arg_count * sizeof(ast_node_t *));
-        if (!node->children) {
-          if (error)
-            *error = error_create(ERR_MEMORY,
-                                  "Failed to allocate function arguments");
-          ast_free(node);
-          for (size_t j = 0; j < build_stack->size; j++) {
-            ast_node_t **n = (ast_node_t **)darray_get(build_stack, j);
-            ast_free(*n);
-          }
-          darray_free(build_stack);
-          darray_free(output_queue);
-          darray_free(tokens);
-          darray_free(operator_stack);
-          darray_free(arg_count_stack);
-          return NULL;
-        }
-
-        // Pop arguments in reverse order (they're on stack)
-        for (int j = arg_count - 1; j >= 0; j--) {
-          ast_node_t **arg_ptr =
-              (ast_node_t **)darray_get(build_stack, build_stack->size - 1);
-          node->children[j] = *arg_ptr;
-          build_stack->size--;
-        }
+    if (token.type == TOKEN_END) {
+      if (top) {
+        return parse_fail(error, error_create(ERR_PARSE,
+                                              top->kind == PENDING_LIST
+                                                  ? "Mismatched brackets"
+                                                  : "Mismatched parentheses"));
       }
+      break;
+    }
 
-      // Push function node onto stack
-      darray_append(build_stack, &node);
-
-    } else if (node->type == NODE_OPERATOR) {
-      // Pop 2 operands, make them children
-      if (build_stack->size < 2) {
-        if (error)
-          *error = error_create(ERR_PARSE, "Not enough operands");
-        ast_free(node);
-        for (size_t j = 0; j < build_stack->size; j++) {
-          ast_node_t **n = (ast_node_t **)darray_get(build_stack, j);
-          ast_free(*n);
-        }
-        darray_free(build_stack);
-        darray_free(output_queue);
-        darray_free(tokens);
-        darray_free(operator_stack);
-        darray_free(arg_count_stack);
-        return NULL;
+    if (token.type == TOKEN_COMMA) {
+      if (top && top->kind == PENDING_LIST) {
+        list_element(&b, top);
+      } else if (top && top->kind == PENDING_CALL) {
+        top->argc++;
+      } else {
+        return parse_fail(error, error_create_at(ERR_PARSE, "Misplaced comma",
+                                                 token.position));
       }
+      expect_operand = 1;
+      continue;
+    }
 
-      // Pop right operand
-      ast_node_t **right_ptr =
-          (ast_node_t **)darray_get(build_stack, build_stack->size - 1);
-      ast_node_t *right = *right_ptr;
-      build_stack->size--;
-
-      // Pop left operand
-      ast_node_t **left_ptr =
-          (ast_node_t **)darray_get(build_stack, build_stack->size - 1);
-      ast_node_t *left = *left_ptr;
-      build_stack->size--;
-
-      // Make them children of the operator node
-      node->children = safe_malloc(2 * sizeof(ast_node_t *));
-      if (!node->children) {
-        if (error)
-          *error = error_create(ERR_MEMORY, "Failed to allocate children");
-        ast_free(node);
-        ast_free(left);
-        ast_free(right);
-        for (size_t j = 0; j < build_stack->size; j++) {
-          ast_node_t **n = (ast_node_t **)darray_get(build_stack, j);
-          ast_free(*n);
-        }
-        darray_free(build_stack);
-        darray_free(output_queue);
-        darray_free(tokens);
-        darray_free(operator_stack);
-        darray_free(arg_count_stack);
-        return NULL;
+    if (token.type == TOKEN_RBRACKET) {
+      if (!top || top->kind != PENDING_LIST) {
+        return parse_fail(error, error_create_at(ERR_PARSE,
+                                                 "Mismatched brackets",
+                                                 token.position));
       }
-      node->children[0] = left;
-      node->children[1] = right;
-      node->child_count = 2;
-
-      // Push operator node onto stack
-      darray_append(build_stack, &node);
+      list_element(&b, top);
+      error_t list_error;
+      if (finish_list(&b, top, &list_error) != 0)
+        return parse_fail(error, list_error);
+      continue;
     }
-  }
 
-  // The final result should be the only item on the stack
-  ast_node_t *result = NULL;
-  if (build_stack->size == 1) {
-    ast_node_t **result_ptr = (ast_node_t **)darray_get(build_stack, 0);
-    result = *result_ptr;
-  } else if (build_stack->size == 0) {
-    if (error)
-      *error = error_create(ERR_PARSE, "Empty expression");
-  } else {
-    if (error)
-      *error = error_create(ERR_PARSE, "Invalid expression");
-    // Clean up extra nodes
-    for (size_t j = 0; j < build_stack->size; j++) {
-      ast_node_t **n = (ast_node_t **)darray_get(build_stack, j);
-      ast_free(*n);
+    // ')'
+    if (!top || top->kind == PENDING_LIST) {
+      return parse_fail(error,
+                        error_create(ERR_PARSE, "Mismatched parentheses"));
+    }
+    if (top->kind == PENDING_GROUP) {
+      b.pending->size--;
+    } else {
+      top->argc++;
+      error_t call_error;
+      if (finish_call(&b, top, &call_error) != 0)
+        return parse_fail(error, call_error);
     }
   }
 
-  if (error && result)
-    *error = error_ok();
-
-  darray_free(build_stack);
-  darray_free(tokens);
-  darray_free(operator_stack);
-  darray_free(arg_count_stack);
-  darray_free(output_queue);
+  // The assignment wraps the whole expression
+  if (assign_slot >= 0) {
+    ast_node_t node = {0};
+    node.type = NODE_ASSIGN;
+    node.opcode = (int16_t)assign_slot;
+    node.position = assign_position;
+    node.child_count = 1;
+    if (emit(&b, node) != 0)
+      return parse_out_of_memory(error);
+  }
 
-  return result;
+  ast_t *ast = arena_alloc(arena, sizeof(ast_t));
+  if (!ast) {
+    return parse_out_of_memory(error);
+  }
+  ast->nodes = (ast_node_t *)b.nodes->data;
+  ast->node_count = b.nodes->size;
+  ast->edges = (ast_index_t *)b.edges->data;
+  ast->edge_count = b.edges->size;
+  ast->constants = (double *)b.constants->data;
+  ast->constant_count = b.constants->size;
+  ast->strings = (const char *)b.strings->data;
+  ast->string_length = b.strings->size;
+  ast->root = (ast_index_t)(b.nodes->size - 1);
+
+  if (error)
+    error_clear(error);
+  return ast;
 }
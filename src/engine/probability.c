@@ -17,7 +17,7 @@ double prob_factorial(int n, error_t *error) {
     result *= i;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -44,7 +44,7 @@ double prob_ncr(int n, int r, error_t *error) {
     result *= (double)(n - i) / (double)(i + 1);
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -66,7 +66,7 @@ double prob_npr(int n, int r, error_t *error) {
     result *= (n - i);
   }
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -95,7 +95,7 @@ double prob_binomial(int n, double p, int k, error_t *error) {
 
   double result = ncr * pow(p, k) * pow(1.0 - p, n - k);
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
@@ -113,6 +113,6 @@ double prob_geometric(double p, int k, error_t *error) {
   // P(X = k) = (1-p)^(k-1) * p
   double result = pow(1.0 - p, k - 1) * p;
 
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
@@ -1,5 +1,5 @@
 #include "engine/set_ops.h"
-#include "common/memory.h"
+#include "engine/parser.h"
 #include <math.h>
 
 // Helper: check if element is in set (with floating point tolerance)
@@ -17,7 +17,7 @@ int set_contains(const double *set, size_t size, double element) {
 double *set_union(const double *a, size_t a_size, const double *b,
                   size_t b_size, size_t *result_size, error_t *error) {
   // Worst case: all elements are unique
-  double *result = safe_malloc((a_size + b_size) * sizeof(double));
+  double *result = value_alloc(a_size + b_size);
   if (!result) {
     *error = error_create(ERR_MEMORY, "Failed to allocate set union");
     *result_size = 0;
@@ -41,15 +41,14 @@ double *set_union(const double *a, size_t a_size, const double *b,
   }
 
   *result_size = count;
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
 // Set intersection
 double *set_intersection(const double *a, size_t a_size, const double *b,
                          size_t b_size, size_t *result_size, error_t *error) {
-  double *result =
-      safe_malloc(a_size * sizeof(double)); // At most a_size elements
+  double *result = value_alloc(a_size); // At most a_size elements
   if (!result) {
     *error = error_create(ERR_MEMORY, "Failed to allocate set intersection");
     *result_size = 0;
@@ -65,14 +64,14 @@ double *set_intersection(const double *a, size_t a_size, const double *b,
   }
 
   *result_size = count;
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
 // Set difference
 double *set_difference(const double *a, size_t a_size, const double *b,
                        size_t b_size, size_t *result_size, error_t *error) {
-  double *result = safe_malloc(a_size * sizeof(double));
+  double *result = value_alloc(a_size);
   if (!result) {
     *error = error_create(ERR_MEMORY, "Failed to allocate set difference");
     *result_size = 0;
@@ -88,6 +87,6 @@ double *set_difference(const double *a, size_t a_size, const double *b,
   }
 
   *result_size = count;
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
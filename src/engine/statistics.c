@@ -4,47 +4,241 @@
 #include <stdlib.h>
 #include <string.h>
 
-double stats_mean(const double *data, size_t size, error_t *error) {
-  if (!data || size == 0) {
+static int compare_double(const void *a, const void *b) {
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+  if (da < db)
+    return -1;
+  if (da > db)
+    return 1;
+  return 0;
+}
+
+// Values summarized on their own before being merged into a running
+// summary: few enough to stay in L1 for the second pass over them, enough
+// to amortize the merge
+#define STATS_BLOCK 256
+
+void stats_acc_init(stats_acc_t *acc) {
+  *acc = (stats_acc_t){0, 0.0, 0.0, INFINITY, -INFINITY};
+}
+
+// Summary of 1..STATS_BLOCK values: the mean first, then the deviations
+// from it, both over data that is still in cache. Four independent
+// partial sums keep the additions from waiting on each other.
+static stats_acc_t block_summary(const double *data, size_t size) {
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+  double min[4] = {data[0], data[0], data[0], data[0]};
+  double max[4] = {data[0], data[0], data[0], data[0]};
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    for (size_t k = 0; k < 4; k++) {
+      sum[k] += data[i + k];
+      min[k] = data[i + k] < min[k] ? data[i + k] : min[k];
+      max[k] = data[i + k] > max[k] ? data[i + k] : max[k];
+    }
+  }
+  for (; i < size; i++) {
+    sum[0] += data[i];
+    min[0] = data[i] < min[0] ? data[i] : min[0];
+    max[0] = data[i] > max[0] ? data[i] : max[0];
+  }
+  double mean = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / (double)size;
+  stats_acc_t acc = {size, mean, 0.0, min[0], max[0]};
+  for (size_t k = 1; k < 4; k++) {
+    acc.min = min[k] < acc.min ? min[k] : acc.min;
+    acc.max = max[k] > acc.max ? max[k] : acc.max;
+  }
+
+  double m2[4] = {0.0, 0.0, 0.0, 0.0};
+  for (i = 0; i + 4 <= size; i += 4) {
+    for (size_t k = 0; k < 4; k++) {
+      double diff = data[i + k] - acc.mean;
+      m2[k] += diff * diff;
+    }
+  }
+  for (; i < size; i++) {
+    double diff = data[i] - acc.mean;
+    m2[0] += diff * diff;
+  }
+  acc.m2 = (m2[0] + m2[1]) + (m2[2] + m2[3]);
+  return acc;
+}
+
+void stats_acc_push(stats_acc_t *acc, const double *data, size_t size) {
+  for (size_t i = 0; i < size; i += STATS_BLOCK) {
+    size_t n = size - i < STATS_BLOCK ? size - i : STATS_BLOCK;
+    stats_acc_t block = block_summary(data + i, n);
+    stats_acc_merge(acc, &block);
+  }
+}
+
+void stats_acc_merge(stats_acc_t *acc, const stats_acc_t *other) {
+  if (other->count == 0)
+    return;
+  if (acc->count == 0) {
+    *acc = *other;
+    return;
+  }
+
+  // Chan et al.: the means differ by delta, weighted by the other's share
+  double delta = other->mean - acc->mean;
+  double share = (double)other->count / (double)(acc->count + other->count);
+  acc->mean += delta * share;
+  acc->m2 += other->m2 + delta * delta * (double)acc->count * share;
+  acc->count += other->count;
+  acc->min = other->min < acc->min ? other->min : acc->min;
+  acc->max = other->max > acc->max ? other->max : acc->max;
+}
+
+stats_summary_t stats_acc_finalize(const stats_acc_t *acc, error_t *error) {
+  if (acc->count == 0) {
+    *error = error_create(ERR_INVALID_ARGS, "Empty dataset");
+    return (stats_summary_t){0};
+  }
+
+  double variance = acc->m2 / (double)acc->count;
+  error_clear(error);
+  return (stats_summary_t){acc->count, acc->mean, variance,
+                           sqrt(variance), acc->min, acc->max};
+}
+
+void stats_cov_init(stats_cov_t *acc) {
+  stats_acc_init(&acc->x);
+  stats_acc_init(&acc->y);
+  acc->c = 0.0;
+}
+
+// Like block_summary for pairs: both means in one pass, then the squared
+// deviations and their products in another
+static stats_cov_t block_cov(const double *x, const double *y, size_t size) {
+  stats_cov_t block = {{size, 0.0, 0.0, x[0], x[0]},
+                       {size, 0.0, 0.0, y[0], y[0]},
+                       0.0};
+  double sx = 0.0, sy = 0.0;
+  for (size_t i = 0; i < size; i++) {
+    sx += x[i];
+    sy += y[i];
+    block.x.min = x[i] < block.x.min ? x[i] : block.x.min;
+    block.x.max = x[i] > block.x.max ? x[i] : block.x.max;
+    block.y.min = y[i] < block.y.min ? y[i] : block.y.min;
+    block.y.max = y[i] > block.y.max ? y[i] : block.y.max;
+  }
+  block.x.mean = sx / (double)size;
+  block.y.mean = sy / (double)size;
+
+  for (size_t i = 0; i < size; i++) {
+    double dx = x[i] - block.x.mean, dy = y[i] - block.y.mean;
+    block.x.m2 += dx * dx;
+    block.y.m2 += dy * dy;
+    block.c += dx * dy;
+  }
+  return block;
+}
+
+void stats_cov_push(stats_cov_t *acc, const double *x, const double *y,
+                    size_t size) {
+  for (size_t i = 0; i < size; i += STATS_BLOCK) {
+    size_t n = size - i < STATS_BLOCK ? size - i : STATS_BLOCK;
+    stats_cov_t block = block_cov(x + i, y + i, n);
+    stats_cov_merge(acc, &block);
+  }
+}
+
+void stats_cov_merge(stats_cov_t *acc, const stats_cov_t *other) {
+  if (other->x.count == 0)
+    return;
+  if (acc->x.count == 0) {
+    *acc = *other;
+    return;
+  }
+
+  // Uses the means from before the merge
+  double share =
+      (double)other->x.count / (double)(acc->x.count + other->x.count);
+  acc->c += other->c + (other->x.mean - acc->x.mean) *
+                           (other->y.mean - acc->y.mean) *
+                           (double)acc->x.count * share;
+  stats_acc_merge(&acc->x, &other->x);
+  stats_acc_merge(&acc->y, &other->y);
+}
+
+double stats_cov_finalize(const stats_cov_t *acc, double *correlation,
+                          error_t *error) {
+  if (acc->x.count == 0) {
+    *error = error_create(ERR_INVALID_ARGS, "Empty dataset for covariance");
+    return 0.0;
+  }
+
+  if (correlation) {
+    double denom = sqrt(acc->x.m2 * acc->y.m2);
+    if (denom == 0.0) {
+      *error = error_create(ERR_DIV_ZERO, "Zero denominator in correlation");
+      return 0.0;
+    }
+    *correlation = acc->c / denom;
+  }
+
+  error_clear(error);
+  return acc->c / (double)acc->x.count;
+}
+
+// Summary of every span of a dataset
+static stats_acc_t summarize(const dataset_t *set) {
+  stats_acc_t acc;
+  stats_acc_init(&acc);
+  for (size_t s = 0; s < set->count; s++)
+    stats_acc_push(&acc, set->spans[s].data, set->spans[s].size);
+  return acc;
+}
+
+double stats_mean(const dataset_t *set, error_t *error) {
+  if (set->size == 0) {
     *error = error_create(ERR_INVALID_ARGS, "Empty dataset for mean");
     return 0.0;
   }
 
   double sum = 0.0;
-  for (size_t i = 0; i < size; i++) {
-    sum += data[i];
+  for (size_t s = 0; s < set->count; s++) {
+    const span_t *span = &set->spans[s];
+    for (size_t i = 0; i < span->size; i++) {
+      sum += span->data[i];
+    }
   }
 
-  *error = error_ok();
-  return sum / (double)size;
+  error_clear(error);
+  return sum / (double)set->size;
 }
 
-static int compare_double(const void *a, const void *b) {
-  double da = *(const double *)a;
-  double db = *(const double *)b;
-  if (da < db)
-    return -1;
-  if (da > db)
-    return 1;
-  return 0;
+// Sorted copy of a dataset, or NULL when allocation fails
+static double *sorted_copy(const dataset_t *set) {
+  double *sorted = safe_malloc(set->size * sizeof(double));
+  if (!sorted)
+    return NULL;
+
+  size_t pos = 0;
+  for (size_t s = 0; s < set->count; s++) {
+    memcpy(sorted + pos, set->spans[s].data,
+           set->spans[s].size * sizeof(double));
+    pos += set->spans[s].size;
+  }
+  qsort(sorted, set->size, sizeof(double), compare_double);
+  return sorted;
 }
 
-double stats_median(const double *data, size_t size, error_t *error) {
-  if (!data || size == 0) {
+double stats_median(const dataset_t *set, error_t *error) {
+  if (set->size == 0) {
     *error = error_create(ERR_INVALID_ARGS, "Empty dataset for median");
     return 0.0;
   }
 
-  // Create a copy to sort
-  double *sorted = safe_malloc(size * sizeof(double));
+  double *sorted = sorted_copy(set);
   if (!sorted) {
     *error = error_create(ERR_MEMORY, "Failed to allocate for median");
     return 0.0;
   }
 
-  memcpy(sorted, data, size * sizeof(double));
-  qsort(sorted, size, sizeof(double), compare_double);
-
+  size_t size = set->size;
   double result;
   if (size % 2 == 0) {
     // Even number of elements - average middle two
@@ -55,32 +249,28 @@ double stats_median(const double *data, size_t size, error_t *error) {
   }
 
   safe_free(sorted);
-  *error = error_ok();
+  error_clear(error);
   return result;
 }
 
-double stats_mode(const double *data, size_t size, error_t *error) {
-  if (!data || size == 0) {
+double stats_mode(const dataset_t *set, error_t *error) {
+  if (set->size == 0) {
     *error = error_create(ERR_INVALID_ARGS, "Empty dataset for mode");
     return 0.0;
   }
 
-  // Create a copy to sort
-  double *sorted = safe_malloc(size * sizeof(double));
+  double *sorted = sorted_copy(set);
   if (!sorted) {
     *error = error_create(ERR_MEMORY, "Failed to allocate for mode");
     return 0.0;
   }
 
-  memcpy(sorted, data, size * sizeof(double));
-  qsort(sorted, size, sizeof(double), compare_double);
-
   // Find most frequent value
   double mode = sorted[0];
   size_t max_count = 1;
   size_t current_count = 1;
 
-  for (size_t i = 1; i < size; i++) {
+  for (size_t i = 1; i < set->size; i++) {
     if (fabs(sorted[i] - sorted[i - 1]) < 1e-9) { // Equal within tolerance
       current_count++;
       if (current_count > max_count) {
@@ -93,65 +283,47 @@ double stats_mode(const double *data, size_t size, error_t *error) {
   }
 
   safe_free(sorted);
-  *error = error_ok();
+  error_clear(error);
   return mode;
 }
 
-double stats_variance(const double *data, size_t size, error_t *error) {
-  if (!data || size == 0) {
+double stats_variance(const dataset_t *set, error_t *error) {
+  if (set->size == 0) {
     *error = error_create(ERR_INVALID_ARGS, "Empty dataset for variance");
     return 0.0;
   }
 
-  double mean = stats_mean(data, size, error);
-  if (!error_is_ok(*error)) {
-    return 0.0;
-  }
-
-  double sum_sq_diff = 0.0;
-  for (size_t i = 0; i < size; i++) {
-    double diff = data[i] - mean;
-    sum_sq_diff += diff * diff;
-  }
-
-  *error = error_ok();
-  return sum_sq_diff / (double)size;
+  stats_acc_t acc = summarize(set);
+  error_clear(error);
+  return acc.m2 / (double)acc.count;
 }
 
-double stats_stddev(const double *data, size_t size, error_t *error) {
-  double var = stats_variance(data, size, error);
+double stats_stddev(const dataset_t *set, error_t *error) {
+  double var = stats_variance(set, error);
   if (!error_is_ok(*error)) {
     return 0.0;
   }
 
-  *error = error_ok();
+  error_clear(error);
   return sqrt(var);
 }
 
-double stats_zscore(double value, const double *data, size_t size,
-                    error_t *error) {
-  if (!data || size == 0) {
+double stats_zscore(double value, const dataset_t *set, error_t *error) {
+  if (set->size == 0) {
     *error = error_create(ERR_INVALID_ARGS, "Empty dataset for z-score");
     return 0.0;
   }
 
-  double mean = stats_mean(data, size, error);
-  if (!error_is_ok(*error)) {
-    return 0.0;
-  }
-
-  double stddev = stats_stddev(data, size, error);
-  if (!error_is_ok(*error)) {
-    return 0.0;
-  }
-
+  // Mean and deviation from the same single pass
+  stats_acc_t acc = summarize(set);
+  double stddev = sqrt(acc.m2 / (double)acc.count);
   if (stddev == 0.0) {
     *error = error_create(ERR_DIV_ZERO, "Zero standard deviation for z-score");
     return 0.0;
   }
 
-  *error = error_ok();
-  return (value - mean) / stddev;
+  error_clear(error);
+  return (value - acc.mean) / stddev;
 }
 
 double stats_correlation(const double *x, size_t x_size, const double *y,
@@ -167,31 +339,10 @@ double stats_correlation(const double *x, size_t x_size, const double *y,
     return 0.0;
   }
 
-  size_t n = x_size;
-  double mean_x = stats_mean(x, n, error);
-  if (!error_is_ok(*error))
-    return 0.0;
-
-  double mean_y = stats_mean(y, n, error);
-  if (!error_is_ok(*error))
-    return 0.0;
-
-  double sum_xy = 0.0, sum_x2 = 0.0, sum_y2 = 0.0;
-
-  for (size_t i = 0; i < n; i++) {
-    double dx = x[i] - mean_x;
-    double dy = y[i] - mean_y;
-    sum_xy += dx * dy;
-    sum_x2 += dx * dx;
-    sum_y2 += dy * dy;
-  }
-
-  double denom = sqrt(sum_x2 * sum_y2);
-  if (denom == 0.0) {
-    *error = error_create(ERR_DIV_ZERO, "Zero denominator in correlation");
-    return 0.0;
-  }
-
-  *error = error_ok();
-  return sum_xy / denom;
+  stats_cov_t acc;
+  stats_cov_init(&acc);
+  stats_cov_push(&acc, x, y, x_size);
+  double correlation;
+  stats_cov_finalize(&acc, &correlation, error);
+  return error_is_ok(*error) ? correlation : 0.0;
 }
@@ -0,0 +1,139 @@
+#include "engine/symbols.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+symbol_table_t *symbol_table_create(void) {
+  symbol_table_t *table = safe_calloc(1, sizeof(symbol_table_t));
+  if (!table)
+    return NULL;
+
+  error_t error;
+  if (symbol_resolve(table, "ans", 3, &error) != SYMBOL_ANS) {
+    symbol_table_free(table);
+    return NULL;
+  }
+  symbol_set(table, SYMBOL_ANS, value_number(0));
+  return table;
+}
+
+symbol_table_t *symbol_table_clone(const symbol_table_t *table) {
+  symbol_table_t *copy = safe_calloc(1, sizeof(symbol_table_t));
+  if (!copy)
+    return NULL;
+
+  error_t error;
+  for (size_t i = 0; i < table->count; i++) {
+    const char *name = table->names[i];
+    if (symbol_resolve(copy, name, strlen(name), &error) != (int)i) {
+      symbol_table_free(copy);
+      return NULL;
+    }
+    if (table->defined[i])
+      symbol_set(copy, i, value_clone(&table->values[i]));
+  }
+  return copy;
+}
+
+static int symbol_grow(symbol_table_t *table) {
+  size_t capacity = table->capacity ? table->capacity * 2 : 16;
+  char **names = safe_realloc(table->names, capacity * sizeof(char *));
+  if (!names)
+    return -1;
+  table->names = names;
+
+  value_t *values = safe_realloc(table->values, capacity * sizeof(value_t));
+  if (!values)
+    return -1;
+  table->values = values;
+
+  unsigned char *defined = safe_realloc(table->defined, capacity);
+  if (!defined)
+    return -1;
+  table->defined = defined;
+
+  table->capacity = capacity;
+  return 0;
+}
+
+int symbol_resolve(symbol_table_t *table, const char *name, size_t length,
+                   error_t *error) {
+  for (size_t i = 0; i < table->count; i++) {
+    if (strncmp(table->names[i], name, length) == 0 &&
+        table->names[i][length] == '\0')
+      return (int)i;
+  }
+
+  if (table->count >= SYMBOL_MAX) {
+    *error = error_create(ERR_MEMORY, "Too many variables");
+    return -1;
+  }
+  if (table->count == table->capacity && symbol_grow(table) != 0) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate variable");
+    return -1;
+  }
+
+  char *copy = safe_malloc(length + 1);
+  if (!copy) {
+    *error = error_create(ERR_MEMORY, "Failed to allocate variable");
+    return -1;
+  }
+  memcpy(copy, name, length);
+  copy[length] = '\0';
+
+  size_t slot = table->count++;
+  table->names[slot] = copy;
+  table->values[slot] = value_number(0);
+  table->defined[slot] = 0;
+  return (int)slot;
+}
+
+void symbol_forget(symbol_table_t *table, size_t count) {
+  while (table->count > count) {
+    size_t slot = --table->count;
+    value_free(&table->values[slot]);
+    safe_free(table->names[slot]);
+  }
+}
+
+const value_t *symbol_get(const symbol_table_t *table, size_t slot) {
+  if (!table || slot >= table->count || !table->defined[slot])
+    return NULL;
+  return &table->values[slot];
+}
+
+void symbol_set(symbol_table_t *table, size_t slot, value_t value) {
+  if (slot >= table->count) {
+    value_free(&value);
+    return;
+  }
+
+  // A view may point into the very value being replaced
+  if (value.borrowed)
+    value = value_clone(&value);
+
+  value_free(&table->values[slot]);
+  table->values[slot] = value;
+  table->defined[slot] = 1;
+}
+
+error_t symbol_undefined_error(const symbol_table_t *table, size_t slot) {
+  char message[128];
+  snprintf(message, sizeof(message), "Undefined variable '%s'",
+           table && slot < table->count ? table->names[slot] : "?");
+  return error_create(ERR_EVAL, message);
+}
+
+void symbol_table_free(symbol_table_t *table) {
+  if (!table)
+    return;
+
+  for (size_t i = 0; i < table->count; i++) {
+    value_free(&table->values[i]);
+    safe_free(table->names[i]);
+  }
+  safe_free(table->names);
+  safe_free(table->values);
+  safe_free(table->defined);
+  safe_free(table);
+}
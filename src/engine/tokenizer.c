@@ -1,8 +1,49 @@
 #include "engine/tokenizer.h"
+#include "common/decimal.h"
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <stdio.h>
+
+// Character classes, looked up once per byte instead of calling the
+// locale-aware <ctype.h> functions
+#define CC_SPACE 0x01
+#define CC_DIGIT 0x02
+#define CC_XDIGIT 0x04
+#define CC_ALPHA 0x08 // Letters and '_': may start an identifier
+#define CC_OPERATOR 0x10
+
+#define CC_DEC (CC_DIGIT | CC_XDIGIT)
+#define CC_HEX (CC_ALPHA | CC_XDIGIT)
+
+static const unsigned char char_class[256] = {
+    ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE,
+    ['\f'] = CC_SPACE, ['\r'] = CC_SPACE, [' '] = CC_SPACE,
+    ['0'] = CC_DEC, ['1'] = CC_DEC, ['2'] = CC_DEC, ['3'] = CC_DEC,
+    ['4'] = CC_DEC, ['5'] = CC_DEC, ['6'] = CC_DEC, ['7'] = CC_DEC,
+    ['8'] = CC_DEC, ['9'] = CC_DEC,
+    ['a'] = CC_HEX, ['b'] = CC_HEX, ['c'] = CC_HEX, ['d'] = CC_HEX,
+    ['e'] = CC_HEX, ['f'] = CC_HEX,
+    ['A'] = CC_HEX, ['B'] = CC_HEX, ['C'] = CC_HEX, ['D'] = CC_HEX,
+    ['E'] = CC_HEX, ['F'] = CC_HEX,
+    ['g'] = CC_ALPHA, ['h'] = CC_ALPHA, ['i'] = CC_ALPHA, ['j'] = CC_ALPHA,
+    ['k'] = CC_ALPHA, ['l'] = CC_ALPHA, ['m'] = CC_ALPHA, ['n'] = CC_ALPHA,
+    ['o'] = CC_ALPHA, ['p'] = CC_ALPHA, ['q'] = CC_ALPHA, ['r'] = CC_ALPHA,
+    ['s'] = CC_ALPHA, ['t'] = CC_ALPHA, ['u'] = CC_ALPHA, ['v'] = CC_ALPHA,
+    ['w'] = CC_ALPHA, ['x'] = CC_ALPHA, ['y'] = CC_ALPHA, ['z'] = CC_ALPHA,
+    ['G'] = CC_ALPHA, ['H'] = CC_ALPHA, ['I'] = CC_ALPHA, ['J'] = CC_ALPHA,
+    ['K'] = CC_ALPHA, ['L'] = CC_ALPHA, ['M'] = CC_ALPHA, ['N'] = CC_ALPHA,
+    ['O'] = CC_ALPHA, ['P'] = CC_ALPHA, ['Q'] = CC_ALPHA, ['R'] = CC_ALPHA,
+    ['S'] = CC_ALPHA, ['T'] = CC_ALPHA, ['U'] = CC_ALPHA, ['V'] = CC_ALPHA,
+    ['W'] = CC_ALPHA, ['X'] = CC_ALPHA, ['Y'] = CC_ALPHA, ['Z'] = CC_ALPHA,
+    ['_'] = CC_ALPHA,
+    ['+'] = CC_OPERATOR, ['-'] = CC_OPERATOR, ['*'] = CC_OPERATOR,
+    ['/'] = CC_OPERATOR, ['%'] = CC_OPERATOR, ['&'] = CC_OPERATOR,
+    ['|'] = CC_OPERATOR, ['^'] = CC_OPERATOR, ['~'] = CC_OPERATOR,
+    ['<'] = CC_OPERATOR, ['>'] = CC_OPERATOR,
+};
+
+static int char_is(char c, unsigned char cls) {
+    return (char_class[(unsigned char)c] & cls) != 0;
+}
 
 tokenizer_t *tokenizer_create(const char *expression) {
     if (!expression) {
@@ -14,118 +55,103 @@ tokenizer_t *tokenizer_create(const char *expression) {
         return NULL;
     }
     
+    tokenizer_init(tok, expression);
+    return tok;
+}
+
+void tokenizer_init(tokenizer_t *tok, const char *expression) {
     tok->input = expression;
     tok->position = 0;
     tok->length = strlen(expression);
-    tok->error = error_ok();
-    
-    return tok;
+    error_clear(&tok->error);
 }
 
+// The input is NUL-terminated and NUL has no class, so the scans below need
+// no separate bounds check
 static void skip_whitespace(tokenizer_t *tok) {
-    while (tok->position < tok->length && isspace(tok->input[tok->position])) {
-        tok->position++;
+    const char *p = tok->input + tok->position;
+    while (char_is(*p, CC_SPACE)) {
+        p++;
     }
-}
-
-static int is_operator_char(char c) {
-    return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' ||
-           c == '&' || c == '|' || c == '^' || c == '~' ||
-           c == '<' || c == '>';
+    tok->position = (size_t)(p - tok->input);
 }
 
 static int parse_number(tokenizer_t *tok, token_t *token) {
     size_t start = tok->position;
-    char buffer[MAX_TOKEN_LENGTH];
-    int buf_pos = 0;
+    const char *p = tok->input + start;
     int base = 10;
     
     // Check for hex/binary/octal prefix
-    if (tok->input[tok->position] == '0' && tok->position + 1 < tok->length) {
-        char next = tok->input[tok->position + 1];
-        if (next == 'x' || next == 'X') {
+    if (p[0] == '0') {
+        if (p[1] == 'x' || p[1] == 'X') {
             base = 16;
-            tok->position += 2;
-        } else if (next == 'b' || next == 'B') {
+            p += 2;
+        } else if (p[1] == 'b' || p[1] == 'B') {
             base = 2;
-            tok->position += 2;
-        } else if (isdigit(next)) {
+            p += 2;
+        } else if (char_is(p[1], CC_DIGIT)) {
             base = 8;
         }
     }
     
-    // Read digits
-    while (tok->position < tok->length && buf_pos < MAX_TOKEN_LENGTH - 1) {
-        char c = tok->input[tok->position];
-        
-        if (base == 16 && isxdigit(c)) {
-            buffer[buf_pos++] = c;
-            tok->position++;
-        } else if (base == 2 && (c == '0' || c == '1')) {
-            buffer[buf_pos++] = c;
-            tok->position++;
-        } else if (base == 8 && c >= '0' && c <= '7') {
-            buffer[buf_pos++] = c;
-            tok->position++;
-        } else if (base == 10 && (isdigit(c) || c == '.' || c == 'e' || c == 'E')) {
-            buffer[buf_pos++] = c;
-            tok->position++;
+    // Scan digits
+    const char *digits = p;
+    if (base == 16) {
+        while (char_is(*p, CC_XDIGIT)) {
+            p++;
+        }
+    } else if (base == 2) {
+        while (*p == '0' || *p == '1') {
+            p++;
+        }
+    } else if (base == 8) {
+        while (*p >= '0' && *p <= '7') {
+            p++;
+        }
+    } else {
+        while (char_is(*p, CC_DIGIT) || *p == '.' || *p == 'e' || *p == 'E') {
             // Handle scientific notation sign
-            if ((c == 'e' || c == 'E') && tok->position < tok->length) {
-                char sign = tok->input[tok->position];
-                if (sign == '+' || sign == '-') {
-                    buffer[buf_pos++] = sign;
-                    tok->position++;
-                }
+            if ((*p == 'e' || *p == 'E') && (p[1] == '+' || p[1] == '-')) {
+                p++;
             }
-        } else {
-            break;
+            p++;
         }
     }
     
-    buffer[buf_pos] = '\0';
-    
-    if (buf_pos == 0) {
+    if (p == digits) {
         tok->error = error_create_at(ERR_SYNTAX, "Invalid number", start);
         return -1;
     }
     
-    // Convert to double
+    // Convert straight from the input; the conversions stop at or before
+    // the end of the scanned span
     if (base == 10) {
-        token->num_value = strtod(buffer, NULL);
+        token->num_value = decimal_parse(digits, NULL);
     } else {
         // Convert integer bases to double
-        long long val = strtoll(buffer, NULL, base);
-        token->num_value = (double)val;
+        token->num_value = (double)strtoll(digits, NULL, base);
     }
     
     token->type = TOKEN_NUMBER;
-    snprintf(token->value, MAX_TOKEN_LENGTH, "%s", buffer);
     token->position = start;
+    token->length = (size_t)(p - (tok->input + start));
+    tok->position = start + token->length;
     
     return 1;
 }
 
 static int parse_identifier(tokenizer_t *tok, token_t *token) {
     size_t start = tok->position;
-    char buffer[MAX_TOKEN_LENGTH];
-    int buf_pos = 0;
+    const char *p = tok->input + start;
     
-    while (tok->position < tok->length && buf_pos < MAX_TOKEN_LENGTH - 1) {
-        char c = tok->input[tok->position];
-        if (isalnum(c) || c == '_') {
-            buffer[buf_pos++] = c;
-            tok->position++;
-        } else {
-            break;
-        }
+    while (char_is(*p, CC_ALPHA | CC_DIGIT)) {
+        p++;
     }
     
-    buffer[buf_pos] = '\0';
-    
     token->type = TOKEN_FUNCTION;
-    snprintf(token->value, MAX_TOKEN_LENGTH, "%s", buffer);
     token->position = start;
+    token->length = (size_t)(p - (tok->input + start));
+    tok->position = start + token->length;
     
     return 1;
 }
@@ -139,82 +165,70 @@ int tokenizer_next(tokenizer_t *tok, token_t *token) {
     
     if (tok->position >= tok->length) {
         token->type = TOKEN_END;
+        token->position = tok->length;
+        token->length = 0;
         return 0;
     }
     
-    char c = tok->input[tok->position];
+    const char *p = tok->input + tok->position;
+    char c = *p;
     
-    // Numbers
-    if (isdigit(c) || (c == '.' && tok->position + 1 < tok->length && 
-                       isdigit(tok->input[tok->position + 1]))) {
+    // Numbers (including 0x/0b prefixes)
+    if (char_is(c, CC_DIGIT) || (c == '.' && char_is(p[1], CC_DIGIT))) {
         return parse_number(tok, token);
     }
     
-    // Hex numbers starting with 0x
-    if (c == '0' && tok->position + 1 < tok->length) {
-        char next = tok->input[tok->position + 1];
-        if (next == 'x' || next == 'X' || next == 'b' || next == 'B') {
-            return parse_number(tok, token);
-        }
+    // Identifiers (functions and variables)
+    if (char_is(c, CC_ALPHA)) {
+        return parse_identifier(tok, token);
     }
     
-    // Identifiers (functions)
-    if (isalpha(c) || c == '_') {
-        return parse_identifier(tok, token);
+    // Strings run to the next quote, with no escapes
+    if (c == '"') {
+        const char *close = memchr(p + 1, '"', tok->length - tok->position - 1);
+        if (!close) {
+            tok->error = error_create_at(ERR_SYNTAX, "Unterminated string",
+                                         tok->position);
+            return -1;
+        }
+        token->type = TOKEN_STRING;
+        token->position = tok->position;
+        token->length = (size_t)(close - p) + 1;
+        tok->position += token->length;
+        return 1;
     }
     
     // Single character tokens
     token->position = tok->position;
+    token->length = 1;
     
     if (c == '(') {
         token->type = TOKEN_LPAREN;
-        snprintf(token->value, MAX_TOKEN_LENGTH, "(");
-        tok->position++;
-        return 1;
     } else if (c == ')') {
         token->type = TOKEN_RPAREN;
-        snprintf(token->value, MAX_TOKEN_LENGTH, ")");
-        tok->position++;
-        return 1;
     } else if (c == '[') {
         token->type = TOKEN_LBRACKET;
-        snprintf(token->value, MAX_TOKEN_LENGTH, "[");
-        tok->position++;
-        return 1;
     } else if (c == ']') {
         token->type = TOKEN_RBRACKET;
-        snprintf(token->value, MAX_TOKEN_LENGTH, "]");
-        tok->position++;
-        return 1;
     } else if (c == ',') {
         token->type = TOKEN_COMMA;
-        snprintf(token->value, MAX_TOKEN_LENGTH, ",");
-        tok->position++;
-        return 1;
-    }
-    
-    // Operators (including multi-char like <<, >>)
-    if (is_operator_char(c)) {
+    } else if (c == '=') {
+        token->type = TOKEN_ASSIGN;
+    } else if (char_is(c, CC_OPERATOR)) {
+        // Operators (including multi-char like <<, >>)
         token->type = TOKEN_OPERATOR;
-        char op[3] = {c, '\0', '\0'};
-        tok->position++;
-        
-        // Check for two-character operators
-        if (tok->position < tok->length) {
-            char next = tok->input[tok->position];
-            if ((c == '<' && next == '<') || (c == '>' && next == '>')) {
-                op[1] = next;
-                tok->position++;
-            }
+        if ((c == '<' || c == '>') && p[1] == c) {
+            token->length = 2;
         }
-        
-        snprintf(token->value, MAX_TOKEN_LENGTH, "%s", op);
-        return 1;
+    } else {
+        // Unknown character
+        tok->error = error_create_at(ERR_SYNTAX, "Unexpected character",
+                                     tok->position);
+        return -1;
     }
     
-    // Unknown character
-    tok->error = error_create_at(ERR_SYNTAX, "Unexpected character", tok->position);
-    return -1;
+    tok->position += token->length;
+    return 1;
 }
 
 int tokenizer_peek(tokenizer_t *tok, token_t *token) {
@@ -231,52 +245,3 @@ error_t tokenizer_get_error(tokenizer_t *tok) {
 void tokenizer_free(tokenizer_t *tok) {
     safe_free(tok);
 }
-
-darray_t *tokenize(const char *expression, error_t *error) {
-    tokenizer_t *tok = tokenizer_create(expression);
-    if (!tok) {
-        if (error) {
-            *error = error_create(ERR_MEMORY, "Failed to create tokenizer");
-        }
-        return NULL;
-    }
-    
-    darray_t *tokens = darray_create(sizeof(token_t), 16);
-    if (!tokens) {
-        if (error) {
-            *error = error_create(ERR_MEMORY, "Failed to create token array");
-        }
-        tokenizer_free(tok);
-        return NULL;
-    }
-    
-    token_t token;
-    int result;
-    
-    while ((result = tokenizer_next(tok, &token)) > 0) {
-        if (darray_append(tokens, &token) != 0) {
-            if (error) {
-                *error = error_create(ERR_MEMORY, "Failed to append token");
-            }
-            darray_free(tokens);
-            tokenizer_free(tok);
-            return NULL;
-        }
-    }
-    
-    if (result < 0) {
-        if (error) {
-            *error = tokenizer_get_error(tok);
-        }
-        darray_free(tokens);
-        tokenizer_free(tok);
-        return NULL;
-    }
-    
-    if (error) {
-        *error = error_ok();
-    }
-    
-    tokenizer_free(tok);
-    return tokens;
-}
@@ -37,23 +37,22 @@ static gboolean update_result_idle(gpointer data) {
 }
 
 // Evaluate expression in background thread
+// The expression is copied on the main thread, since GTK widgets may only
+// be touched there. The mode and base handlers only record what was
+// chosen: they never wait for engine_lock, which is held for the whole of
+// an evaluation, so the UI stays responsive while one runs.
 static gpointer eval_thread_func(gpointer data) {
-  CalcApp *app = (CalcApp *)data;
-
-  const char *expr = gtk_editable_get_text(GTK_EDITABLE(app->expression_entry));
-  if (!expr || strlen(expr) == 0) {
-    app->eval_running = FALSE;
-    return NULL;
-  }
+  EvalResult *eval_result = (EvalResult *)data;
+  CalcApp *app = eval_result->app;
 
   // Evaluate expression
   error_t error;
-  value_t result = engine_eval(expr, app->engine_ctx, &error);
-
-  // Prepare result
-  EvalResult *eval_result = g_malloc(sizeof(EvalResult));
-  eval_result->app = app;
-  eval_result->expression = g_strdup(expr);
+  g_mutex_lock(&app->engine_lock);
+  engine_set_mode(app->engine_ctx,
+                  (calc_mode_t)g_atomic_int_get(&app->requested_mode));
+  engine_set_base(app->engine_ctx, g_atomic_int_get(&app->requested_base));
+  value_t result = engine_eval(eval_result->expression, app->engine_ctx,
+                               &error);
 
   if (error_is_ok(error)) {
     eval_result->result_str = value_to_string(&result, app->engine_ctx->base);
@@ -61,11 +60,12 @@ static gpointer eval_thread_func(gpointer data) {
   } else {
     eval_result->result_str = g_strdup_printf("Error: %s", error.message);
   }
+  g_mutex_unlock(&app->engine_lock);
 
   // Schedule UI update in main thread
   g_idle_add(update_result_idle, eval_result);
 
-  app->eval_running = FALSE;
+  g_atomic_int_set(&app->eval_running, FALSE);
   return NULL;
 }
 
@@ -113,12 +113,22 @@ void on_equals_clicked(GtkButton *button, gpointer user_data) {
   (void)button;
   CalcApp *app = (CalcApp *)user_data;
 
-  if (app->eval_running) {
-    return; // Don't start new evaluation if one is running
+  const char *expr = gtk_editable_get_text(GTK_EDITABLE(app->expression_entry));
+  if (!expr || strlen(expr) == 0) {
+    return;
+  }
+
+  // Don't start new evaluation if one is running
+  if (!g_atomic_int_compare_and_exchange(&app->eval_running, FALSE, TRUE)) {
+    return;
   }
 
-  app->eval_running = TRUE;
-  app->eval_thread = g_thread_new("evaluator", eval_thread_func, app);
+  EvalResult *eval_result = g_malloc(sizeof(EvalResult));
+  eval_result->app = app;
+  eval_result->expression = g_strdup(expr);
+  eval_result->result_str = NULL;
+
+  app->eval_thread = g_thread_new("evaluator", eval_thread_func, eval_result);
   g_thread_unref(app->eval_thread);
 }
 
@@ -149,24 +159,25 @@ void on_mode_changed(GtkComboBox *combo, gpointer user_data) {
 
   gint active = gtk_combo_box_get_active(combo);
 
+  // Applied by the evaluator before its next evaluation
   switch (active) {
   case 0:
-    app->engine_ctx->mode = MODE_STANDARD;
+    g_atomic_int_set(&app->requested_mode, MODE_STANDARD);
     break;
   case 1:
-    app->engine_ctx->mode = MODE_PROGRAMMER;
+    g_atomic_int_set(&app->requested_mode, MODE_PROGRAMMER);
     break;
   case 2:
-    app->engine_ctx->mode = MODE_STATISTICS;
+    g_atomic_int_set(&app->requested_mode, MODE_STATISTICS);
     break;
   case 3:
-    app->engine_ctx->mode = MODE_PROBABILITY;
+    g_atomic_int_set(&app->requested_mode, MODE_PROBABILITY);
     break;
   case 4:
-    app->engine_ctx->mode = MODE_DISCRETE;
+    g_atomic_int_set(&app->requested_mode, MODE_DISCRETE);
     break;
   case 5:
-    app->engine_ctx->mode = MODE_LINEAR_ALGEBRA;
+    g_atomic_int_set(&app->requested_mode, MODE_LINEAR_ALGEBRA);
     break;
   default:
     break;
@@ -182,18 +193,19 @@ void on_base_changed(GtkComboBox *combo, gpointer user_data) {
 
   gint active = gtk_combo_box_get_active(combo);
 
+  // Applied by the evaluator before its next evaluation
   switch (active) {
   case 0:
-    app->engine_ctx->base = 10;
+    g_atomic_int_set(&app->requested_base, 10);
     break;
   case 1:
-    app->engine_ctx->base = 16;
+    g_atomic_int_set(&app->requested_base, 16);
     break;
   case 2:
-    app->engine_ctx->base = 2;
+    g_atomic_int_set(&app->requested_base, 2);
     break;
   case 3:
-    app->engine_ctx->base = 8;
+    g_atomic_int_set(&app->requested_base, 8);
     break;
   default:
     break;
@@ -332,6 +344,9 @@ static GtkWidget *create_linalg_panel(CalcApp *app) {
 CalcApp *calc_app_create(void) {
   CalcApp *app = g_malloc0(sizeof(CalcApp));
   app->engine_ctx = engine_context_create(MODE_STANDARD);
+  g_mutex_init(&app->engine_lock);
+  app->requested_mode = MODE_STANDARD;
+  app->requested_base = 10;
   app->eval_running = FALSE;
 
   // Create main window
@@ -441,6 +456,7 @@ void calc_app_destroy(CalcApp *app) {
     if (app->engine_ctx) {
       engine_context_free(app->engine_ctx);
     }
+    g_mutex_clear(&app->engine_lock);
     g_free(app);
   }
 }
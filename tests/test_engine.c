@@ -0,0 +1,706 @@
+#include "engine/engine.h"
+#include "engine/optimizer.h"
+#include "engine/statistics.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_AVAILABLE 1
+#else
+#define JIT_AVAILABLE 0 // jit_compile() declines every program
+#endif
+
+// Engine API tests that the CLI cannot reach; run by `make test`
+
+static int pass, fail;
+
+static void check(int ok, const char *description) {
+  if (ok) {
+    printf("✓ %s\n", description);
+    pass++;
+  } else {
+    printf("✗ %s\n", description);
+    fail++;
+  }
+}
+
+static void check_error(const error_t *error, const char *expected,
+                        const char *description) {
+  int ok = !error_is_ok(*error) && strcmp(error->message, expected) == 0;
+  check(ok, description);
+  if (!ok)
+    printf("  Expected: %s\n  Got:      %s\n", expected,
+           error_is_ok(*error) ? "(no error)" : error->message);
+}
+
+static engine_context_t *context_with(const char *const *assignments,
+                                      size_t count) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  error_t error;
+  for (size_t i = 0; ctx && i < count; i++) {
+    value_t v = engine_eval(assignments[i], ctx, &error);
+    value_free(&v);
+  }
+  return ctx;
+}
+
+// Evaluate for effect: results of engine_eval are views owned by ctx
+static void run(engine_context_t *ctx, const char *expression) {
+  error_t error;
+  engine_eval(expression, ctx, &error);
+}
+
+// engine_eval's output as the CLI prints it
+static int prints(engine_context_t *ctx, const char *expression,
+                  const char *expected) {
+  error_t error;
+  value_t v = engine_eval(expression, ctx, &error);
+  char *text = error_is_ok(error) ? value_to_string(&v, ctx->base) : NULL;
+  int ok = text && strcmp(text, expected) == 0;
+  free(text);
+  return ok;
+}
+
+static void test_cache(void) {
+  engine_context_t *ctx = engine_context_create(MODE_STANDARD);
+  expr_cache_t *cache = ctx->cache;
+
+  run(ctx, "1 + 2");
+  run(ctx, "1 + 2");
+  run(ctx, "1 + 2");
+  check(cache->misses == 1 && cache->hits == 2 && cache->size == 1,
+        "Cache: a repeated expression is compiled once");
+
+  // Spacing outside quotes does not change the tokens
+  run(ctx, "1+2");
+  run(ctx, "  1  +\t2 ");
+  check(cache->misses == 1 && cache->hits == 4 && cache->size == 1,
+        "Cache: whitespace variants share one entry");
+
+  // ... but not where it splits tokens
+  error_t error;
+  int split = prints(ctx, "1e-1", "0.1") && prints(ctx, "1e -1", "0") &&
+              prints(ctx, "2 << 1", "4");
+  engine_eval("2 < < 1", ctx, &error);
+  split &= !error_is_ok(error);
+  check(split && cache->size == 4,
+        "Cache: spaces that separate tokens are kept");
+
+  char key[64];
+  size_t length = expr_cache_normalize(" load_raw( \"a  b\" ) ", key);
+  int quoted = length == strlen("load_raw(\"a  b\")") &&
+               strcmp(key, "load_raw(\"a  b\")") == 0;
+  run(ctx, "load_raw(\"a  b\")");
+  run(ctx, "load_raw(\"a b\")");
+  check(quoted && cache->misses == 7 && cache->size == 6,
+        "Cache: spaces inside quoted file names are kept");
+
+  // 3 + 3 evicts 2 + 2, used less recently than 1 + 1
+  engine_set_cache_capacity(ctx, 2);
+  size_t hits = cache->hits, misses = cache->misses;
+  run(ctx, "1 + 1");
+  run(ctx, "2 + 2");
+  run(ctx, "1 + 1");
+  run(ctx, "3 + 3");
+  int full = cache->size == 2;
+  run(ctx, "1 + 1");
+  run(ctx, "2 + 2");
+  check(full && cache->hits - hits == 2 && cache->misses - misses == 4,
+        "Cache: the least recently used entry is evicted at capacity");
+
+  engine_set_cache_capacity(ctx, 0);
+  hits = cache->hits;
+  misses = cache->misses;
+  int same = prints(ctx, "6 * 7", "42") && prints(ctx, "6 * 7", "42");
+  check(same && cache->size == 0 && cache->hits == hits &&
+            cache->misses == misses,
+        "Cache: capacity 0 evaluates without caching");
+
+  engine_set_cache_capacity(ctx, ENGINE_CACHE_CAPACITY);
+  int decimal = prints(ctx, "255", "255");
+  engine_set_base(ctx, 10);
+  int kept = cache->size == 1;
+  engine_set_base(ctx, 16);
+  int cleared = cache->size == 0;
+  check(decimal && kept && cleared && prints(ctx, "255", "0xFF"),
+        "Cache: a new base clears the cache and changes the output");
+
+  run(ctx, "255");
+  engine_set_mode(ctx, MODE_STANDARD);
+  kept = cache->size == 1;
+  engine_set_mode(ctx, MODE_PROGRAMMER);
+  check(kept && cache->size == 0, "Cache: a new mode clears the cache");
+
+  engine_context_free(ctx);
+}
+
+// leaf+(leaf+(...(leaf))): n additions, n + 1 levels deep. Owned by the
+// caller
+static char *chain(size_t n, const char *leaf) {
+  size_t width = strlen(leaf) + 3;
+  char *text = malloc(n * width + strlen(leaf) + 1);
+  if (!text)
+    return NULL;
+  size_t length = 0;
+  for (size_t i = 0; i < n; i++)
+    length += (size_t)sprintf(text + length, "%s+(", leaf);
+  length += (size_t)sprintf(text + length, "%s", leaf);
+  memset(text + length, ')', n);
+  text[length + n] = '\0';
+  return text;
+}
+
+// Evaluate a chain of n additions of leaf and compare with expected
+static int chain_is(engine_context_t *ctx, size_t n, const char *leaf,
+                    double expected, error_t *error) {
+  char *text = chain(n, leaf);
+  if (!text)
+    return 0;
+  value_t v = engine_eval(text, ctx, error);
+  free(text);
+  return error_is_ok(*error) && v.type == VALUE_NUMBER &&
+         v.as.number == expected;
+}
+
+#define DEEP 100000
+
+static void test_depth(void) {
+  static const char *setup[] = {"x = 2"};
+  engine_context_t *ctx = context_with(setup, 1);
+  error_t error;
+
+  engine_set_max_depth(ctx, 50);
+  check(chain_is(ctx, 49, "x", 100, &error),
+        "Depth: an expression at the limit evaluates");
+  chain_is(ctx, 50, "x", 102, &error);
+  check_error(&error, "Expression nested too deeply",
+              "Depth: one level past the limit fails");
+  engine_set_max_depth(ctx, ENGINE_MAX_DEPTH);
+  check(chain_is(ctx, 50, "x", 102, &error),
+        "Depth: raising the limit accepts it again");
+
+  // Nothing recurses on the C stack: parser, folder, VM and tree walker
+  check(chain_is(ctx, DEEP, "x", 2.0 * (DEEP + 1), &error),
+        "Depth: a 100k-level chain runs on the VM");
+  check(chain_is(ctx, DEEP, "1", DEEP + 1, &error),
+        "Depth: a 100k-level constant chain folds");
+  engine_set_cache_capacity(ctx, 0);
+  check(chain_is(ctx, DEEP, "x", 2.0 * (DEEP + 1), &error),
+        "Depth: a 100k-level chain runs on the tree walker");
+
+  engine_context_free(ctx);
+}
+
+// Root of text once folded, or NULL; the tree lives in ctx->arena
+static const ast_node_t *folded(engine_context_t *ctx, const char *text,
+                                const ast_t **tree) {
+  error_t error;
+  ast_t *ast = parse(text, ctx->arena, ctx->symbols, &error);
+  if (!ast || ast_fold(ast, ctx->arena, &error) != 0)
+    return NULL;
+  *tree = ast;
+  return &ast->nodes[ast->root];
+}
+
+// Whether text folds to a single node of the given type
+static int folds_to(engine_context_t *ctx, const char *text,
+                    node_type_t type) {
+  const ast_t *ast;
+  const ast_node_t *root = folded(ctx, text, &ast);
+  int ok = root && ast->node_count == 1 && root->type == type;
+  arena_reset(ctx->arena);
+  return ok;
+}
+
+// Whether text still folds to a node of type type whose last operand has
+// type right, so that neither was folded away
+static int keeps(engine_context_t *ctx, const char *text, node_type_t type,
+                 node_type_t right) {
+  const ast_t *ast;
+  const ast_node_t *root = folded(ctx, text, &ast);
+  int ok = root && root->type == type && root->child_count >= 2 &&
+           ast->nodes[ast->edges[root->first + root->child_count - 1]].type ==
+               right;
+  arena_reset(ctx->arena);
+  return ok;
+}
+
+static int evaluates_to_v(engine_context_t *ctx, const char *text) {
+  error_t error;
+  value_t v = engine_eval(text, ctx, &error);
+  return error_is_ok(error) && v.type == VALUE_ARRAY &&
+         v.as.array.size == 3 && v.as.array.data[0] == 1 &&
+         v.as.array.data[1] == 2 && v.as.array.data[2] == 3;
+}
+
+static int sign_of(engine_context_t *ctx, const char *text) {
+  error_t error;
+  value_t v = engine_eval(text, ctx, &error);
+  return error_is_ok(error) && v.type == VALUE_NUMBER
+             ? (signbit(v.as.number) ? -1 : 1)
+             : 0;
+}
+
+static void test_folding(void) {
+  static const char *setup[] = {"x = 2", "v = [1, 2, 3]", "z = -0"};
+  engine_context_t *ctx = context_with(setup, 3);
+  error_t error;
+
+  static const char *identities[] = {"v * 1", "1 * v", "v / 1", "v - 0"};
+  int all = 1;
+  for (size_t i = 0; i < sizeof(identities) / sizeof(identities[0]); i++)
+    all &= folds_to(ctx, identities[i], NODE_VARIABLE) &&
+           evaluates_to_v(ctx, identities[i]);
+  check(all, "Folding: v*1, 1*v, v/1 and v-0 on an array become v");
+
+  // -0 + 0 is +0, so x + 0 is not x
+  check(keeps(ctx, "v + 0", NODE_OPERATOR, NODE_NUMBER) &&
+            sign_of(ctx, "z") == -1 && sign_of(ctx, "z + 0") == 1 &&
+            sign_of(ctx, "z * 1") == -1,
+        "Folding: x + 0 is kept, so -0 + 0 stays +0");
+
+  int kept = keeps(ctx, "x + 1/0", NODE_OPERATOR, NODE_OPERATOR) &&
+             keeps(ctx, "x * fact(-1)", NODE_OPERATOR, NODE_FUNCTION);
+  check(kept, "Folding: failing constant subtrees are not folded away");
+  engine_eval("x + 1/0", ctx, &error);
+  check_error(&error, "Division by zero",
+              "Folding: a failing subtree still fails at run time");
+  engine_eval("x * fact(-1)", ctx, &error);
+  check_error(&error, "Factorial of negative number",
+              "Folding: a failing call still fails at run time");
+
+  value_t v = engine_eval("if(0, 1/0, x)", ctx, &error);
+  check(folds_to(ctx, "if(1, x, 1/0)", NODE_VARIABLE) &&
+            folds_to(ctx, "if(0, 1/0, x)", NODE_VARIABLE) &&
+            keeps(ctx, "if(x, 1, 2)", NODE_FUNCTION, NODE_NUMBER) &&
+            error_is_ok(error) && v.as.number == 2,
+        "Folding: if() with a constant condition keeps the branch taken");
+
+  v = engine_eval("or(1, 1/0)", ctx, &error);
+  check(folds_to(ctx, "and(0, x)", NODE_NUMBER) &&
+            folds_to(ctx, "or(1, 1/0)", NODE_NUMBER) &&
+            keeps(ctx, "and(1, x)", NODE_FUNCTION, NODE_VARIABLE) &&
+            error_is_ok(error) && v.as.number == 1,
+        "Folding: and()/or() decided by a constant become a number");
+
+  engine_context_free(ctx);
+}
+
+#define ROWS 1000 // Several blocks of BYTECODE_BLOCK rows, the last partial
+
+static int columns_match(engine_context_t *ctx, const char *expression,
+                         const engine_column_t *bindings, size_t count,
+                         double (*expected)(size_t row)) {
+  double out[ROWS];
+  error_t error;
+  bytecode_t *program = engine_compile(expression, ctx, &error);
+  int ok = program && engine_eval_columns(program, ctx, bindings, count,
+                                          ROWS, out, &error) == 0;
+  for (size_t row = 0; ok && row < ROWS; row++)
+    ok = out[row] == expected(row);
+  bytecode_free(program);
+  return ok;
+}
+
+static double column_a(size_t row) { return (double)row * 0.5; }
+static double column_b(size_t row) { return (double)(row % 7) + 1; }
+static double scaled_sum(size_t row) {
+  return column_a(row) * 2 + column_b(row);
+}
+static double plus_c(size_t row) { return column_a(row) + 10; }
+static double called(size_t row) {
+  return (column_a(row) + column_b(row)) / 2 + 1;
+}
+static double nested(size_t row) { return column_a(row) * 1100; }
+
+static void test_columns(void) {
+  static const char *setup[] = {"c = 10"};
+  engine_context_t *ctx = context_with(setup, 1);
+  static double a[ROWS], b[ROWS];
+  for (size_t row = 0; row < ROWS; row++) {
+    a[row] = column_a(row);
+    b[row] = column_b(row);
+  }
+  engine_column_t bindings[] = {{"a", a}, {"b", b}};
+
+  check(columns_match(ctx, "a * 2 + b", bindings, 2, scaled_sum),
+        "Columns: numeric program over several blocks");
+  check(columns_match(ctx, "a + c", bindings, 1, plus_c),
+        "Columns: unbound variables keep their value");
+  check(columns_match(ctx, "mean(a, b) + 1", bindings, 2, called),
+        "Columns: calls fall back to one row at a time");
+
+  // Deeper than the block VM's scratch allows: runs row by row
+  char deep[1100 * 5 + 8];
+  size_t length = 0;
+  for (size_t i = 0; i < 1099; i++)
+    length += (size_t)sprintf(deep + length, "a+(");
+  length += (size_t)sprintf(deep + length, "a");
+  for (size_t i = 0; i < 1099; i++)
+    deep[length++] = ')';
+  deep[length] = '\0';
+  check(columns_match(ctx, deep, bindings, 1, nested),
+        "Columns: very deep programs fall back to one row at a time");
+
+  double out[ROWS];
+  error_t error;
+  static double zeros[ROWS];
+  for (size_t row = 0; row < ROWS; row++)
+    zeros[row] = row == 300 || row == 700 ? 0 : 1;
+  engine_column_t divisors[] = {{"a", a}, {"b", zeros}};
+  bytecode_t *program = engine_compile("a / b", ctx, &error);
+  int status = engine_eval_columns(program, ctx, divisors, 2, ROWS, out,
+                                   &error);
+  check(status == -1, "Columns: a failing block returns -1");
+  check_error(&error, "Row 300: Division by zero",
+              "Columns: the error names the first failing row");
+  bytecode_free(program);
+
+  program = engine_compile("mod(a, b)", ctx, &error);
+  engine_eval_columns(program, ctx, divisors, 2, ROWS, out, &error);
+  check_error(&error, "Row 300: Modulo by zero",
+              "Columns: row by row, the error names the failing row");
+  bytecode_free(program);
+
+  program = engine_compile("vector(a, b)", ctx, &error);
+  engine_eval_columns(program, ctx, bindings, 2, ROWS, out, &error);
+  check_error(&error, "Row 0: Result is not a number",
+              "Columns: results must be numbers");
+  bytecode_free(program);
+
+  program = engine_compile("z = a + 1", ctx, &error);
+  status = engine_eval_columns(program, ctx, bindings, 1, ROWS, out, &error);
+  value_t z = engine_eval("z", ctx, &error);
+  check(status == 0 && out[ROWS - 1] == column_a(ROWS - 1) + 1 &&
+            z.as.number == out[ROWS - 1],
+        "Columns: an assignment keeps the last row's value");
+  bytecode_free(program);
+
+  engine_context_free(ctx);
+}
+
+// Run expression on both contexts: the JIT's result or error must be the
+// VM's, bit for bit. *native tells whether the JIT translated it.
+static int jit_matches(engine_context_t *vm, engine_context_t *jit,
+                       const char *expression, int *native) {
+  error_t vm_error, jit_error;
+  bytecode_t *interpreted = engine_compile(expression, vm, &vm_error);
+  bytecode_t *translated = engine_compile(expression, jit, &jit_error);
+  int ok = interpreted && translated;
+  *native = ok && translated->native != NULL;
+  if (ok) {
+    value_t a = engine_exec(interpreted, vm, &vm_error);
+    value_t b = engine_exec(translated, jit, &jit_error);
+    ok = error_is_ok(vm_error) == error_is_ok(jit_error);
+    if (ok && !error_is_ok(vm_error))
+      ok = strcmp(vm_error.message, jit_error.message) == 0;
+    else if (ok)
+      ok = a.type == VALUE_NUMBER && b.type == VALUE_NUMBER &&
+           memcmp(&a.as.number, &b.as.number, sizeof(double)) == 0;
+    value_free(&a);
+    value_free(&b);
+  }
+  bytecode_free(interpreted);
+  bytecode_free(translated);
+  return ok;
+}
+
+static void test_jit(void) {
+  static const char *setup[] = {"a = 12.5", "b = 7", "c = 40"};
+  engine_context_t *vm = context_with(setup, 3);
+  engine_context_t *jit = context_with(setup, 3);
+  engine_set_jit(jit, 1);
+
+  static const char *translated[] = {
+      "a*b + c % 7",
+      "(a + b) * (a - b) / (c + 1) - neg(a) * 3",
+      "((a << 3) | (b & 255)) ^ bnot(c) + mod(a * 17, 13)",
+      "(a + b) * (a + b) - not(c)",
+  };
+  int all = 1, native;
+  for (size_t i = 0; i < sizeof(translated) / sizeof(translated[0]); i++)
+    all &= jit_matches(vm, jit, translated[i], &native) &&
+           native == JIT_AVAILABLE;
+  check(all, "JIT: operators and neg/bnot/not/mod match the VM");
+
+  static const char *failing[] = {
+      "a / (b - 7)",
+      "mod(a, b - 7)",
+      "a << c * 2",
+      "a * 1e308 * 10",
+  };
+  all = 1;
+  for (size_t i = 0; i < sizeof(failing) / sizeof(failing[0]); i++)
+    all &= jit_matches(vm, jit, failing[i], &native) &&
+           native == JIT_AVAILABLE;
+  check(all, "JIT: error stubs report what the VM reports");
+
+  // Calls, assignments and more live values than registers stay on the VM
+  static const char *declined[] = {
+      "mean(a, b)",
+      "d = a + 1",
+      "a+(b+(c+(a+(b+(c+(a+(b+(c+(a+(b+(c+(a+(b+(c+a))))))))))))))",
+  };
+  all = 1;
+  for (size_t i = 0; i < sizeof(declined) / sizeof(declined[0]); i++)
+    all &= jit_matches(vm, jit, declined[i], &native) && !native;
+  check(all, "JIT: unsupported programs are declined and run on the VM");
+
+  // Translated for numbers, then handed an array: the VM runs it instead
+  error_t error;
+  bytecode_t *program = engine_compile("a + b", jit, &error);
+  engine_eval("b = [1, 2]", jit, &error);
+  value_t v = engine_exec(program, jit, &error);
+  check(error_is_ok(error) && v.type == VALUE_ARRAY &&
+            v.as.array.data[0] == 13.5 && v.as.array.data[1] == 14.5,
+        "JIT: a variable that is not a number falls back to the VM");
+  value_free(&v);
+  bytecode_free(program);
+
+  engine_context_free(vm);
+  engine_context_free(jit);
+}
+
+#define BATCH 1000
+#define BATCH_THREADS 4
+
+static void test_batch(void) {
+  static const char *setup[] = {"x = 1", "v = [1, 2, 3]", "42"};
+  engine_context_t *ctx = context_with(setup, 3);
+  static char texts[BATCH][32];
+  static const char *expressions[BATCH];
+  static value_t results[BATCH];
+  static error_t errors[BATCH];
+
+  for (size_t i = 0; i < BATCH; i++) {
+    snprintf(texts[i], sizeof(texts[i]), i % 7 == 3 ? "%zu / 0" : "%zu * 2",
+             i);
+    expressions[i] = texts[i];
+  }
+  int status = engine_eval_batch(ctx, expressions, BATCH, results, errors,
+                                 BATCH_THREADS);
+  int ordered = status == 0, failed = 1;
+  for (size_t i = 0; i < BATCH; i++) {
+    if (i % 7 == 3)
+      failed &= !error_is_ok(errors[i]) &&
+                strcmp(errors[i].message, "Division by zero") == 0;
+    else
+      ordered &= error_is_ok(errors[i]) && results[i].as.number == 2.0 * i;
+    value_free(&results[i]);
+  }
+  check(ordered, "Batch: results come back in input order");
+  check(failed, "Batch: each failing expression gets its own error");
+
+  // Chunks of consecutive expressions go to one worker, which counts up
+  // from its own copy of x; a shared x would skip or repeat values
+  for (size_t i = 0; i < BATCH; i++)
+    expressions[i] = i % 2 ? "v" : "x = x + 1";
+  status = engine_eval_batch(ctx, expressions, BATCH, results, errors,
+                             BATCH_THREADS);
+  int isolated = status == 0, views = 1;
+  for (size_t i = 0; i < BATCH; i += 2) {
+    isolated &= error_is_ok(errors[i]) && results[i].as.number >= 2;
+    if (i % 16 != 0)
+      isolated &= results[i].as.number == results[i - 2].as.number + 1;
+  }
+  for (size_t i = 1; i < BATCH; i += 2) {
+    views &= error_is_ok(errors[i]) && results[i].type == VALUE_ARRAY &&
+             results[i].as.array.size == 3 &&
+             results[i].as.array.data[2] == 3;
+  }
+  for (size_t i = 0; i < BATCH; i++)
+    value_free(&results[i]);
+  error_t error;
+  value_t ans = engine_eval("ans", ctx, &error);
+  isolated &= ans.as.number == 42;
+  value_t x = engine_eval("x", ctx, &error);
+  isolated &= x.as.number == 1;
+  check(isolated, "Batch: assignments stay in the worker that ran them");
+  check(views, "Batch: variables come back as owned copies");
+
+  engine_context_free(ctx);
+}
+
+#define REPEATS 10000
+
+// Heap allocations made by evaluating expression REPEATS times, after a
+// few warm-up runs have filled the cache and the free list
+static size_t heap_growth(engine_context_t *ctx, const char *expression) {
+  error_t error;
+  for (size_t i = 0; i < 8; i++)
+    engine_eval(expression, ctx, &error);
+  size_t before = value_heap_allocations();
+  for (size_t i = 0; i < REPEATS; i++)
+    engine_eval(expression, ctx, &error);
+  return value_heap_allocations() - before;
+}
+
+static void test_buffers(void) {
+  static const char *setup[] = {"x = 2", "v = [1, 2, 3]",
+                                "m = [[1, 2], [3, 4]]"};
+  engine_context_t *ctx = context_with(setup, 3);
+  check(heap_growth(ctx, "v * x + [1, 1, 1]") == 0 &&
+            heap_growth(ctx, "m * m - m") == 0,
+        "Buffers: cached evaluation reuses released buffers");
+  engine_context_free(ctx);
+
+  ctx = context_with(setup, 3);
+  engine_set_cache_capacity(ctx, 0);
+  check(heap_growth(ctx, "vec_add(v * x, [1, 1, 1])") == 0,
+        "Buffers: the tree walker reuses released buffers");
+  engine_context_free(ctx);
+
+  // engine_context_free() emptied this thread's list
+  size_t before = value_heap_allocations();
+  value_data_release(value_alloc(3));
+  int drained = value_heap_allocations() == before + 1;
+  value_data_release(value_alloc(3));
+  int reused = value_heap_allocations() == before + 1;
+  value_cache_drain();
+  value_data_release(value_alloc(3));
+  drained &= value_heap_allocations() == before + 2;
+  check(reused, "Buffers: a released buffer is handed out again");
+  check(drained, "Buffers: freeing a context drains the thread's buffers");
+}
+
+#define SAMPLES 1000 // Several STATS_BLOCK blocks, the last partial
+
+static int close_to(double a, double b) {
+  return fabs(a - b) <= 1e-12 * (fabs(a) + fabs(b)) + 1e-12;
+}
+
+static int same_summary(const stats_acc_t *a, const stats_acc_t *b) {
+  return a->count == b->count && a->min == b->min && a->max == b->max &&
+         close_to(a->mean, b->mean) && close_to(a->m2, b->m2);
+}
+
+static int same_cov(const stats_cov_t *a, const stats_cov_t *b) {
+  return same_summary(&a->x, &b->x) && same_summary(&a->y, &b->y) &&
+         close_to(a->c, b->c);
+}
+
+static void test_statistics(void) {
+  static double x[SAMPLES], y[SAMPLES], line[SAMPLES], flat[SAMPLES];
+  for (size_t i = 0; i < SAMPLES; i++) {
+    x[i] = 100.0 + sin((double)i) * 10 + (double)i * 0.01;
+    y[i] = cos((double)i * 0.7) * 3 - x[i] * 0.5;
+    line[i] = 2 * x[i] + 1;
+    flat[i] = 4;
+  }
+
+  stats_acc_t whole;
+  stats_acc_init(&whole);
+  stats_acc_push(&whole, x, SAMPLES);
+
+  // Split anywhere, including at either end and off block boundaries
+  static const size_t splits[] = {0, 1, 7, 255, 256, 257, 999, SAMPLES};
+  int merged = 1;
+  for (size_t i = 0; i < sizeof(splits) / sizeof(splits[0]); i++) {
+    stats_acc_t left, right;
+    stats_acc_init(&left);
+    stats_acc_init(&right);
+    stats_acc_push(&left, x, splits[i]);
+    stats_acc_push(&right, x + splits[i], SAMPLES - splits[i]);
+    stats_acc_t forward = left, backward = right;
+    stats_acc_merge(&forward, &right);
+    stats_acc_merge(&backward, &left);
+    merged &= same_summary(&forward, &whole) &&
+              same_summary(&backward, &whole);
+  }
+  check(merged, "Statistics: merging two halves matches one pass");
+
+  stats_acc_t total;
+  stats_acc_init(&total);
+  static const size_t sizes[] = {3, 300, 0, 1, 450, 246};
+  size_t start = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    stats_acc_t part;
+    stats_acc_init(&part);
+    stats_acc_push(&part, x + start, sizes[i]);
+    stats_acc_merge(&total, &part);
+    start += sizes[i];
+  }
+  check(start == SAMPLES && same_summary(&total, &whole),
+        "Statistics: merging uneven parts matches one pass");
+
+  // Two-pass reference
+  double mx = 0, my = 0, cxy = 0, cxx = 0, cyy = 0;
+  for (size_t i = 0; i < SAMPLES; i++) {
+    mx += x[i];
+    my += y[i];
+  }
+  mx /= SAMPLES;
+  my /= SAMPLES;
+  for (size_t i = 0; i < SAMPLES; i++) {
+    cxy += (x[i] - mx) * (y[i] - my);
+    cxx += (x[i] - mx) * (x[i] - mx);
+    cyy += (y[i] - my) * (y[i] - my);
+  }
+
+  error_t error;
+  stats_cov_t pairs;
+  stats_cov_init(&pairs);
+  stats_cov_push(&pairs, x, y, SAMPLES);
+  double correlation = 0;
+  double covariance = stats_cov_finalize(&pairs, &correlation, &error);
+  check(error_is_ok(error) && close_to(covariance, cxy / SAMPLES) &&
+            close_to(correlation, cxy / sqrt(cxx * cyy)),
+        "Statistics: covariance and correlation match two passes");
+
+  merged = 1;
+  for (size_t i = 0; i < sizeof(splits) / sizeof(splits[0]); i++) {
+    stats_cov_t left, right;
+    stats_cov_init(&left);
+    stats_cov_init(&right);
+    stats_cov_push(&left, x, y, splits[i]);
+    stats_cov_push(&right, x + splits[i], y + splits[i],
+                   SAMPLES - splits[i]);
+    stats_cov_merge(&left, &right);
+    merged &= same_cov(&left, &pairs);
+  }
+  check(merged, "Statistics: merged pair summaries match one pass");
+
+  stats_cov_init(&pairs);
+  stats_cov_push(&pairs, x, line, SAMPLES);
+  covariance = stats_cov_finalize(&pairs, &correlation, &error);
+  check(error_is_ok(error) && close_to(covariance, 2 * cxx / SAMPLES) &&
+            close_to(correlation, 1),
+        "Statistics: a line has correlation 1");
+
+  stats_cov_init(&pairs);
+  stats_cov_push(&pairs, x, flat, SAMPLES);
+  covariance = stats_cov_finalize(&pairs, NULL, &error);
+  int plain = error_is_ok(error) && covariance == 0;
+  stats_cov_finalize(&pairs, &correlation, &error);
+  check(plain, "Statistics: zero variance still has a covariance");
+  check_error(&error, "Zero denominator in correlation",
+              "Statistics: zero variance has no correlation");
+
+  stats_cov_init(&pairs);
+  stats_cov_finalize(&pairs, NULL, &error);
+  check_error(&error, "Empty dataset for covariance",
+              "Statistics: no pairs have no covariance");
+}
+
+int main(void) {
+  printf("== Cache ==\n");
+  test_cache();
+  printf("\n== Folding ==\n");
+  test_folding();
+  printf("\n== Depth ==\n");
+  test_depth();
+  printf("\n== Columns ==\n");
+  test_columns();
+  printf("\n== JIT ==\n");
+  test_jit();
+  printf("\n== Batch ==\n");
+  test_batch();
+  printf("\n== Statistics ==\n");
+  test_statistics();
+  printf("\n== Buffers ==\n");
+  test_buffers();
+  printf("\nResults: %d passed, %d failed\n", pass, fail);
+  return fail == 0 ? 0 : 1;
+}
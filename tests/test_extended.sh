@@ -28,11 +28,56 @@ test_expr() {
     fi
 }
 
+# Streaming test: pipe input through --reduce, output lines joined by spaces
+test_reduce() {
+    local input="$1"
+    local reducers="$2"
+    local expected="$3"
+    local description="$4"
+
+    result=$(printf "$input" | ./calc42-cli --reduce "$reducers" 2>&1 | paste -sd ' ')
+
+    if [[ "$result" == "$expected" ]]; then
+        echo "✓ $description"
+        ((PASS++))
+    else
+        echo "✗ $description"
+        echo "  Expected: $expected"
+        echo "  Got:      $result"
+        ((FAIL++))
+    fi
+}
+
+# Session test: feed lines to the REPL, keep the last result or error
+test_session() {
+    local input="$1"
+    local expected="$2"
+    local description="$3"
+
+    result=$(printf "$input" | ./calc42-cli 2>&1 | grep -E '^(= |Error)' | tail -1)
+
+    if [[ "$result" == "$expected" ]]; then
+        echo "✓ $description"
+        ((PASS++))
+    else
+        echo "✗ $description"
+        echo "  Expected: $expected"
+        echo "  Got:      $result"
+        ((FAIL++))
+    fi
+}
+
 echo "== Basic Arithmetic =="
 test_expr "3 + 4 * 2" "11" "Operator precedence"
 test_expr "(3 + 4) * 2" "14" "Parentheses"
 test_expr "10 / 2" "5" "Division"
 test_expr "10 % 3" "1" "Modulo"
+test_expr "[7, 8, 9] % 4" "[3, 0, 1]" "Array modulo a number"
+test_expr "10 % [3, 4]" "[1, 2]" "Number modulo an array"
+test_expr "[-7, 7] % [3, -3]" "[-1, 1]" "Array modulo keeps the dividend's sign"
+test_expr "[7, 8] % [3, 0]" "Error: Result is not a finite number" "Array modulo by a zero element"
+test_expr "2.5e-3 * 4e3" "10" "Scientific notation"
+test_expr "123456789012345678901234567890 / 1e29" "1.23456789" "More digits than a uint64"
 echo ""
 
 echo "== Number Bases =="
@@ -47,6 +92,12 @@ test_expr "0x0F | 0xF0" "255" "Bitwise OR"
 test_expr "0xFF ^ 0xAA" "85" "Bitwise XOR"
 test_expr "1 << 4" "16" "Left shift"
 test_expr "16 >> 2" "4" "Right shift"
+test_expr "[1, 2, 3] << 2" "[4, 8, 12]" "Array left shift"
+test_expr "1 << [1, 2, 3]" "[2, 4, 8]" "Shift by an array of counts"
+test_expr "[8, 16] >> [1, 2]" "[4, 4]" "Per-element right shift"
+test_expr "[1, 2] << [1, -1]" "Error: Invalid shift count" "Negative shift count in an array"
+test_expr "[1, 2] >> [1, 64]" "Error: Invalid shift count" "Shift count of 64 in an array"
+test_session "x = [1, 2]\nx * 2 << [1, 70]\n" "Error: Invalid shift count" "Bad shift count in a fused chain"
 echo ""
 
 echo "== Statistics Functions =="
@@ -54,6 +105,7 @@ test_expr "mean(10, 20, 30)" "20" "mean(10, 20, 30)"
 test_expr "median(10, 20, 30)" "20" "median(10, 20, 30)"
 test_expr "median(1, 2, 3, 4)" "2.5" "median(1, 2, 3, 4)"
 test_expr "stddev(2, 4, 4, 4, 5, 5, 7, 9)" "2" "stddev(2, 4, ..., 9)"
+test_expr "median(vector(5, 1), 3, matrix(1, 2, 9, 7))" "5" "median over mixed arguments"
 echo ""
 
 echo "== Discrete Math Functions =="
@@ -75,6 +127,11 @@ test_expr "neg(5)" "-5" "neg(5)"
 test_expr "not(0)" "1" "not(0)"
 test_expr "not(5)" "0" "not(5)"
 test_expr "bnot(0)" "-1" "bnot(0)"
+test_expr "-3 + 2" "-1" "Prefix minus"
+test_expr "2 * -3" "-6" "Prefix minus after an operator"
+test_expr "-(2 + 3) * 2" "-10" "Prefix minus binds tighter than *"
+test_expr "~5" "-6" "Prefix bitwise NOT"
+test_expr "-vector(1, 2)" "[-1, -2]" "Prefix minus is element-wise"
 echo ""
 
 echo "== Logic Operators =="
@@ -84,6 +141,10 @@ test_expr "or(0, 0)" "0" "or(0, 0)"
 test_expr "or(1, 0)" "1" "or(1, 0)"
 test_expr "xor(1, 1)" "0" "xor(1, 1)"
 test_expr "xor(1, 0)" "1" "xor(1, 0)"
+test_expr "and(0, 1/0)" "0" "and(0, 1/0) short-circuits"
+test_expr "or(2, 1/0)" "1" "or(2, 1/0) short-circuits"
+test_expr "if(1, 2, 3)" "2" "if(1, 2, 3)"
+test_expr "if(0, 1/0, 5)" "5" "if(0, 1/0, 5) skips the other branch"
 echo ""
 
 echo "== Set Operations =="
@@ -99,6 +160,56 @@ test_expr "vec_mag(3, 4)" "5" "vec_mag([3,4])"
 test_expr "vec_scale(2, 1, 2)" "[2, 4]" "vec_scale(2, [1,2])"
 test_expr "mat_det(matrix(2, 2, 1, 2, 3, 4))" "-2" "mat_det(2x2)"
 test_expr "mat_mul(matrix(2, 2, 1, 0, 0, 1), matrix(2, 2, 5, 6, 7, 8))" "[5, 6, 7, 8]" "mat_mul(I, A)"
+test_expr "vector(1, 2, 3) * 2 + 1" "[3, 5, 7]" "[1,2,3] * 2 + 1"
+test_expr "vector(1, 2) + vector(3, 4)" "[4, 6]" "[1,2] + [3,4]"
+test_expr "10 - matrix(2, 2, 1, 2, 3, 4)" "[9, 8, 7, 6]" "10 - 2x2"
+test_expr "[1, -2, 3.5] * 2" "[2, -4, 7]" "Array literal"
+test_expr "mat_det([[1, 2], [3, 4]])" "-2" "Matrix literal"
+test_expr "mat_mul([[1, 0], [0, 1]], [[5, 6], [7, 1 + 7]])" "[5, 6, 7, 8]" "Matrix literal with expressions"
+test_expr "[[1, 2], [3]]" "Error: Matrix rows must have equal length" "Ragged matrix literal"
+test_expr "mat_det([[1, 2] * 2, [3, 4]])" "-4" "Matrix literal with a computed first row"
+test_expr "mat_det([[1, 2], [3, 4] * 2])" "-4" "Matrix literal with a computed last row"
+test_expr "[[1, 2] * 2, [3]]" "Error: Matrix element count does not match dimensions" "Computed row of the wrong length"
+test_expr "[1, [2, 3]]" "Error: Matrix rows must all be lists" "Numbers mixed with rows"
+test_session "x = [1, 2, 3]\nmat_mul([[x], [x]], [[1], [2], [3]])\n" "= [14, 14]" "Rows spelled with a variable"
+test_session "x = [1, 2, 3]\n[[x], [1, 2]]\n" "Error: Matrix element count does not match dimensions" "Variable row of the wrong length"
+test_expr "vector(matrix(2, 2, 1, 2, 3, 4)) * 2" "[2, 4, 6, 8]" "Flatten a 2x2, then scale"
+test_expr "mat_det([[1, 2], [3, 4]] + [[10, 20], [30, 40]])" "-242" "Matrix plus matrix"
+test_expr "mat_det(-[[1, 2], [3, 4]] * [[1, 1], [1, 1]])" "-2" "Negated matrix times matrix, element-wise"
+test_expr "mat_det([[1, 2], [3, 4]] % 3 << 1)" "4" "Modulo and shift on a matrix"
+test_expr "[[1, 2], [3, 4]] + [1, 2]" "Error: Operand shapes must match" "Matrix plus array"
+test_expr "[[1, 2], [3, 4]] - [[1, 2, 3], [4, 5, 6]]" "Error: Operand shapes must match" "Matrices of different shapes"
+test_session "m = [[1, 2], [3, 4]]\nmat_det(m * m + 1)\n" "= -16" "Fused chain over a matrix variable"
+echo ""
+
+echo "== Loading Data =="
+# 1.0, 2.0, 3.0 and 4.0 as raw little-endian doubles
+RAW=$(mktemp)
+printf '\0\0\0\0\0\0\360\77\0\0\0\0\0\0\0\100' > "$RAW"
+printf '\0\0\0\0\0\0\10\100\0\0\0\0\0\0\20\100' >> "$RAW"
+test_expr "load_raw(\"$RAW\")" "[1, 2, 3, 4]" "load_raw of a whole file"
+test_expr "mat_det(load_raw(\"$RAW\", 2, 2))" "-2" "load_raw as a 2x2 matrix"
+test_expr "mean(load_raw(\"$RAW\", 3)) * 2" "4" "load_raw of a prefix"
+test_expr "load_raw(\"$RAW\", 3, 2)" "Error: load: $RAW: file is too short" "load_raw past the end"
+test_expr "load(\"$RAW\")" "Error: load: $RAW: not a .npy file" "load checks the .npy magic"
+test_expr "mean(\"x\")" "Error: Strings are only allowed as file names" "Strings outside load"
+test_expr "load_raw(vector(47, 116, 109, 112))" "Error: load_raw: argument 1 must be a quoted file name" "File names only come from string literals"
+test_expr "load_raw(\"$RAW\" + 1)" "Error: Unexpected '+'" "Operators do not take file names"
+# Quoted names keep their spaces in the expression cache key
+printf '\0\0\0\0\0\0\34\100' > "$RAW  b"
+printf '\0\0\0\0\0\0\42\100' > "$RAW b"
+result=$(printf 'load_raw("%s  b")\nload_raw("%s b")\n' "$RAW" "$RAW" |
+    ./calc42-cli 2>&1 | grep '^= ' | paste -sd ' ')
+if [[ "$result" == "= [7] = [9]" ]]; then
+    echo "✓ Cached load_raw keeps file names apart"
+    ((PASS++))
+else
+    echo "✗ Cached load_raw keeps file names apart"
+    echo "  Expected: = [7] = [9]"
+    echo "  Got:      $result"
+    ((FAIL++))
+fi
+rm -f "$RAW" "$RAW  b" "$RAW b"
 echo ""
 
 echo "== Advanced Stats & Prob =="
@@ -107,11 +218,31 @@ test_expr "geometric(0.5, 3)" "0.125" "geometric(0.5, 3)"
 test_expr "zscore(20, 10, 20, 30)" "0" "zscore(20, {10,20,30})"
 echo ""
 
+echo "== Streaming Reduce =="
+test_reduce "2 4 4 4\n5, 5, 7, 9\n" "mean,stddev" "5 2" "--reduce mean,stddev"
+test_reduce "3\n-1.5\n10" "count,min,max,variance" "3 -1.5 10 22.38888889" "--reduce count,min,max,variance"
+test_reduce "" "mean" "Error: Empty dataset" "--reduce of nothing"
+test_reduce "1 2\nx" "mean" "Error: Invalid number 'x' on line 2" "--reduce with a bad number"
+test_reduce "1" "median" "Error: Unknown reducer 'median' (count, mean, variance, stddev, min, max)" "--reduce with an unknown reducer"
+echo ""
+
+echo "== Variables =="
+test_expr "x = 3 * 4" "12" "Assignment returns the value"
+test_expr "ans + 5" "5" "ans starts at 0"
+test_expr "foo + 1" "Error: Undefined variable 'foo'" "Undefined variable"
+test_expr "1 = 2" "Error: Unexpected '='" "Assignment needs a name"
+# More failed names than the symbol table holds (4096), then an assignment
+FAILED=$(for i in $(seq 1 2500); do printf 'a%d +\\nb%d * 2\\n' $i $i; done)
+test_session "${FAILED}y = 5\ny + 1\n" "= 6" "Failed expressions leave no variables behind"
+echo ""
+
 echo "== Error Handling =="
 # We check if the result contains "Error:" since that's what we output for ERR_*
 test_expr "10 / 0" "Error: Division by zero" "Division by zero"
 test_expr "1 << 65" "Error: Invalid shift count" "Invalid shift count"
 test_expr "gcd(1)" "Error: gcd requires 2 arguments" "Wrong arg count"
+test_expr "fact(1, 2)" "Error: factorial requires 1 argument" "Arity checked at parse time"
+test_expr "gcd(vector(1, 2), 3)" "Error: gcd: argument 1 must be a number" "Argument type signature"
 echo ""
 
 echo "======================================="